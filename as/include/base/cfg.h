@@ -61,8 +61,10 @@ struct as_namespace_s;
 #define AS_CLUSTER_ID_SZ 65
 
 #define MAX_DEMARSHAL_THREADS 256
+#define MAX_PROTO_PIPELINE 1024
 #define MAX_FABRIC_WORKERS 128
 #define MAX_BATCH_THREADS 64
+#define MAX_NSUP_THREADS 128
 
 // Declare bools with PAD_BOOL so they can't share a 4-byte space with other
 // bools, chars or shorts. This prevents adjacent bools set concurrently in
@@ -119,11 +121,13 @@ typedef struct as_config_s {
 	uint32_t		nsup_delete_sleep; // sleep this many microseconds between generating delete transactions, default 0
 	uint32_t		nsup_period;
 	PAD_BOOL		nsup_startup_evict;
+	uint32_t		nsup_threads;
 	uint32_t		paxos_max_cluster_size;
 	paxos_protocol_enum paxos_protocol;
 	paxos_recovery_policy_enum paxos_recovery_policy;
 	uint32_t		paxos_retransmit_period;
 	int				proto_fd_idle_ms; // after this many milliseconds, connections are aborted unless transaction is in progress
+	uint32_t		proto_pipeline_max; // maximum requests in progress per pipelining connection - 0 disables pipelining
 	int				proto_slow_netio_sleep_ms; // dynamic only
 	uint32_t		query_bsize;
 	uint64_t		query_buf_size; // dynamic only
@@ -142,12 +146,14 @@ typedef struct as_config_s {
 	uint32_t		query_threshold;
 	uint64_t		query_untracked_time_ms;
 	uint32_t		query_worker_threads;
+	PAD_BOOL		record_locks_adaptive;
 	PAD_BOOL		respond_client_on_master_completion;
 	PAD_BOOL		run_as_daemon;
 	uint32_t		scan_max_active; // maximum number of active scans allowed
 	uint32_t		scan_max_done; // maximum number of finished scans kept for monitoring
 	uint32_t		scan_max_udf_transactions; // maximum number of active transactions per UDF background scan
 	uint32_t		scan_threads; // size of scan thread pool
+	PAD_BOOL		shard_transactions; // service threads own partitions and run their transactions to completion
 	uint32_t		sindex_builder_threads; // secondary index builder thread pool size
 	uint64_t		sindex_data_max_memory; // maximum memory for secondary index trees
 	PAD_BOOL		sindex_gc_enable_histogram; // dynamic only
@@ -185,6 +191,7 @@ typedef struct as_config_s {
 	char*			alternate_address; // alternate service address (could be DNS)
 	char*			network_interface_name; // network_interface_name to use on this machine for generating the IP addresses
 	PAD_BOOL		socket_reuse_addr; // whether or not a socket can be reused (SO_REUSEADDR)
+	PAD_BOOL		socket_reuse_port; // each demarshal thread listens & accepts (SO_REUSEPORT)
 
 	//--------------------------------------------
 	// network::heartbeat context.
@@ -68,6 +68,7 @@
 #define AS_CLUSTER_DEFAULT_SZ (AS_CLUSTER_LEGACY_SZ)
 
 #define AS_STORAGE_MAX_DEVICES 32 // maximum devices per namespace
+#define MAX_SSD_WRITE_STRIPES 64 // maximum current swbs per device
 #define AS_STORAGE_MAX_FILES 32 // maximum files per namespace
 #define AS_STORAGE_MAX_DEVICE_SIZE (2L * 1024L * 1024L * 1024L * 1024L) // 2Tb, due to rblock_id in as_index
 
@@ -253,6 +254,7 @@ extern int32_t as_bin_particle_stack_from_pickled(as_bin *b, uint8_t* stack, uin
 extern int as_bin_particle_compare_from_pickled(const as_bin *b, uint8_t **p_pickled);
 extern uint32_t as_bin_particle_client_value_size(const as_bin *b);
 extern uint32_t as_bin_particle_to_client(const as_bin *b, as_msg_op *op);
+extern uint32_t as_bin_particle_client_value_ref(const as_bin *b, const uint8_t **p_value);
 extern uint32_t as_bin_particle_pickled_size(const as_bin *b);
 extern uint32_t as_bin_particle_to_pickled(const as_bin *b, uint8_t *pickled);
 
@@ -531,6 +533,17 @@ typedef enum {
 	AS_NAMESPACE_CONFLICT_RESOLUTION_POLICY_LAST_UPDATE_TIME = 2
 } conflict_resolution_pol;
 
+typedef enum {
+	AS_EVICT_POLICY_TTL = 0, // evict records closest to expiring
+	AS_EVICT_POLICY_LRU = 1, // evict sampled records least recently accessed
+	AS_EVICT_POLICY_LFU = 2 // evict sampled records least frequently accessed
+} as_evict_policy;
+
+typedef enum {
+	AS_STORAGE_COMPRESSION_NONE = 0,
+	AS_STORAGE_COMPRESSION_ZLIB = 1
+} as_storage_compression;
+
 /* Record function declarations */
 // special - get_create returns 1 if created, 0 if just gotten, -1 if fail
 extern int as_record_get_create(struct as_index_tree_s *tree, cf_digest *keyd, as_index_ref *r_ref, as_namespace *ns, bool);
@@ -617,6 +630,10 @@ extern int as_record_flatten(as_partition_reservation *rsv, cf_digest *keyd,
 #define as_record_void_time_get() cf_clepoch_seconds()
 bool as_record_is_expired(as_record *r); // TODO - eventually inline
 
+// Access tracking for LRU & LFU eviction.
+extern void as_record_touch(as_namespace *ns, as_record *r);
+extern uint8_t as_record_lfu_count(as_record *r, uint32_t now);
+
 
 // Counter that tells clients partition ownership has changed.
 extern cf_atomic32 g_partition_generation;
@@ -701,6 +718,9 @@ struct as_partition_s {
 	// the maximum void time of all records in the tree below
 	cf_atomic_int max_void_time;
 
+	// records bucketed by void time - null unless namespace has expiration-index
+	struct as_expire_index_s *expire_index;
+
 	// the actual data
 	struct as_index_tree_s *vp;
 	struct as_index_tree_s *sub_vp;
@@ -1019,6 +1039,10 @@ struct as_namespace_s {
 	cf_atomic32		n_reads_from_cache;
 	cf_atomic32		n_reads_from_device;
 
+	// We also optionally cache records read from device. To track hit rate:
+	cf_atomic32		n_read_cache_hits;
+	cf_atomic32		n_read_cache_misses;
+
 	//--------------------------------------------
 	// Secondary index.
 	//
@@ -1059,9 +1083,13 @@ struct as_namespace_s {
 	PAD_BOOL		write_benchmarks_enabled;
 	PAD_BOOL		proxy_hist_enabled;
 	uint32_t		evict_hist_buckets;
+	as_evict_policy	evict_policy;
+	uint32_t		evict_sample_size; // records sampled per LRU/LFU eviction
 	uint32_t		evict_tenths_pct;
+	PAD_BOOL		expiration_index; // track void-times per partition so nsup needn't reduce to expire
 	float			hwm_disk;
 	float			hwm_memory;
+	PAD_BOOL		index_huge_pages; // back index arena stages with huge pages
 	PAD_BOOL		ldt_enabled;
 	uint32_t		ldt_gc_sleep_us;
 	uint32_t		ldt_page_size;
@@ -1069,6 +1097,7 @@ struct as_namespace_s {
 	uint32_t		migrate_order;
 	uint32_t		migrate_sleep;
 	cf_atomic32		obj_size_hist_max; // TODO - doesn't need to be atomic, really.
+	uint32_t		partition_tree_sprigs; // independently locked sub-trees per partition tree
 	as_policy_consistency_level read_consistency_level;
 	PAD_BOOL		read_consistency_level_override;
 	PAD_BOOL		single_bin; // restrict the namespace to objects with exactly one bin
@@ -1085,7 +1114,12 @@ struct as_namespace_s {
 	char*			storage_scheduler_mode; // relevant for devices only, not files
 	uint32_t		storage_write_block_size;
 	PAD_BOOL		storage_data_in_memory;
+	uint32_t		storage_async_read_depth; // max in-flight async reads per device (0 = sync reads only)
 	PAD_BOOL		storage_cold_start_empty;
+	uint32_t		storage_cold_start_threads; // per device, adding records to index
+	as_storage_compression storage_compression; // applied to each record's bins when written
+	uint32_t		storage_compression_level;
+	PAD_BOOL		storage_defrag_adaptive; // scale defrag-sleep by device load & free space
 	uint32_t		storage_defrag_lwm_pct;
 	uint32_t		storage_defrag_queue_min;
 	uint32_t		storage_defrag_sleep;
@@ -1097,6 +1131,8 @@ struct as_namespace_s {
 	uint64_t		storage_max_write_cache;
 	uint32_t		storage_min_avail_pct;
 	cf_atomic32 	storage_post_write_queue; // number of swbs/device held after writing to device
+	uint64_t		storage_read_cache_size; // bytes, shared by devices (0 = no read cache)
+	uint32_t		storage_write_stripes; // number of current swbs per device
 	uint32_t		storage_write_threads;
 
 	uint32_t		storage_read_block_size;
@@ -1147,6 +1183,7 @@ struct as_namespace_s {
 	// Persistent storage stats.
 
 	float			cache_read_pct;
+	float			read_cache_hit_pct;
 
 	// Migration stats.
 
@@ -0,0 +1,67 @@
+/*
+ * expire_index.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Per-partition timing wheel of record digests, bucketed by void-time, so nsup
+ * can expire the records due without reducing the whole partition tree.
+ *
+ * A record needs an entry no later than its void-time, so entries are only
+ * added when records get a void-time, or it moves earlier. Entries are never
+ * removed when records are updated or deleted - they're checked against the
+ * record's current void-time when their bucket comes due, and re-added if the
+ * void-time has moved later.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "citrusleaf/cf_digest.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+typedef struct as_expire_index_s as_expire_index;
+
+// Called (outside the index lock) for every entry in a due bucket.
+typedef void (*as_expire_index_fn)(cf_digest* keyd, uint32_t void_time, void* udata);
+
+
+//==========================================================
+// Public API.
+//
+
+as_expire_index* as_expire_index_create(uint32_t now);
+void as_expire_index_destroy(as_expire_index* ei);
+
+// Call whenever a record's void-time is set - old_void_time is 0 for a new
+// record. Does nothing unless the void-time moves earlier - the existing entry
+// comes due first.
+void as_expire_index_add(as_expire_index* ei, const cf_digest* keyd, uint32_t old_void_time, uint32_t void_time);
+
+// Pops all buckets entirely in the past, making a callback for each entry. The
+// callback may re-add entries. Returns the number of entries popped.
+uint64_t as_expire_index_pop_due(as_expire_index* ei, uint32_t now, as_expire_index_fn cb, void* udata);
+
+uint64_t as_expire_index_n_entries(as_expire_index* ei);
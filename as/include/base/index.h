@@ -92,7 +92,9 @@ typedef struct as_index_s {
 	uint8_t flex_bits;
 
 	// offset: 56
-	// For data-not-in-memory namespaces, these 8 bytes are currently unused.
+	// For data-not-in-memory multi-bin namespaces, these 8 bytes are unused
+	// unless the eviction policy is LRU or LFU, in which case they hold an
+	// as_index_access.
 	// For data-in-memory namespaces: in single-bin mode the as_bin is embedded
 	// here (these 8 bytes plus the last 4 bits in flex_bits_2 above), but in
 	// multi-bin mode this is a pointer to either of:
@@ -209,6 +211,22 @@ void as_index_set_bin_space(as_index* index, as_bin_space* bin_space) {
 }
 
 
+//------------------------------------------------
+// Access info - overlays dim, for LRU & LFU eviction.
+//
+
+typedef struct as_index_access_s {
+	uint32_t last_access; // clock epoch seconds
+	uint8_t lfu_count; // logarithmic access counter
+	uint8_t unused[3];
+} __attribute__ ((__packed__)) as_index_access;
+
+static inline
+as_index_access* as_index_get_access(as_index *index) {
+	return (as_index_access*)&index->dim;
+}
+
+
 //------------------------------------------------
 // Set-ID bits.
 //
@@ -295,22 +313,31 @@ typedef void (*as_index_value_destructor) (as_index *v, void *udata);
 // Index tree.
 //
 
-typedef struct as_index_tree_s {
+// A tree is split by digest into independently locked red-black sub-trees,
+// "sprigs", so that operations in different sprigs don't contend.
+#define AS_INDEX_MAX_SPRIGS 256
+
+typedef struct as_index_sprig_s {
 	// Note: reduce_lock's scope is always inside of lock's scope.
 	pthread_mutex_t		lock;        // insert, delete vs. insert, delete, get
-	pthread_mutex_t		reduce_lock; // insert, delete vs. reduce
+	pthread_mutex_t		reduce_lock; // insert, delete vs. reduce-sync
 
 	as_index			*root;
 	cf_arenax_handle	root_h;
+} as_index_sprig;
 
-	cf_arenax_handle	sentinel_h;
+typedef struct as_index_tree_s {
+	cf_arenax_handle	sentinel_h; // shared by all sprigs
 
 	as_index_value_destructor destructor;
 	void				*destructor_udata;
 
 	cf_arenax			*arena; // where we allocate and free to
 
-	uint32_t			elements; // not making this atomic, it's not very exact
+	cf_atomic32			elements; // total over all sprigs, not very exact
+
+	uint32_t			sprig_mask; // number of sprigs - 1
+	as_index_sprig		sprigs[];
 } as_index_tree;
 
 
@@ -318,7 +345,7 @@ typedef struct as_index_tree_s {
 // as_index_tree public API.
 //
 
-extern as_index_tree *as_index_tree_create(cf_arenax *arena, as_index_value_destructor destructor, void *destructor_udata, as_treex *p_treex);
+extern as_index_tree *as_index_tree_create(cf_arenax *arena, uint32_t n_sprigs, as_index_value_destructor destructor, void *destructor_udata, as_treex *p_treex);
 extern as_index_tree *as_index_tree_resume(cf_arenax *arena, as_index_value_destructor destructor, void *destructor_udata, as_treex *p_treex);
 extern int as_index_tree_release(as_index_tree *tree, void *destructor_udata);
 extern uint32_t as_index_tree_size(as_index_tree *tree);
@@ -328,6 +355,7 @@ typedef void (*as_index_reduce_sync_fn) (as_index *value, void *udata);
 
 extern void as_index_reduce(as_index_tree *tree, as_index_reduce_fn cb, void *udata);
 extern void as_index_reduce_partial(as_index_tree *tree, uint32_t sample_count, as_index_reduce_fn cb, void *udata);
+extern void as_index_reduce_sample(as_index_tree *tree, cf_digest *after, uint32_t sample_count, as_index_reduce_fn cb, void *udata);
 extern void as_index_reduce_sync(as_index_tree *tree, as_index_reduce_sync_fn cb, void *udata);
 
 extern int as_index_exists(as_index_tree *tree, cf_digest *keyd);
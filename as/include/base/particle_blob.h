@@ -43,6 +43,7 @@ int blob_from_wire(as_particle_type wire_type, const uint8_t *wire_value, uint32
 int blob_compare_from_wire(const as_particle *p, as_particle_type wire_type, const uint8_t *wire_value, uint32_t value_size);
 uint32_t blob_wire_size(const as_particle *p);
 uint32_t blob_to_wire(const as_particle *p, uint8_t *wire);
+const uint8_t *blob_wire_value(const as_particle *p);
 
 // Handle as_val translation.
 uint32_t blob_size_from_asval(const as_val *val);
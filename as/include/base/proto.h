@@ -30,6 +30,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include "aerospike/as_val.h"
 #include "citrusleaf/cf_digest.h"
@@ -377,7 +378,7 @@ typedef struct cl_msg_s {
 #define AS_MSG_INFO3_CREATE_OR_REPLACE	(1 << 4) // completely replace existing record, or create new record
 #define AS_MSG_INFO3_REPLACE_ONLY		(1 << 5) // completely replace existing record, do not create new record
 #define AS_MSG_INFO3_BIN_REPLACE_ONLY	(1 << 6) // replace existing bin, do not create new bin
-// (Note:  Bit 7 is unused.)
+#define AS_MSG_INFO3_PIPELINE			(1 << 7) // don't wait for the response before reading the connection's next request
 
 #define AS_MSG_FIELD_SCAN_INCLUDE_LDT_DATA			(0x02) // whether to send ldt bin data back to the client
 #define AS_MSG_FIELD_SCAN_DISCONNECTED_JOB			(0x04) // for sproc jobs that won't be sending results back to the client [UNUSED]
@@ -499,6 +500,13 @@ as_proto_wrapped_is_valid(const as_proto *proto, size_t size)
 			as_proto_size_get(proto) == size;
 }
 
+// Response message made by as_msg_make_response_iov().
+typedef struct as_msg_iov_s {
+	struct iovec	*iov;
+	uint32_t		n_iov;
+	size_t			msg_sz;
+} as_msg_iov;
+
 extern void as_proto_swap(as_proto *m);
 extern void as_msg_swap_header(as_msg *m);
 extern void as_msg_swap_field(as_msg_field *mf);
@@ -513,6 +521,11 @@ extern cl_msg *as_msg_make_response_msg(uint32_t result_code, uint32_t generatio
 		uint32_t void_time, as_msg_op **ops, struct as_bin_s **bins,
 		uint16_t bin_count, struct as_namespace_s *ns, cl_msg *msgp_in,
 		size_t *msg_sz_in, uint64_t trid, const char *setname);
+extern bool as_msg_make_response_iov(uint32_t result_code, uint32_t generation,
+		uint32_t void_time, as_msg_op **ops, struct as_bin_s **bins,
+		uint16_t bin_count, struct as_namespace_s *ns, uint64_t trid,
+		const char *setname, as_msg_iov *mi);
+extern int as_msg_send_response_iov(struct as_file_handle_s *fd_h, as_msg_iov *mi);
 extern int as_msg_make_response_bufbuilder(struct as_index_s *r, struct as_storage_rd_s *rd,
 		cf_buf_builder **bb_r, bool nobindata, char *nsname, bool use_sets, bool include_key, bool skip_empty_records, cf_vector *);
 extern int as_msg_make_error_response_bufbuilder(cf_digest *keyd, int result_code,
@@ -22,6 +22,11 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include "mpmc_queue.h"
+#include "socket.h"
+
 #include "base/transaction.h"
 
 int thr_tsvc_process_or_enqueue(as_transaction *tr);
@@ -34,6 +39,12 @@ extern int thr_tsvc_queue_get_size();
 // Initialize the queues and start the handler threads.
 extern void as_tsvc_init();
 
+// Shard-per-core mode - service threads are the shards.
+extern void as_tsvc_shards_init(uint32_t n_shards);
+extern cf_socket* as_tsvc_shard_attach(uint32_t shard_id);
+extern void as_tsvc_shard_clear_wake();
+extern void as_tsvc_shard_drain();
+
 // Needed by XDR.
 #define MAX_TRANSACTION_QUEUES 128
-extern cf_queue *g_transaction_queues[MAX_TRANSACTION_QUEUES];
+extern mpmc_queue *g_transaction_queues[MAX_TRANSACTION_QUEUES];
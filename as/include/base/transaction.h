@@ -98,7 +98,10 @@ typedef struct as_file_handle_s {
 	cf_socket	*sock;			// our socket
 	cf_poll		poll;			// our epoll instance
 	bool		reap_me;		// tells the reaper to come and get us
-	bool		trans_active;	// a transaction is running on this connection
+	bool		pipelined;		// client has sent pipelined requests
+	bool		exclusive;		// a non-pipelined transaction is running - demarshal thread only
+	uint32_t	n_trans_active;	// number of transactions running on this connection
+	pthread_mutex_t send_lock;	// serializes pipelined responses
 	uint32_t	fh_info;		// bitmap containing status info of this file handle
 	as_proto	*proto;
 	uint64_t	proto_unread;
@@ -30,6 +30,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <linux/aio_abi.h>
 
 #include "citrusleaf/cf_atomic.h"
 #include "citrusleaf/cf_queue.h"
@@ -37,6 +38,7 @@
 #include "hist.h"
 
 #include "base/datamodel.h"
+#include "storage/drv_ssd_cache.h"
 
 
 //==========================================================
@@ -131,6 +133,40 @@ typedef enum {
 } e_free_to;
 
 
+//------------------------------------------------
+// A current write buffer and its lock. Writes are
+// spread over several of these per device, so
+// writers don't all contend on one lock.
+//
+typedef struct ssd_write_stripe_s {
+	pthread_mutex_t		lock;		// lock protects writes to swb
+	ssd_write_buf		*swb;		// swb currently being filled by writes
+	cf_atomic64			n_writes;	// number of swbs filled and queued from here
+} __attribute__ ((aligned(64))) ssd_write_stripe; // keep stripes off each other's cache lines
+
+
+//------------------------------------------------
+// Wblocks waiting to be defragged, bucketed by how
+// full they were when queued. Pops come from the
+// emptiest non-empty bucket, except that every so
+// often one comes from the next non-empty bucket
+// in turn, so fuller wblocks aren't starved.
+//
+#define SSD_DEFRAG_Q_N_BUCKETS 100
+#define SSD_DEFRAG_Q_FAIR_INTERVAL 16
+
+typedef struct ssd_defrag_q_s {
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	uint32_t			write_block_size;
+	uint32_t			n_wblocks;	// total over all buckets
+	uint32_t			min_bucket;	// buckets below this are empty
+	uint32_t			n_pops;
+	uint32_t			fair_bucket; // next bucket to take a fair turn
+	cf_queue			*buckets[SSD_DEFRAG_Q_N_BUCKETS];
+} ssd_defrag_q;
+
+
 //------------------------------------------------
 // Per-device information.
 //
@@ -143,22 +179,23 @@ typedef struct drv_ssd_s
 
 	uint32_t		running;
 
-	pthread_mutex_t	write_lock;			// lock protects writes to current swb
-	ssd_write_buf	*current_swb;		// swb currently being filled by writes
+	uint32_t		n_write_stripes;	// current swbs being filled concurrently
+	ssd_write_stripe write_stripes[MAX_SSD_WRITE_STRIPES];
 
 	pthread_mutex_t	defrag_lock;		// lock protects writes to defrag swb
 	ssd_write_buf	*defrag_swb;		// swb currently being filled by defrag
 
-	cf_queue		*fd_q;				// queue of open fds
-	cf_queue		*shadow_fd_q;		// queue of open fds on shadow, if any
+	int				fd;					// shared by all (positional) I/O
+	int				shadow_fd;			// shared by all shadow I/O, if any
 
 	cf_queue		*free_wblock_q;		// IDs of free wblocks
-	cf_queue		*defrag_wblock_q;	// IDs of wblocks to defrag
+	ssd_defrag_q	*defrag_wblock_q;	// IDs of wblocks to defrag, emptiest first
 
 	cf_queue		*swb_write_q;		// pointers to swbs ready to write
 	cf_queue		*swb_shadow_q;		// pointers to swbs ready to write to shadow, if any
 	cf_queue		*swb_free_q;		// pointers to swbs free and waiting
 	cf_queue		*post_write_q;		// pointers to swbs that have been written but are cached
+	ssd_read_cache	*read_cache;		// records read from device, if configured
 
 	cf_atomic_int	n_defrag_wblock_reads;	// total number of wblocks added to the defrag_wblock_q
 	cf_atomic_int	n_defrag_wblock_writes;	// total number of swbs added to the swb_write_q by defrag
@@ -185,11 +222,12 @@ typedef struct drv_ssd_s
 	bool			sub_sweep;
 
 	uint32_t		cold_start_block_counter;		// large blocks read
-	uint64_t		record_add_older_counter;		// records not inserted due to better existing one
-	uint64_t		record_add_expired_counter;		// records not inserted due to expiration
-	uint64_t		record_add_max_ttl_counter;		// records not inserted due to max-ttl
-	uint64_t		record_add_replace_counter;		// records reinserted
-	uint64_t		record_add_unique_counter;		// records inserted
+	uint8_t			*load_wblock_map;	// bitmap of wblocks in use at last clean shutdown, if known
+	cf_atomic64		record_add_older_counter;		// records not inserted due to better existing one
+	cf_atomic64		record_add_expired_counter;		// records not inserted due to expiration
+	cf_atomic64		record_add_max_ttl_counter;		// records not inserted due to max-ttl
+	cf_atomic64		record_add_replace_counter;		// records reinserted
+	cf_atomic64		record_add_unique_counter;		// records inserted
 	uint64_t		record_add_sigfail_counter;
 
 	ssd_alloc_table	*alloc_table;
@@ -200,6 +238,11 @@ typedef struct drv_ssd_s
 	pthread_t		load_device_thread;
 	pthread_t		defrag_thread;
 
+	aio_context_t	aio_ctx;			// kernel AIO context for async reads, if any
+	cf_atomic32		n_aio_reads;		// async reads currently in flight
+	pthread_t		aio_thread;			// reaps async read completions
+	cf_queue		*aio_done_q;		// reaped async reads, shared by namespace's devices
+
 	histogram		*hist_read;
 	histogram		*hist_large_block_read;
 	histogram		*hist_write;
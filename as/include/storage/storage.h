@@ -129,6 +129,23 @@ typedef struct {
     int		n_devices;
 } as_storage_attributes;
 
+// A record's device block, read (asynchronously) without the record lock held.
+// Only usable if the record has not moved on the device since the read began.
+typedef struct as_storage_prefetch_s {
+	uint32_t				file_id;
+	uint64_t				rblock_id;
+	uint32_t				n_rblocks;
+	uint8_t					*buf;		// null if the read failed
+	struct drv_ssd_block_s	*block;		// points into buf
+} as_storage_prefetch;
+
+// Called (on a storage thread) when an async read completes. Callee owns pf.
+typedef void (*as_storage_read_done_fn)(void *udata, as_storage_prefetch *pf);
+
+// Max async reads a thread may hold back while plugged - beyond this, reads
+// are synchronous until the thread unplugs.
+#define AS_STORAGE_MAX_PLUGGED_READS 64
+
 
 //------------------------------------------------
 // Generic "base class" functions that call
@@ -150,7 +167,11 @@ extern int as_storage_record_close(as_record *r, as_storage_rd *rd);
 
 // Called within as_storage_rd usage cycle.
 extern uint16_t as_storage_record_get_n_bins(as_storage_rd *rd);
+extern uint8_t *as_storage_record_detach_buf(as_storage_rd *rd);
 extern int as_storage_record_read(as_storage_rd *rd);
+extern bool as_storage_record_read_async(as_storage_rd *rd, as_storage_read_done_fn cb, void *udata); // false means caller must read synchronously
+extern void as_storage_record_adopt_prefetch(as_storage_rd *rd, as_storage_prefetch *pf); // consumes pf
+extern bool as_storage_record_is_cached(as_storage_rd *rd); // true means a read won't go to device
 extern int as_storage_particle_read_all(as_storage_rd *rd);
 extern bool as_storage_record_size_and_check(as_storage_rd *rd);
 extern int as_storage_record_write(as_record *r, as_storage_rd *rd);
@@ -182,6 +203,14 @@ extern uint64_t as_storage_record_get_n_bytes_memory(as_storage_rd *rd);
 extern void as_storage_record_adjust_mem_stats(as_storage_rd *rd, uint64_t start_bytes);
 extern void as_storage_record_drop_from_mem_stats(as_storage_rd *rd);
 extern bool as_storage_record_get_key(as_storage_rd *rd);
+extern void as_storage_prefetch_destroy(as_storage_prefetch *pf);
+
+// Hold back async reads started by this thread, and submit them together per
+// device on unplug. Must not unplug while holding a record lock - completions
+// of failed submissions run on the unplugging thread.
+extern void as_storage_read_plug();
+extern void as_storage_read_unplug();
+extern bool as_storage_read_is_plugged();
 extern size_t as_storage_record_rec_props_size(as_storage_rd *rd);
 extern void as_storage_record_set_rec_props(as_storage_rd *rd, uint8_t* rec_props_data);
 extern uint32_t as_storage_record_copy_rec_props(as_storage_rd *rd, as_rec_props *p_rec_props);
@@ -217,7 +246,11 @@ extern int as_storage_record_open_ssd(as_namespace *ns, as_record *r, as_storage
 extern int as_storage_record_close_ssd(as_record *r, as_storage_rd *rd);
 
 extern uint16_t as_storage_record_get_n_bins_ssd(as_storage_rd *rd);
+extern uint8_t *as_storage_record_detach_buf_ssd(as_storage_rd *rd);
 extern int as_storage_record_read_ssd(as_storage_rd *rd);
+extern bool as_storage_record_read_async_ssd(as_storage_rd *rd, as_storage_read_done_fn cb, void *udata);
+extern void as_storage_record_adopt_prefetch_ssd(as_storage_rd *rd, as_storage_prefetch *pf);
+extern bool as_storage_record_is_cached_ssd(as_storage_rd *rd);
 extern int as_storage_particle_read_all_ssd(as_storage_rd *rd);
 extern bool as_storage_record_size_and_check_ssd(as_storage_rd *rd);
 extern int as_storage_record_write_ssd(as_record *r, as_storage_rd *rd);
@@ -239,6 +272,9 @@ extern int as_storage_histogram_clear_ssd(as_namespace *ns);
 // Called by "base class" functions but not via table.
 extern bool as_storage_record_get_key_ssd(as_storage_rd *rd);
 extern void as_storage_shutdown_ssd(as_namespace *ns);
+extern void as_storage_read_plug_ssd();
+extern void as_storage_read_unplug_ssd();
+extern bool as_storage_read_is_plugged_ssd();
 
 
 //------------------------------------------------
@@ -36,6 +36,7 @@
 #include "base/stats.h"
 #include "base/thr_tsvc.h"
 #include "base/transaction.h"
+#include "storage/storage.h"
 #include "jem.h"
 #include "socket.h"
 #include <errno.h>
@@ -787,6 +788,13 @@ as_batch_queue_task(as_transaction* btr)
 	bool check_inline = (allow_inline && g_config.n_namespaces_not_in_memory != 0);
 	bool should_inline = (allow_inline && g_config.n_namespaces_not_in_memory == 0);
 
+	// Sub-transactions for namespaces doing async device reads are started
+	// inline - they don't block on the device. Their reads are held back and
+	// submitted together per device, so the batch waits for roughly the
+	// slowest read rather than the sum of them.
+	bool should_plug = false;
+	uint32_t n_plugged = 0;
+
 	// Split batch rows into separate single record read transactions.
 	// The read transactions are located in the same memory block as
 	// the original batch transactions. This allows us to avoid performing
@@ -833,10 +841,14 @@ as_batch_queue_task(as_transaction* btr)
 			data += sizeof(cl_msg);
 			mf = (as_msg_field*)data;
 			as_msg_swap_field(mf);
+			as_namespace* ns = as_namespace_get_bymsgfield(mf);
+
 			if (check_inline) {
-				as_namespace* ns = as_namespace_get_bymsgfield(mf);
 				should_inline = ns && ns->storage_data_in_memory;
 			}
+
+			should_plug = ns && ! ns->storage_data_in_memory &&
+					ns->storage_async_read_depth != 0;
 			mf = as_msg_field_get_next(mf);
 
 			// Swap remaining fields.
@@ -882,6 +894,12 @@ as_batch_queue_task(as_transaction* btr)
 
 		// Submit transaction.
 		if (should_inline) {
+			// Only plug for rows that may read async - submit what's held back.
+			if (n_plugged != 0) {
+				as_storage_read_unplug();
+				n_plugged = 0;
+			}
+
 			// Must copy generic transaction before processing inline, because some
 			// transaction fields are modified during the course of the transaction.
 			// We need each transaction to be initialized to proper values.
@@ -889,6 +907,21 @@ as_batch_queue_task(as_transaction* btr)
 			memcpy(&tmp, &tr, sizeof(as_transaction));
 			process_transaction(&tmp);
 		}
+		else if (should_plug) {
+			if (n_plugged == 0) {
+				as_storage_read_plug();
+			}
+
+			as_transaction tmp;
+			memcpy(&tmp, &tr, sizeof(as_transaction));
+			process_transaction(&tmp);
+
+			// Plug is full - submit what's held back and carry on.
+			if (++n_plugged == AS_STORAGE_MAX_PLUGGED_READS) {
+				as_storage_read_unplug();
+				n_plugged = 0;
+			}
+		}
 		else {
 			// Queue transaction to be processed by a transaction thread.
 			thr_tsvc_enqueue(&tr);
@@ -897,6 +930,10 @@ as_batch_queue_task(as_transaction* btr)
 	}
 
 TranEnd:
+	if (n_plugged != 0) {
+		as_storage_read_unplug();
+	}
+
 	if (tran_row < tran_count) {
 		// Mismatch between tran_count and actual data.  Terminate transaction.
 		cf_warning(AS_BATCH, "Batch keys mismatch. Expected %u Received %u", tran_count, tran_row);
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/resource.h>
+#include <unistd.h>
 
 #include "xdr_config.h"
 
@@ -54,6 +55,7 @@
 
 #include "base/cluster_config.h"
 #include "base/datamodel.h"
+#include "base/index.h"
 #include "base/ldt.h"
 #include "base/proto.h"
 #include "base/secondary_index.h"
@@ -136,6 +138,7 @@ cfg_set_defaults()
 	c->nsup_delete_sleep = 100; // 100 microseconds means a delete rate of 10k TPS
 	c->nsup_period = 120; // run nsup once every 2 minutes
 	c->nsup_startup_evict = true;
+	c->nsup_threads = 1;
 	c->paxos_max_cluster_size = AS_CLUSTER_DEFAULT_SZ; // default the maximum cluster size to a "reasonable" value
 	c->paxos_protocol = AS_PAXOS_PROTOCOL_V3; // default to 3.0 "sindex" paxos protocol version
 	c->paxos_recovery_policy = AS_PAXOS_RECOVERY_POLICY_AUTO_RESET_MASTER; // default to auto reset master
@@ -282,11 +285,13 @@ typedef enum {
 	CASE_SERVICE_NSUP_DELETE_SLEEP,
 	CASE_SERVICE_NSUP_PERIOD,
 	CASE_SERVICE_NSUP_STARTUP_EVICT,
+	CASE_SERVICE_NSUP_THREADS,
 	CASE_SERVICE_PAXOS_MAX_CLUSTER_SIZE,
 	CASE_SERVICE_PAXOS_PROTOCOL,
 	CASE_SERVICE_PAXOS_RECOVERY_POLICY,
 	CASE_SERVICE_PAXOS_RETRANSMIT_PERIOD,
 	CASE_SERVICE_PROTO_FD_IDLE_MS,
+	CASE_SERVICE_PROTO_PIPELINE_MAX,
 	CASE_SERVICE_QUERY_BATCH_SIZE,
 	CASE_SERVICE_QUERY_BUFPOOL_SIZE,
 	CASE_SERVICE_QUERY_IN_TRANSACTION_THREAD,
@@ -302,12 +307,14 @@ typedef enum {
 	CASE_SERVICE_QUERY_THRESHOLD,
 	CASE_SERVICE_QUERY_UNTRACKED_TIME_MS,
 	CASE_SERVICE_QUERY_WORKER_THREADS,
+	CASE_SERVICE_RECORD_LOCKS_ADAPTIVE,
 	CASE_SERVICE_RESPOND_CLIENT_ON_MASTER_COMPLETION,
 	CASE_SERVICE_RUN_AS_DAEMON,
 	CASE_SERVICE_SCAN_MAX_ACTIVE,
 	CASE_SERVICE_SCAN_MAX_DONE,
 	CASE_SERVICE_SCAN_MAX_UDF_TRANSACTIONS,
 	CASE_SERVICE_SCAN_THREADS,
+	CASE_SERVICE_SHARD_TRANSACTIONS,
 	CASE_SERVICE_SINDEX_BUILDER_THREADS,
 	CASE_SERVICE_SINDEX_DATA_MAX_MEMORY,
 	CASE_SERVICE_TICKER_INTERVAL,
@@ -353,7 +360,6 @@ typedef enum {
 	CASE_SERVICE_NSUP_QUEUE_ESCAPE,
 	CASE_SERVICE_NSUP_REDUCE_PRIORITY,
 	CASE_SERVICE_NSUP_REDUCE_SLEEP,
-	CASE_SERVICE_NSUP_THREADS,
 	CASE_SERVICE_REPLICATION_FIRE_AND_FORGET,
 	CASE_SERVICE_SCAN_MEMORY,
 	CASE_SERVICE_SCAN_PRIORITY,
@@ -412,6 +418,7 @@ typedef enum {
 	CASE_NETWORK_SERVICE_ALTERNATE_ADDRESS,
 	CASE_NETWORK_SERVICE_NETWORK_INTERFACE_NAME,
 	CASE_NETWORK_SERVICE_REUSE_ADDRESS,
+	CASE_NETWORK_SERVICE_REUSE_PORT,
 
 	// Network heartbeat options:
 	// Normally visible, in canonical configuration file order:
@@ -484,9 +491,13 @@ typedef enum {
 	CASE_NAMESPACE_ENABLE_BENCHMARKS_WRITE,
 	CASE_NAMESPACE_ENABLE_HIST_PROXY,
 	CASE_NAMESPACE_EVICT_HIST_BUCKETS,
+	CASE_NAMESPACE_EVICT_POLICY,
+	CASE_NAMESPACE_EVICT_SAMPLE_SIZE,
 	CASE_NAMESPACE_EVICT_TENTHS_PCT,
+	CASE_NAMESPACE_EXPIRATION_INDEX,
 	CASE_NAMESPACE_HIGH_WATER_DISK_PCT,
 	CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT,
+	CASE_NAMESPACE_INDEX_HUGE_PAGES,
 	CASE_NAMESPACE_LDT_ENABLED,
 	CASE_NAMESPACE_LDT_GC_RATE,
 	CASE_NAMESPACE_LDT_PAGE_SIZE,
@@ -494,6 +505,7 @@ typedef enum {
 	CASE_NAMESPACE_MIGRATE_ORDER,
 	CASE_NAMESPACE_MIGRATE_SLEEP,
 	CASE_NAMESPACE_OBJ_SIZE_HIST_MAX,
+	CASE_NAMESPACE_PARTITION_TREE_SPRIGS,
 	CASE_NAMESPACE_READ_CONSISTENCY_LEVEL_OVERRIDE,
 	CASE_NAMESPACE_SET_BEGIN,
 	CASE_NAMESPACE_SI_BEGIN,
@@ -513,6 +525,11 @@ typedef enum {
 	CASE_NAMESPACE_CONFLICT_RESOLUTION_GENERATION,
 	CASE_NAMESPACE_CONFLICT_RESOLUTION_LAST_UPDATE_TIME,
 
+	// Namespace evict-policy options (value tokens):
+	CASE_NAMESPACE_EVICT_POLICY_TTL,
+	CASE_NAMESPACE_EVICT_POLICY_LRU,
+	CASE_NAMESPACE_EVICT_POLICY_LFU,
+
 	// Namespace read consistency level options:
 	CASE_NAMESPACE_READ_CONSISTENCY_ALL,
 	CASE_NAMESPACE_READ_CONSISTENCY_OFF,
@@ -523,6 +540,10 @@ typedef enum {
 	CASE_NAMESPACE_WRITE_COMMIT_MASTER,
 	CASE_NAMESPACE_WRITE_COMMIT_OFF,
 
+	// Namespace storage-engine device compression options (value tokens):
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_NONE,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB,
+
 	// Namespace storage-engine options (value tokens):
 	CASE_NAMESPACE_STORAGE_MEMORY,
 	CASE_NAMESPACE_STORAGE_SSD,
@@ -539,7 +560,12 @@ typedef enum {
 	CASE_NAMESPACE_STORAGE_DEVICE_MEMORY_ALL, // renamed
 	CASE_NAMESPACE_STORAGE_DEVICE_DATA_IN_MEMORY,
 	// Normally hidden:
+	CASE_NAMESPACE_STORAGE_DEVICE_ASYNC_READ_DEPTH,
 	CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_EMPTY,
+	CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_THREADS,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION,
+	CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LEVEL,
+	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_ADAPTIVE,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_LWM_PCT,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_QUEUE_MIN,
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_SLEEP,
@@ -551,6 +577,8 @@ typedef enum {
 	CASE_NAMESPACE_STORAGE_DEVICE_MAX_WRITE_CACHE,
 	CASE_NAMESPACE_STORAGE_DEVICE_MIN_AVAIL_PCT,
 	CASE_NAMESPACE_STORAGE_DEVICE_POST_WRITE_QUEUE,
+	CASE_NAMESPACE_STORAGE_DEVICE_READ_CACHE_SIZE,
+	CASE_NAMESPACE_STORAGE_DEVICE_WRITE_STRIPES,
 	CASE_NAMESPACE_STORAGE_DEVICE_WRITE_THREADS,
 	// Deprecated:
 	CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_MAX_BLOCKS,
@@ -699,11 +727,13 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "nsup-delete-sleep",				CASE_SERVICE_NSUP_DELETE_SLEEP },
 		{ "nsup-period",					CASE_SERVICE_NSUP_PERIOD },
 		{ "nsup-startup-evict",				CASE_SERVICE_NSUP_STARTUP_EVICT },
+		{ "nsup-threads",					CASE_SERVICE_NSUP_THREADS },
 		{ "paxos-max-cluster-size",			CASE_SERVICE_PAXOS_MAX_CLUSTER_SIZE },
 		{ "paxos-protocol",					CASE_SERVICE_PAXOS_PROTOCOL },
 		{ "paxos-recovery-policy",			CASE_SERVICE_PAXOS_RECOVERY_POLICY },
 		{ "paxos-retransmit-period",		CASE_SERVICE_PAXOS_RETRANSMIT_PERIOD },
 		{ "proto-fd-idle-ms",				CASE_SERVICE_PROTO_FD_IDLE_MS },
+		{ "proto-pipeline-max",				CASE_SERVICE_PROTO_PIPELINE_MAX },
 		{ "query-batch-size",				CASE_SERVICE_QUERY_BATCH_SIZE },
 		{ "query-bufpool-size",				CASE_SERVICE_QUERY_BUFPOOL_SIZE },
 		{ "query-in-transaction-thread",	CASE_SERVICE_QUERY_IN_TRANSACTION_THREAD },
@@ -719,12 +749,14 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "query-threshold", 				CASE_SERVICE_QUERY_THRESHOLD },
 		{ "query-untracked-time-ms",		CASE_SERVICE_QUERY_UNTRACKED_TIME_MS },
 		{ "query-worker-threads",			CASE_SERVICE_QUERY_WORKER_THREADS },
+		{ "record-locks-adaptive",			CASE_SERVICE_RECORD_LOCKS_ADAPTIVE },
 		{ "respond-client-on-master-completion", CASE_SERVICE_RESPOND_CLIENT_ON_MASTER_COMPLETION },
 		{ "run-as-daemon",					CASE_SERVICE_RUN_AS_DAEMON },
 		{ "scan-max-active",				CASE_SERVICE_SCAN_MAX_ACTIVE },
 		{ "scan-max-done",					CASE_SERVICE_SCAN_MAX_DONE },
 		{ "scan-max-udf-transactions",		CASE_SERVICE_SCAN_MAX_UDF_TRANSACTIONS },
 		{ "scan-threads",					CASE_SERVICE_SCAN_THREADS },
+		{ "shard-transactions",				CASE_SERVICE_SHARD_TRANSACTIONS },
 		{ "sindex-builder-threads",			CASE_SERVICE_SINDEX_BUILDER_THREADS },
 		{ "sindex-data-max-memory",			CASE_SERVICE_SINDEX_DATA_MAX_MEMORY },
 		{ "ticker-interval",				CASE_SERVICE_TICKER_INTERVAL },
@@ -768,7 +800,6 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "nsup-queue-lwm",					CASE_SERVICE_NSUP_QUEUE_LWM },
 		{ "nsup-reduce-priority",			CASE_SERVICE_NSUP_REDUCE_PRIORITY },
 		{ "nsup-reduce-sleep",				CASE_SERVICE_NSUP_REDUCE_SLEEP },
-		{ "nsup-threads",					CASE_SERVICE_NSUP_THREADS },
 		{ "replication-fire-and-forget",	CASE_SERVICE_REPLICATION_FIRE_AND_FORGET },
 		{ "scan-memory",					CASE_SERVICE_SCAN_MEMORY },
 		{ "scan-priority",					CASE_SERVICE_SCAN_PRIORITY },
@@ -827,6 +858,7 @@ const cfg_opt NETWORK_SERVICE_OPTS[] = {
 		{ "alternate-address",				CASE_NETWORK_SERVICE_ALTERNATE_ADDRESS },
 		{ "network-interface-name",			CASE_NETWORK_SERVICE_NETWORK_INTERFACE_NAME },
 		{ "reuse-address",					CASE_NETWORK_SERVICE_REUSE_ADDRESS },
+		{ "reuse-port",						CASE_NETWORK_SERVICE_REUSE_PORT },
 		{ "}",								CASE_CONTEXT_END }
 };
 
@@ -900,9 +932,13 @@ const cfg_opt NAMESPACE_OPTS[] = {
 		{ "enable-benchmarks-write",		CASE_NAMESPACE_ENABLE_BENCHMARKS_WRITE },
 		{ "enable-hist-proxy",				CASE_NAMESPACE_ENABLE_HIST_PROXY },
 		{ "evict-hist-buckets",				CASE_NAMESPACE_EVICT_HIST_BUCKETS },
+		{ "evict-policy",					CASE_NAMESPACE_EVICT_POLICY },
+		{ "evict-sample-size",				CASE_NAMESPACE_EVICT_SAMPLE_SIZE },
 		{ "evict-tenths-pct",				CASE_NAMESPACE_EVICT_TENTHS_PCT },
+		{ "expiration-index",				CASE_NAMESPACE_EXPIRATION_INDEX },
 		{ "high-water-disk-pct",			CASE_NAMESPACE_HIGH_WATER_DISK_PCT },
 		{ "high-water-memory-pct",			CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT },
+		{ "index-huge-pages",				CASE_NAMESPACE_INDEX_HUGE_PAGES },
 		{ "ldt-enabled",					CASE_NAMESPACE_LDT_ENABLED },
 		{ "ldt-gc-rate",					CASE_NAMESPACE_LDT_GC_RATE },
 		{ "ldt-page-size",					CASE_NAMESPACE_LDT_PAGE_SIZE },
@@ -910,6 +946,7 @@ const cfg_opt NAMESPACE_OPTS[] = {
 		{ "migrate-order",					CASE_NAMESPACE_MIGRATE_ORDER },
 		{ "migrate-sleep",					CASE_NAMESPACE_MIGRATE_SLEEP},
 		{ "obj-size-hist-max",				CASE_NAMESPACE_OBJ_SIZE_HIST_MAX },
+		{ "partition-tree-sprigs",			CASE_NAMESPACE_PARTITION_TREE_SPRIGS },
 		{ "read-consistency-level-override", CASE_NAMESPACE_READ_CONSISTENCY_LEVEL_OVERRIDE },
 		{ "set",							CASE_NAMESPACE_SET_BEGIN },
 		{ "si",								CASE_NAMESPACE_SI_BEGIN },
@@ -931,6 +968,12 @@ const cfg_opt NAMESPACE_CONFLICT_RESOLUTION_OPTS[] = {
 		{ "last-update-time",				CASE_NAMESPACE_CONFLICT_RESOLUTION_LAST_UPDATE_TIME }
 };
 
+const cfg_opt NAMESPACE_EVICT_POLICY_OPTS[] = {
+		{ "ttl",							CASE_NAMESPACE_EVICT_POLICY_TTL },
+		{ "lru",							CASE_NAMESPACE_EVICT_POLICY_LRU },
+		{ "lfu",							CASE_NAMESPACE_EVICT_POLICY_LFU }
+};
+
 const cfg_opt NAMESPACE_READ_CONSISTENCY_OPTS[] = {
 		{ "all",							CASE_NAMESPACE_READ_CONSISTENCY_ALL },
 		{ "off",							CASE_NAMESPACE_READ_CONSISTENCY_OFF },
@@ -943,6 +986,11 @@ const cfg_opt NAMESPACE_WRITE_COMMIT_OPTS[] = {
 		{ "off",							CASE_NAMESPACE_WRITE_COMMIT_OFF }
 };
 
+const cfg_opt NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS[] = {
+		{ "none",							CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_NONE },
+		{ "zlib",							CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB }
+};
+
 const cfg_opt NAMESPACE_STORAGE_OPTS[] = {
 		{ "memory",							CASE_NAMESPACE_STORAGE_MEMORY },
 		{ "ssd",							CASE_NAMESPACE_STORAGE_SSD },
@@ -958,7 +1006,12 @@ const cfg_opt NAMESPACE_STORAGE_DEVICE_OPTS[] = {
 		{ "write-block-size",				CASE_NAMESPACE_STORAGE_DEVICE_WRITE_BLOCK_SIZE },
 		{ "memory-all",						CASE_NAMESPACE_STORAGE_DEVICE_MEMORY_ALL },
 		{ "data-in-memory",					CASE_NAMESPACE_STORAGE_DEVICE_DATA_IN_MEMORY },
+		{ "async-read-depth",				CASE_NAMESPACE_STORAGE_DEVICE_ASYNC_READ_DEPTH },
 		{ "cold-start-empty",				CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_EMPTY },
+		{ "cold-start-threads",				CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_THREADS },
+		{ "compression",					CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION },
+		{ "compression-level",				CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LEVEL },
+		{ "defrag-adaptive",				CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_ADAPTIVE },
 		{ "defrag-lwm-pct",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_LWM_PCT },
 		{ "defrag-queue-min",				CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_QUEUE_MIN },
 		{ "defrag-sleep",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_SLEEP },
@@ -970,6 +1023,8 @@ const cfg_opt NAMESPACE_STORAGE_DEVICE_OPTS[] = {
 		{ "max-write-cache",				CASE_NAMESPACE_STORAGE_DEVICE_MAX_WRITE_CACHE },
 		{ "min-avail-pct",					CASE_NAMESPACE_STORAGE_DEVICE_MIN_AVAIL_PCT },
 		{ "post-write-queue",				CASE_NAMESPACE_STORAGE_DEVICE_POST_WRITE_QUEUE },
+		{ "read-cache-size",				CASE_NAMESPACE_STORAGE_DEVICE_READ_CACHE_SIZE },
+		{ "write-stripes",					CASE_NAMESPACE_STORAGE_DEVICE_WRITE_STRIPES },
 		{ "write-threads",					CASE_NAMESPACE_STORAGE_DEVICE_WRITE_THREADS },
 		{ "defrag-max-blocks",				CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_MAX_BLOCKS },
 		{ "defrag-period",					CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_PERIOD },
@@ -1097,10 +1152,12 @@ const int NUM_NETWORK_FABRIC_OPTS					= sizeof(NETWORK_FABRIC_OPTS) / sizeof(cfg
 const int NUM_NETWORK_INFO_OPTS						= sizeof(NETWORK_INFO_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_OPTS						= sizeof(NAMESPACE_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_CONFLICT_RESOLUTION_OPTS	= sizeof(NAMESPACE_CONFLICT_RESOLUTION_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_EVICT_POLICY_OPTS			= sizeof(NAMESPACE_EVICT_POLICY_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_READ_CONSISTENCY_OPTS		= sizeof(NAMESPACE_READ_CONSISTENCY_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_WRITE_COMMIT_OPTS			= sizeof(NAMESPACE_WRITE_COMMIT_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_STORAGE_OPTS				= sizeof(NAMESPACE_STORAGE_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_STORAGE_DEVICE_OPTS			= sizeof(NAMESPACE_STORAGE_DEVICE_OPTS) / sizeof(cfg_opt);
+const int NUM_NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS	= sizeof(NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_STORAGE_KV_OPTS				= sizeof(NAMESPACE_STORAGE_KV_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_SET_OPTS					= sizeof(NAMESPACE_SET_OPTS) / sizeof(cfg_opt);
 const int NUM_NAMESPACE_SET_ENABLE_XDR_OPTS			= sizeof(NAMESPACE_SET_ENABLE_XDR_OPTS) / sizeof(cfg_opt);
@@ -2016,6 +2073,9 @@ as_config_init(const char *config_file)
 			case CASE_SERVICE_NSUP_STARTUP_EVICT:
 				c->nsup_startup_evict = cfg_bool(&line);
 				break;
+			case CASE_SERVICE_NSUP_THREADS:
+				c->nsup_threads = cfg_u32(&line, 1, MAX_NSUP_THREADS);
+				break;
 			case CASE_SERVICE_PAXOS_MAX_CLUSTER_SIZE:
 				c->paxos_max_cluster_size = cfg_u64(&line, 2, AS_CLUSTER_SZ);
 				break;
@@ -2056,6 +2116,9 @@ as_config_init(const char *config_file)
 			case CASE_SERVICE_PROTO_FD_IDLE_MS:
 				c->proto_fd_idle_ms = cfg_int_no_checks(&line);
 				break;
+			case CASE_SERVICE_PROTO_PIPELINE_MAX:
+				c->proto_pipeline_max = cfg_u32(&line, 0, MAX_PROTO_PIPELINE);
+				break;
 			case CASE_SERVICE_QUERY_BATCH_SIZE:
 				c->query_bsize = cfg_int_no_checks(&line);
 				break;
@@ -2101,6 +2164,9 @@ as_config_init(const char *config_file)
 			case CASE_SERVICE_QUERY_WORKER_THREADS:
 				c->query_worker_threads = cfg_u32(&line, 1, AS_QUERY_MAX_WORKER_THREADS);
 				break;
+			case CASE_SERVICE_RECORD_LOCKS_ADAPTIVE:
+				c->record_locks_adaptive = cfg_bool(&line);
+				break;
 			case CASE_SERVICE_RESPOND_CLIENT_ON_MASTER_COMPLETION:
 				c->respond_client_on_master_completion = cfg_bool(&line);
 				break;
@@ -2119,6 +2185,9 @@ as_config_init(const char *config_file)
 			case CASE_SERVICE_SCAN_THREADS:
 				c->scan_threads = cfg_u32(&line, 0, 32);
 				break;
+			case CASE_SERVICE_SHARD_TRANSACTIONS:
+				c->shard_transactions = cfg_bool(&line);
+				break;
 			case CASE_SERVICE_SINDEX_BUILDER_THREADS:
 				c->sindex_builder_threads = cfg_u32(&line, 1, MAX_SINDEX_BUILDER_THREADS);
 				break;
@@ -2193,7 +2262,6 @@ as_config_init(const char *config_file)
 			case CASE_SERVICE_NSUP_QUEUE_LWM:
 			case CASE_SERVICE_NSUP_REDUCE_PRIORITY:
 			case CASE_SERVICE_NSUP_REDUCE_SLEEP:
-			case CASE_SERVICE_NSUP_THREADS:
 			case CASE_SERVICE_REPLICATION_FIRE_AND_FORGET:
 			case CASE_SERVICE_SCAN_MEMORY:
 			case CASE_SERVICE_SCAN_PRIORITY:
@@ -2349,6 +2417,9 @@ as_config_init(const char *config_file)
 			case CASE_NETWORK_SERVICE_REUSE_ADDRESS:
 				c->socket_reuse_addr = cfg_bool_no_value_is_true(&line);
 				break;
+			case CASE_NETWORK_SERVICE_REUSE_PORT:
+				c->socket_reuse_port = cfg_bool_no_value_is_true(&line);
+				break;
 			case CASE_CONTEXT_END:
 				cfg_end_context(&state);
 				break;
@@ -2617,15 +2688,41 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_EVICT_HIST_BUCKETS:
 				ns->evict_hist_buckets = cfg_u32(&line, 100, 10000000);
 				break;
+			case CASE_NAMESPACE_EVICT_POLICY:
+				switch(cfg_find_tok(line.val_tok_1, NAMESPACE_EVICT_POLICY_OPTS, NUM_NAMESPACE_EVICT_POLICY_OPTS)) {
+				case CASE_NAMESPACE_EVICT_POLICY_TTL:
+					ns->evict_policy = AS_EVICT_POLICY_TTL;
+					break;
+				case CASE_NAMESPACE_EVICT_POLICY_LRU:
+					ns->evict_policy = AS_EVICT_POLICY_LRU;
+					break;
+				case CASE_NAMESPACE_EVICT_POLICY_LFU:
+					ns->evict_policy = AS_EVICT_POLICY_LFU;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_NAMESPACE_EVICT_SAMPLE_SIZE:
+				ns->evict_sample_size = cfg_u32(&line, 2, 1024);
+				break;
 			case CASE_NAMESPACE_EVICT_TENTHS_PCT:
 				ns->evict_tenths_pct = cfg_u32_no_checks(&line);
 				break;
+			case CASE_NAMESPACE_EXPIRATION_INDEX:
+				ns->expiration_index = cfg_bool(&line);
+				break;
 			case CASE_NAMESPACE_HIGH_WATER_DISK_PCT:
 				ns->hwm_disk = (float)cfg_pct_fraction(&line);
 				break;
 			case CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT:
 				ns->hwm_memory = (float)cfg_pct_fraction(&line);
 				break;
+			case CASE_NAMESPACE_INDEX_HUGE_PAGES:
+				ns->index_huge_pages = cfg_bool(&line);
+				break;
 			case CASE_NAMESPACE_LDT_ENABLED:
 				ns->ldt_enabled = cfg_bool(&line);
 				break;
@@ -2647,6 +2744,13 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_OBJ_SIZE_HIST_MAX:
 				ns->obj_size_hist_max = cfg_obj_size_hist_max(cfg_u32_no_checks(&line));
 				break;
+			case CASE_NAMESPACE_PARTITION_TREE_SPRIGS:
+				ns->partition_tree_sprigs = cfg_u32(&line, 1, AS_INDEX_MAX_SPRIGS);
+				if ((ns->partition_tree_sprigs & (ns->partition_tree_sprigs - 1)) != 0) {
+					cf_crash_nostack(AS_CFG, "line %d :: %s must be a power of 2, not %u",
+							line.num, line.name_tok, ns->partition_tree_sprigs);
+				}
+				break;
 			case CASE_NAMESPACE_READ_CONSISTENCY_LEVEL_OVERRIDE:
 				switch(cfg_find_tok(line.val_tok_1, NAMESPACE_READ_CONSISTENCY_OPTS, NUM_NAMESPACE_READ_CONSISTENCY_OPTS)) {
 				case CASE_NAMESPACE_READ_CONSISTENCY_ALL:
@@ -2725,6 +2829,9 @@ as_config_init(const char *config_file)
 				if (ns->default_ttl > ns->max_ttl) {
 					cf_crash_nostack(AS_CFG, "ns %s default-ttl can't be > max-ttl", ns->name);
 				}
+				if (ns->evict_policy != AS_EVICT_POLICY_TTL && (ns->storage_data_in_memory || ns->single_bin)) {
+					cf_crash_nostack(AS_CFG, "ns %s evict-policy lru or lfu requires data-in-memory and single-bin both false", ns->name);
+				}
 				if (ns->storage_data_in_memory) {
 					ns->storage_post_write_queue = 0; // override default (or configuration mistake)
 					c->n_namespaces_in_memory++;
@@ -2771,9 +2878,35 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_STORAGE_DEVICE_DATA_IN_MEMORY:
 				ns->storage_data_in_memory = cfg_bool(&line);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_ASYNC_READ_DEPTH:
+				ns->storage_async_read_depth = cfg_u32(&line, 0, 64 * 1024);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_EMPTY:
 				ns->storage_cold_start_empty = cfg_bool(&line);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COLD_START_THREADS:
+				ns->storage_cold_start_threads = cfg_u32(&line, 1, 128);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION:
+				switch(cfg_find_tok(line.val_tok_1, NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS, NUM_NAMESPACE_STORAGE_DEVICE_COMPRESSION_OPTS)) {
+				case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_NONE:
+					ns->storage_compression = AS_STORAGE_COMPRESSION_NONE;
+					break;
+				case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_ZLIB:
+					ns->storage_compression = AS_STORAGE_COMPRESSION_ZLIB;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_COMPRESSION_LEVEL:
+				ns->storage_compression_level = cfg_u32(&line, 1, 9);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_ADAPTIVE:
+				ns->storage_defrag_adaptive = cfg_bool(&line);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_DEFRAG_LWM_PCT:
 				ns->storage_defrag_lwm_pct = cfg_u32_no_checks(&line);
 				break;
@@ -2807,6 +2940,12 @@ as_config_init(const char *config_file)
 			case CASE_NAMESPACE_STORAGE_DEVICE_POST_WRITE_QUEUE:
 				ns->storage_post_write_queue = cfg_u32(&line, 0, 2 * 1024);
 				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_READ_CACHE_SIZE:
+				ns->storage_read_cache_size = cfg_u64_no_checks(&line);
+				break;
+			case CASE_NAMESPACE_STORAGE_DEVICE_WRITE_STRIPES:
+				ns->storage_write_stripes = cfg_u32(&line, 1, MAX_SSD_WRITE_STRIPES);
+				break;
 			case CASE_NAMESPACE_STORAGE_DEVICE_WRITE_THREADS:
 				ns->storage_write_threads = cfg_u32_no_checks(&line);
 				break;
@@ -3290,8 +3429,15 @@ as_config_post_process(as_config *c, const char *config_file)
 	cf_info(AS_CFG, "system file descriptor limit: %lu, proto-fd-max: %d", fd_limit.rlim_cur, c->n_proto_fd_max);
 
 	// Allocate and initialize the record locks (olocks). Maybe not the best
-	// place for this, unless we make number of locks configurable.
-	g_record_locks = olock_create(16 * 1024, true);
+	// place for this. Number of locks scales with the number of cpus.
+	long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t n_record_locks = olock_n_locks_for_cpus(n_cpus > 0 ? (uint32_t)n_cpus : 1);
+
+	if (! (g_record_locks = olock_create(n_record_locks, c->record_locks_adaptive))) {
+		cf_crash(AS_CFG, "failed to create %u record locks", n_record_locks);
+	}
+
+	cf_info(AS_CFG, "record locks: %u%s", n_record_locks, c->record_locks_adaptive ? " (adaptive)" : "");
 
 	// Setup performance metrics histograms.
 	cfg_create_all_histograms();
@@ -0,0 +1,276 @@
+/*
+ * expire_index.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "base/expire_index.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_digest.h"
+
+#include "fault.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Each bucket ("slot") holds entries whose void-times fall in one BUCKET_SEC
+// interval. Entries too far ahead for the wheel wait in an overflow list, which
+// is re-bucketed every half turn of the wheel.
+
+#define N_BUCKETS			1024
+#define BUCKET_SEC			60 // wheel spans ~17 hours
+#define CHUNK_N_ENTRIES		84 // chunk is ~2K
+
+typedef struct expire_entry_s {
+	cf_digest	keyd;
+	uint32_t	void_time;
+} expire_entry;
+
+typedef struct expire_chunk_s {
+	struct expire_chunk_s*	next;
+	uint32_t				n_entries;
+	expire_entry			entries[CHUNK_N_ENTRIES];
+} expire_chunk;
+
+struct as_expire_index_s {
+	pthread_mutex_t	lock;
+	uint32_t		next_slot; // oldest slot not yet popped
+	uint64_t		n_entries;
+	expire_chunk*	overflow;
+	expire_chunk*	buckets[N_BUCKETS];
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static inline uint32_t slot_of(uint32_t void_time);
+static void insert_entry(as_expire_index* ei, const cf_digest* keyd, uint32_t void_time);
+static void push_entry(expire_chunk** p_head, const cf_digest* keyd, uint32_t void_time);
+static void rebucket_overflow(as_expire_index* ei);
+static void free_chunks(expire_chunk* chunk);
+
+
+//==========================================================
+// Public API.
+//
+
+as_expire_index*
+as_expire_index_create(uint32_t now)
+{
+	as_expire_index* ei = cf_calloc(1, sizeof(as_expire_index));
+
+	if (! ei) {
+		cf_crash(AS_NSUP, "failed expire index allocation");
+	}
+
+	pthread_mutex_init(&ei->lock, NULL);
+	ei->next_slot = slot_of(now);
+
+	return ei;
+}
+
+
+void
+as_expire_index_destroy(as_expire_index* ei)
+{
+	for (int i = 0; i < N_BUCKETS; i++) {
+		free_chunks(ei->buckets[i]);
+	}
+
+	free_chunks(ei->overflow);
+	pthread_mutex_destroy(&ei->lock);
+	cf_free(ei);
+}
+
+
+void
+as_expire_index_add(as_expire_index* ei, const cf_digest* keyd,
+		uint32_t old_void_time, uint32_t void_time)
+{
+	if (void_time == 0) {
+		return;
+	}
+
+	// Existing entry comes due first, and will be re-added if need be.
+	if (old_void_time != 0 && slot_of(void_time) >= slot_of(old_void_time)) {
+		return;
+	}
+
+	pthread_mutex_lock(&ei->lock);
+	insert_entry(ei, keyd, void_time);
+	pthread_mutex_unlock(&ei->lock);
+}
+
+
+uint64_t
+as_expire_index_pop_due(as_expire_index* ei, uint32_t now,
+		as_expire_index_fn cb, void* udata)
+{
+	uint32_t now_slot = slot_of(now);
+	uint64_t n_popped = 0;
+
+	while (true) {
+		pthread_mutex_lock(&ei->lock);
+
+		// Only pop buckets entirely in the past - every entry still current is
+		// then sure to be expired.
+		if (ei->next_slot >= now_slot) {
+			pthread_mutex_unlock(&ei->lock);
+			break;
+		}
+
+		expire_chunk** p_bucket = &ei->buckets[ei->next_slot % N_BUCKETS];
+		expire_chunk* chunk = *p_bucket;
+
+		*p_bucket = NULL;
+		ei->next_slot++;
+
+		for (expire_chunk* c = chunk; c; c = c->next) {
+			ei->n_entries -= c->n_entries;
+		}
+
+		if (ei->next_slot % (N_BUCKETS / 2) == 0) {
+			rebucket_overflow(ei);
+		}
+
+		pthread_mutex_unlock(&ei->lock);
+
+		// Callbacks are made outside the lock - they may write records.
+		for (expire_chunk* c = chunk; c; c = c->next) {
+			for (uint32_t i = 0; i < c->n_entries; i++) {
+				cb(&c->entries[i].keyd, c->entries[i].void_time, udata);
+			}
+
+			n_popped += c->n_entries;
+		}
+
+		free_chunks(chunk);
+	}
+
+	return n_popped;
+}
+
+
+// Not under lock - approximate.
+uint64_t
+as_expire_index_n_entries(as_expire_index* ei)
+{
+	return ei->n_entries;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static inline uint32_t
+slot_of(uint32_t void_time)
+{
+	return void_time / BUCKET_SEC;
+}
+
+
+// Caller must hold the lock.
+static void
+insert_entry(as_expire_index* ei, const cf_digest* keyd, uint32_t void_time)
+{
+	uint32_t slot = slot_of(void_time);
+
+	// Bucket already popped - put it in the next one to be popped.
+	if (slot < ei->next_slot) {
+		slot = ei->next_slot;
+	}
+
+	if (slot - ei->next_slot >= N_BUCKETS) {
+		push_entry(&ei->overflow, keyd, void_time);
+	}
+	else {
+		push_entry(&ei->buckets[slot % N_BUCKETS], keyd, void_time);
+	}
+
+	ei->n_entries++;
+}
+
+
+static void
+push_entry(expire_chunk** p_head, const cf_digest* keyd, uint32_t void_time)
+{
+	expire_chunk* head = *p_head;
+
+	if (! head || head->n_entries == CHUNK_N_ENTRIES) {
+		expire_chunk* chunk = cf_malloc(sizeof(expire_chunk));
+
+		if (! chunk) {
+			cf_crash(AS_NSUP, "failed expire index chunk allocation");
+		}
+
+		chunk->next = head;
+		chunk->n_entries = 0;
+		*p_head = head = chunk;
+	}
+
+	expire_entry* e = &head->entries[head->n_entries++];
+
+	e->keyd = *keyd;
+	e->void_time = void_time;
+}
+
+
+// Caller must hold the lock. Entries still too far ahead go back in overflow.
+static void
+rebucket_overflow(as_expire_index* ei)
+{
+	expire_chunk* chunk = ei->overflow;
+
+	ei->overflow = NULL;
+
+	for (expire_chunk* c = chunk; c; c = c->next) {
+		for (uint32_t i = 0; i < c->n_entries; i++) {
+			ei->n_entries--;
+			insert_entry(ei, &c->entries[i].keyd, c->entries[i].void_time);
+		}
+	}
+
+	free_chunks(chunk);
+}
+
+
+static void
+free_chunks(expire_chunk* chunk)
+{
+	while (chunk) {
+		expire_chunk* next = chunk->next;
+
+		cf_free(chunk);
+		chunk = next;
+	}
+}
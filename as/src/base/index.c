@@ -59,9 +59,15 @@ typedef enum {
 	AS_RED		= 1
 } as_index_color;
 
+// Elements are whole cache lines - arenax stages are page-aligned.
+COMPILER_ASSERT(sizeof(as_index) == 64);
+
 // Flag to indicate full index reduce.
 #define AS_REDUCE_ALL (-1)
 
+// Most elements collected per sprig lock hold during a reduce.
+#define REDUCE_CHUNK_SIZE 1024
+
 typedef struct as_index_ph_s {
 	as_index			*r;
 	cf_arenax_handle	r_h;
@@ -70,7 +76,7 @@ typedef struct as_index_ph_s {
 typedef struct as_index_ph_array_s {
 	uint32_t	alloc_sz;
 	uint32_t	pos;
-	as_index_ph	indexes[];
+	as_index_ph	indexes[REDUCE_CHUNK_SIZE];
 } as_index_ph_array;
 
 typedef struct as_index_ele_s {
@@ -88,35 +94,71 @@ typedef struct as_index_ele_s {
 bool as_index_invalid_record_done(as_index_tree *tree, as_index_ref *index_ref);
 void as_index_done(as_index_tree *tree, as_index *r, cf_arenax_handle r_h);
 void as_index_tree_purge(as_index_tree *tree, as_index *r, cf_arenax_handle r_h);
-void as_index_reduce_traverse(as_index_tree *tree, cf_arenax_handle r_h, cf_arenax_handle sentinel_h, as_index_ph_array *v_a);
+void as_index_reduce_lock_all(as_index_tree *tree);
+void as_index_reduce_unlock_all(as_index_tree *tree);
+void as_index_reduce_traverse(as_index_tree *tree, cf_arenax_handle r_h, cf_digest *after, as_index_ph_array *v_a);
+void as_index_reduce_callbacks(as_index_tree *tree, as_index_ph_array *v_a, as_index_reduce_fn cb, void *udata);
 void as_index_reduce_sync_traverse(as_index_tree *tree, as_index *r, cf_arenax_handle sentinel_h, as_index_reduce_sync_fn cb, void *udata);
-int as_index_search_lockless(as_index_tree *tree, cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h);
-void as_index_insert_rebalance(as_index_tree *tree, as_index_ele *ele);
-void as_index_delete_rebalance(as_index_tree *tree, as_index_ele *ele);
+int as_index_search_lockless(as_index_tree *tree, as_index_sprig *sprig, cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h);
+void as_index_insert_rebalance(as_index_tree *tree, as_index_sprig *sprig, as_index_ele *ele);
+void as_index_delete_rebalance(as_index_tree *tree, as_index_sprig *sprig, as_index_ele *ele);
 void as_index_rotate_left(as_index_tree *tree, as_index_ele *a, as_index_ele *b);
 void as_index_rotate_right(as_index_tree *tree, as_index_ele *a, as_index_ele *b);
 
 
+//==========================================================
+// Inlines.
+//
+
+// The partition id comes from the start of the digest - pick sprigs using
+// bits from further along.
+static inline as_index_sprig *
+as_index_get_sprig(as_index_tree *tree, const cf_digest *keyd)
+{
+	return &tree->sprigs[*(uint32_t*)&keyd->digest[8] & tree->sprig_mask];
+}
+
+static inline uint32_t
+as_index_n_sprigs(const as_index_tree *tree)
+{
+	return tree->sprig_mask + 1;
+}
+
+// Start fetching both children while comparing against the parent - the
+// descent will need one of them next.
+static inline void
+as_index_prefetch_children(as_index_tree *tree, const as_index *r)
+{
+	__builtin_prefetch(RESOLVE_H(r->left_h));
+	__builtin_prefetch(RESOLVE_H(r->right_h));
+}
+
+
 
 //==========================================================
 // Public API - create/resume/destroy/size a tree.
 //
 
-// Create a new red-black tree.
+// Create a new tree of n_sprigs red-black trees. n_sprigs must be a power of
+// 2, and must be 1 if the tree is persisted.
 as_index_tree *
-as_index_tree_create(cf_arenax *arena, as_index_value_destructor destructor,
-		void *destructor_udata, as_treex *p_treex)
+as_index_tree_create(cf_arenax *arena, uint32_t n_sprigs,
+		as_index_value_destructor destructor, void *destructor_udata,
+		as_treex *p_treex)
 {
-	as_index_tree *tree = cf_rc_alloc(sizeof(as_index_tree));
+	if (p_treex && n_sprigs != 1) {
+		cf_crash(AS_INDEX, "persistent index trees can't have sprigs");
+	}
+
+	as_index_tree *tree = cf_rc_alloc(sizeof(as_index_tree) +
+			(n_sprigs * sizeof(as_index_sprig)));
 
 	if (! tree) {
 		return NULL;
 	}
 
-	pthread_mutex_init(&tree->lock, NULL);
-	pthread_mutex_init(&tree->reduce_lock, NULL);
-
 	tree->arena = arena;
+	tree->sprig_mask = n_sprigs - 1;
 
 	// Make the sentinel element.
 	tree->sentinel_h = cf_arenax_alloc(arena);
@@ -132,19 +174,32 @@ as_index_tree_create(cf_arenax *arena, as_index_value_destructor destructor,
 	sentinel->left_h = sentinel->right_h = tree->sentinel_h;
 	sentinel->color = AS_BLACK;
 
-	// Make the fixed root element.
-	tree->root_h = cf_arenax_alloc(arena);
+	// Make the fixed root element of each sprig.
+	for (uint32_t i = 0; i < n_sprigs; i++) {
+		as_index_sprig *sprig = &tree->sprigs[i];
 
-	if (tree->root_h == 0) {
-		cf_arenax_free(arena, tree->sentinel_h);
-		cf_rc_free(tree);
-		return NULL;
+		sprig->root_h = cf_arenax_alloc(arena);
+
+		if (sprig->root_h == 0) {
+			while (i-- != 0) {
+				cf_arenax_free(arena, tree->sprigs[i].root_h);
+			}
+
+			cf_arenax_free(arena, tree->sentinel_h);
+			cf_rc_free(tree);
+			return NULL;
+		}
+
+		sprig->root = RESOLVE_H(sprig->root_h);
+		memset(sprig->root, 0, sizeof(as_index));
+		sprig->root->left_h = sprig->root->right_h = tree->sentinel_h;
+		sprig->root->color = AS_BLACK;
 	}
 
-	tree->root = RESOLVE_H(tree->root_h);
-	memset(tree->root, 0, sizeof(as_index));
-	tree->root->left_h = tree->root->right_h = tree->sentinel_h;
-	tree->root->color = AS_BLACK;
+	for (uint32_t i = 0; i < n_sprigs; i++) {
+		pthread_mutex_init(&tree->sprigs[i].lock, NULL);
+		pthread_mutex_init(&tree->sprigs[i].reduce_lock, NULL);
+	}
 
 	tree->destructor = destructor;
 	tree->destructor_udata = destructor_udata;
@@ -154,29 +209,34 @@ as_index_tree_create(cf_arenax *arena, as_index_value_destructor destructor,
 	if (p_treex) {
 		// Update the tree information in persistent memory.
 		p_treex->sentinel_h = tree->sentinel_h;
-		p_treex->root_h = tree->root_h;
+		p_treex->root_h = tree->sprigs[0].root_h;
 	}
 
 	return tree;
 }
 
 
-// Resume a red-black tree in persistent memory.
+// Resume a red-black tree in persistent memory. Persisted trees have only one
+// sprig.
 // TODO - should really hide this in an EE version of as_index.c.
 as_index_tree *
 as_index_tree_resume(cf_arenax *arena, as_index_value_destructor destructor,
 		void *destructor_udata, as_treex *p_treex)
 {
-	as_index_tree *tree = cf_rc_alloc(sizeof(as_index_tree));
+	as_index_tree *tree = cf_rc_alloc(sizeof(as_index_tree) +
+			sizeof(as_index_sprig));
 
 	if (! tree) {
 		return NULL;
 	}
 
-	pthread_mutex_init(&tree->lock, NULL);
-	pthread_mutex_init(&tree->reduce_lock, NULL);
+	as_index_sprig *sprig = &tree->sprigs[0];
+
+	pthread_mutex_init(&sprig->lock, NULL);
+	pthread_mutex_init(&sprig->reduce_lock, NULL);
 
 	tree->arena = arena;
+	tree->sprig_mask = 0;
 
 	// Resume the sentinel.
 	tree->sentinel_h = p_treex->sentinel_h;
@@ -187,14 +247,14 @@ as_index_tree_resume(cf_arenax *arena, as_index_value_destructor destructor,
 	}
 
 	// Resume the fixed root.
-	tree->root_h = p_treex->root_h;
+	sprig->root_h = p_treex->root_h;
 
-	if (tree->root_h == 0) {
+	if (sprig->root_h == 0) {
 		cf_rc_free(tree);
 		return NULL;
 	}
 
-	tree->root = RESOLVE_H(tree->root_h);
+	sprig->root = RESOLVE_H(sprig->root_h);
 
 	tree->destructor = destructor;
 	tree->destructor_udata = destructor_udata;
@@ -215,16 +275,23 @@ as_index_tree_release(as_index_tree *tree, void *destructor_udata)
 		return 1;
 	}
 
-	as_index_tree_purge(tree, RESOLVE_H(tree->root->left_h),
-			tree->root->left_h);
+	for (uint32_t i = 0; i < as_index_n_sprigs(tree); i++) {
+		as_index_sprig *sprig = &tree->sprigs[i];
 
-	cf_arenax_free(tree->arena, tree->root_h);
-	cf_arenax_free(tree->arena, tree->sentinel_h);
+		as_index_tree_purge(tree, RESOLVE_H(sprig->root->left_h),
+				sprig->root->left_h);
+
+		cf_arenax_free(tree->arena, sprig->root_h);
 
-	pthread_mutex_destroy(&tree->lock);
-	pthread_mutex_destroy(&tree->reduce_lock);
+		pthread_mutex_destroy(&sprig->lock);
+		pthread_mutex_destroy(&sprig->reduce_lock);
+	}
 
-	memset(tree, 0, sizeof(as_index_tree)); // paranoia - for debugging only
+	cf_arenax_free(tree->arena, tree->sentinel_h);
+
+	// paranoia - for debugging only
+	memset(tree, 0, sizeof(as_index_tree) +
+			(as_index_n_sprigs(tree) * sizeof(as_index_sprig)));
 	cf_rc_free(tree);
 
 	return 0;
@@ -235,13 +302,7 @@ as_index_tree_release(as_index_tree *tree, void *destructor_udata)
 uint32_t
 as_index_tree_size(as_index_tree *tree)
 {
-	pthread_mutex_lock(&tree->lock);
-
-	uint32_t sz = tree->elements;
-
-	pthread_mutex_unlock(&tree->lock);
-
-	return sz;
+	return cf_atomic32_get(tree->elements);
 }
 
 
@@ -259,78 +320,82 @@ as_index_reduce(as_index_tree *tree, as_index_reduce_fn cb, void *udata)
 
 
 // Make a callback for a specified number of elements in the tree, from outside
-// the tree lock.
+// the tree lock. Each sprig is walked in chunks, in tree order, blocking inserts
+// and deletes only while collecting a chunk - gets aren't blocked at all.
+// Elements inserted behind the cursor during the reduce are missed, those
+// inserted ahead of it are included.
 void
 as_index_reduce_partial(as_index_tree *tree, uint32_t sample_count,
 		as_index_reduce_fn cb, void *udata)
 {
-	pthread_mutex_lock(&tree->reduce_lock);
+	as_index_ph_array v_a;
+	uint32_t n_remaining = sample_count; // AS_REDUCE_ALL is effectively no limit
 
-	// For full reduce, get the number of elements inside the tree lock.
-	if (sample_count == AS_REDUCE_ALL) {
-		sample_count = tree->elements;
-	}
+	for (uint32_t s = 0; s < as_index_n_sprigs(tree) && n_remaining != 0; s++) {
+		as_index_sprig *sprig = &tree->sprigs[s];
+		cf_digest cursor;
+		bool started = false;
 
-	if (sample_count == 0) {
-		pthread_mutex_unlock(&tree->reduce_lock);
-		return;
-	}
+		do {
+			v_a.alloc_sz = n_remaining < REDUCE_CHUNK_SIZE ?
+					n_remaining : REDUCE_CHUNK_SIZE;
+			v_a.pos = 0;
 
-	size_t sz = sizeof(as_index_ph_array) +
-			(sizeof(as_index_ph) * sample_count);
-	as_index_ph_array *v_a;
-	uint8_t buf[64 * 1024];
+			pthread_mutex_lock(&sprig->reduce_lock);
 
-	if (sz > 64 * 1024) {
-		v_a = cf_malloc(sz);
+			if (sprig->root->left_h != tree->sentinel_h) {
+				as_index_reduce_traverse(tree, sprig->root->left_h,
+						started ? &cursor : NULL, &v_a);
+			}
 
-		if (! v_a) {
-			pthread_mutex_unlock(&tree->reduce_lock);
-			return;
-		}
-	}
-	else {
-		v_a = (as_index_ph_array*)buf;
-	}
+			pthread_mutex_unlock(&sprig->reduce_lock);
 
-	v_a->alloc_sz = sample_count;
-	v_a->pos = 0;
+			if (v_a.pos == 0) {
+				break;
+			}
 
-	uint64_t start_ms = cf_getms();
+			// Reserved elements can't go away, so the key is safe to read.
+			cursor = v_a.indexes[v_a.pos - 1].r->key;
+			started = true;
 
-	// Recursively, fetch all the value pointers into this array, so we can make
-	// all the callbacks outside the big lock.
-	if (tree->root->left_h != tree->sentinel_h) {
-		as_index_reduce_traverse(tree, tree->root->left_h, tree->sentinel_h,
-				v_a);
+			if (sample_count != AS_REDUCE_ALL) {
+				n_remaining -= v_a.pos;
+			}
+
+			as_index_reduce_callbacks(tree, &v_a, cb, udata);
+		} while (v_a.pos == v_a.alloc_sz && n_remaining != 0);
 	}
+}
 
-	cf_debug(AS_INDEX, "as_index_reduce_traverse took %"PRIu64" ms",
-			cf_getms() - start_ms);
 
-	pthread_mutex_unlock(&tree->reduce_lock);
+// Make a callback for up to sample_count elements following a specified
+// digest, from outside the tree lock. Only the digest's sprig is used, and if
+// nothing follows the digest, the sprig's first elements are used. With a
+// random digest, this is a cheap random sample of the tree.
+void
+as_index_reduce_sample(as_index_tree *tree, cf_digest *after,
+		uint32_t sample_count, as_index_reduce_fn cb, void *udata)
+{
+	as_index_sprig *sprig = as_index_get_sprig(tree, after);
+	as_index_ph_array v_a;
 
-	for (uint32_t i = 0; i < v_a->pos; i++) {
-		as_index_ref r_ref;
+	v_a.alloc_sz = sample_count < REDUCE_CHUNK_SIZE ?
+			sample_count : REDUCE_CHUNK_SIZE;
+	v_a.pos = 0;
 
-		r_ref.skip_lock = false;
-		r_ref.r = v_a->indexes[i].r;
-		r_ref.r_h = v_a->indexes[i].r_h;
+	pthread_mutex_lock(&sprig->reduce_lock);
 
-		olock_vlock(g_record_locks, &r_ref.r->key, &r_ref.olock);
+	if (sprig->root->left_h != tree->sentinel_h) {
+		as_index_reduce_traverse(tree, sprig->root->left_h, after, &v_a);
 
-		// Ignore this record if it's "half created" or deleted.
-		if (as_index_invalid_record_done(tree, &r_ref)) {
-			continue;
+		if (v_a.pos == 0) {
+			as_index_reduce_traverse(tree, sprig->root->left_h, NULL, &v_a);
 		}
-
-		// Callback MUST call as_record_done() to unlock and release record.
-		cb(&r_ref, udata);
 	}
 
-	if (v_a != (as_index_ph_array*)buf) {
-		cf_free(v_a);
-	}
+	pthread_mutex_unlock(&sprig->reduce_lock);
+
+	as_index_reduce_callbacks(tree, &v_a, cb, udata);
 }
 
 
@@ -339,14 +404,18 @@ void
 as_index_reduce_sync(as_index_tree *tree, as_index_reduce_sync_fn cb,
 		void *udata)
 {
-	pthread_mutex_lock(&tree->reduce_lock);
+	as_index_reduce_lock_all(tree);
+
+	for (uint32_t i = 0; i < as_index_n_sprigs(tree); i++) {
+		as_index_sprig *sprig = &tree->sprigs[i];
 
-	if (tree->root->left_h != tree->sentinel_h) {
-		as_index_reduce_sync_traverse(tree, RESOLVE_H(tree->root->left_h),
-				tree->sentinel_h, cb, udata);
+		if (sprig->root->left_h != tree->sentinel_h) {
+			as_index_reduce_sync_traverse(tree, RESOLVE_H(sprig->root->left_h),
+					tree->sentinel_h, cb, udata);
+		}
 	}
 
-	pthread_mutex_unlock(&tree->reduce_lock);
+	as_index_reduce_unlock_all(tree);
 }
 
 
@@ -363,11 +432,13 @@ as_index_reduce_sync(as_index_tree *tree, as_index_reduce_sync_fn cb,
 int
 as_index_exists(as_index_tree *tree, cf_digest *keyd)
 {
-	pthread_mutex_lock(&tree->lock);
+	as_index_sprig *sprig = as_index_get_sprig(tree, keyd);
+
+	pthread_mutex_lock(&sprig->lock);
 
-	int rv = as_index_search_lockless(tree, keyd, NULL, NULL);
+	int rv = as_index_search_lockless(tree, sprig, keyd, NULL, NULL);
 
-	pthread_mutex_unlock(&tree->lock);
+	pthread_mutex_unlock(&sprig->lock);
 
 	return rv;
 }
@@ -383,20 +454,22 @@ int
 as_index_get_vlock(as_index_tree *tree, cf_digest *keyd,
 		as_index_ref *index_ref)
 {
-	pthread_mutex_lock(&tree->lock);
+	as_index_sprig *sprig = as_index_get_sprig(tree, keyd);
 
-	int rv = as_index_search_lockless(tree, keyd, &index_ref->r,
+	pthread_mutex_lock(&sprig->lock);
+
+	int rv = as_index_search_lockless(tree, sprig, keyd, &index_ref->r,
 			&index_ref->r_h);
 
 	if (rv != 0) {
-		pthread_mutex_unlock(&tree->lock);
+		pthread_mutex_unlock(&sprig->lock);
 		return rv;
 	}
 
 	as_index_reserve(index_ref->r);
 	cf_atomic64_incr(&g_stats.global_record_ref_count);
 
-	pthread_mutex_unlock(&tree->lock);
+	pthread_mutex_unlock(&sprig->lock);
 
 	if (! index_ref->skip_lock) {
 		olock_vlock(g_record_locks, keyd, &index_ref->olock);
@@ -424,6 +497,7 @@ int
 as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 		as_index_ref *index_ref)
 {
+	as_index_sprig *sprig = as_index_get_sprig(tree, keyd);
 	int cmp = 0;
 	bool retry;
 
@@ -434,18 +508,20 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 	do {
 		ele = eles;
 
-		pthread_mutex_lock(&tree->lock);
+		pthread_mutex_lock(&sprig->lock);
 
 		// Search for the specified element, or a parent to insert it under.
 
 		ele->parent = NULL; // we'll never look this far up
-		ele->me_h = tree->root_h;
-		ele->me = tree->root;
+		ele->me_h = sprig->root_h;
+		ele->me = sprig->root;
 
-		cf_arenax_handle t_h = tree->root->left_h;
+		cf_arenax_handle t_h = sprig->root->left_h;
 		as_index *t = RESOLVE_H(t_h);
 
 		while (t_h != tree->sentinel_h) {
+			as_index_prefetch_children(tree, t);
+
 			ele++;
 			ele->parent = ele - 1;
 			ele->me_h = t_h;
@@ -457,7 +533,7 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 				as_index_reserve(t);
 				cf_atomic64_incr(&g_stats.global_record_ref_count);
 
-				pthread_mutex_unlock(&tree->lock);
+				pthread_mutex_unlock(&sprig->lock);
 
 				if (! index_ref->skip_lock) {
 					olock_vlock(g_record_locks, keyd, &index_ref->olock);
@@ -482,14 +558,14 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 
 		retry = false;
 
-		if (EBUSY == pthread_mutex_trylock(&tree->reduce_lock)) {
+		if (EBUSY == pthread_mutex_trylock(&sprig->reduce_lock)) {
 			// The tree is being reduced - could take long, unlock so reads and
 			// overwrites aren't blocked.
-			pthread_mutex_unlock(&tree->lock);
+			pthread_mutex_unlock(&sprig->lock);
 
 			// Wait until the tree reduce is done...
-			pthread_mutex_lock(&tree->reduce_lock);
-			pthread_mutex_unlock(&tree->reduce_lock);
+			pthread_mutex_lock(&sprig->reduce_lock);
+			pthread_mutex_unlock(&sprig->reduce_lock);
 
 			// ... and start over - we unlocked, so the tree may have changed.
 			retry = true;
@@ -503,8 +579,8 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 
 	if (n_h == 0) {
 		cf_warning(AS_INDEX, "arenax alloc failed");
-		pthread_mutex_unlock(&tree->reduce_lock);
-		pthread_mutex_unlock(&tree->lock);
+		pthread_mutex_unlock(&sprig->reduce_lock);
+		pthread_mutex_unlock(&sprig->lock);
 		return -1;
 	}
 
@@ -522,7 +598,7 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 	as_index_clear_record_info(n);
 
 	// Insert the new element n under parent ele.
-	if (ele->me == tree->root || 0 < cmp) {
+	if (ele->me == sprig->root || 0 < cmp) {
 		ele->me->left_h = n_h;
 	}
 	else {
@@ -535,12 +611,12 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 	ele->me = n;
 
 	// Rebalance the tree as needed.
-	as_index_insert_rebalance(tree, ele);
+	as_index_insert_rebalance(tree, sprig, ele);
 
-	tree->elements++;
+	cf_atomic32_incr(&tree->elements);
 
-	pthread_mutex_unlock(&tree->reduce_lock);
-	pthread_mutex_unlock(&tree->lock);
+	pthread_mutex_unlock(&sprig->reduce_lock);
+	pthread_mutex_unlock(&sprig->lock);
 
 	if (! index_ref->skip_lock) {
 		olock_vlock(g_record_locks, keyd, &index_ref->olock);
@@ -562,6 +638,7 @@ as_index_get_insert_vlock(as_index_tree *tree, cf_digest *keyd,
 int
 as_index_delete(as_index_tree *tree, cf_digest *keyd)
 {
+	as_index_sprig *sprig = as_index_get_sprig(tree, keyd);
 	as_index *r;
 	cf_arenax_handle r_h;
 	bool retry;
@@ -573,16 +650,18 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 	do {
 		ele = eles;
 
-		pthread_mutex_lock(&tree->lock);
+		pthread_mutex_lock(&sprig->lock);
 
 		ele->parent = NULL; // we'll never look this far up
-		ele->me_h = tree->root_h;
-		ele->me = tree->root;
+		ele->me_h = sprig->root_h;
+		ele->me = sprig->root;
 
-		r_h = tree->root->left_h;
+		r_h = sprig->root->left_h;
 		r = RESOLVE_H(r_h);
 
 		while (r_h != tree->sentinel_h) {
+			as_index_prefetch_children(tree, r);
+
 			ele++;
 			ele->parent = ele - 1;
 			ele->me_h = r_h;
@@ -599,7 +678,7 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 		}
 
 		if (r_h == tree->sentinel_h) {
-			pthread_mutex_unlock(&tree->lock);
+			pthread_mutex_unlock(&sprig->lock);
 			return -1; // not found, nothing to delete
 		}
 
@@ -607,14 +686,14 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 
 		retry = false;
 
-		if (EBUSY == pthread_mutex_trylock(&tree->reduce_lock)) {
+		if (EBUSY == pthread_mutex_trylock(&sprig->reduce_lock)) {
 			// The tree is being reduced - could take long, unlock so reads and
 			// overwrites aren't blocked.
-			pthread_mutex_unlock(&tree->lock);
+			pthread_mutex_unlock(&sprig->lock);
 
 			// Wait until the tree reduce is done...
-			pthread_mutex_lock(&tree->reduce_lock);
-			pthread_mutex_unlock(&tree->reduce_lock);
+			pthread_mutex_lock(&sprig->reduce_lock);
+			pthread_mutex_unlock(&sprig->reduce_lock);
 
 			// ... and start over - we unlocked, so the tree may have changed.
 			retry = true;
@@ -673,7 +752,7 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 	// Rebalance at ele if necessary. (Note - if r != s, r is in the tree, and
 	// its parent may change during rebalancing.)
 	if (s->color == AS_BLACK) {
-		as_index_delete_rebalance(tree, ele);
+		as_index_delete_rebalance(tree, sprig, ele);
 	}
 
 	if (s != r) {
@@ -696,10 +775,10 @@ as_index_delete(as_index_tree *tree, cf_digest *keyd)
 	// We may now destroy r, which is no longer in the tree.
 	as_index_done(tree, r, r_h);
 
-	tree->elements--;
+	cf_atomic32_decr(&tree->elements);
 
-	pthread_mutex_unlock(&tree->reduce_lock);
-	pthread_mutex_unlock(&tree->lock);
+	pthread_mutex_unlock(&sprig->reduce_lock);
+	pthread_mutex_unlock(&sprig->lock);
 
 	return 0;
 }
@@ -763,16 +842,47 @@ as_index_tree_purge(as_index_tree *tree, as_index *r, cf_arenax_handle r_h)
 }
 
 
+// Block inserts and deletes in all sprigs. Sprigs are always locked in order.
+void
+as_index_reduce_lock_all(as_index_tree *tree)
+{
+	for (uint32_t i = 0; i < as_index_n_sprigs(tree); i++) {
+		pthread_mutex_lock(&tree->sprigs[i].reduce_lock);
+	}
+}
+
+
+void
+as_index_reduce_unlock_all(as_index_tree *tree)
+{
+	for (uint32_t i = 0; i < as_index_n_sprigs(tree); i++) {
+		pthread_mutex_unlock(&tree->sprigs[i].reduce_lock);
+	}
+}
+
+
+// Collect and reserve elements that come after the digest 'after' in tree
+// order (or all elements if it's null), until v_a is full. Tree order puts
+// greater digests on the left.
 void
 as_index_reduce_traverse(as_index_tree *tree, cf_arenax_handle r_h,
-		cf_arenax_handle sentinel_h, as_index_ph_array *v_a)
+		cf_digest *after, as_index_ph_array *v_a)
 {
+	if (r_h == tree->sentinel_h || v_a->pos >= v_a->alloc_sz) {
+		return;
+	}
+
 	as_index *r = RESOLVE_H(r_h);
 
-	if (r->left_h != sentinel_h) {
-		as_index_reduce_traverse(tree, r->left_h, sentinel_h, v_a);
+	// Everything on the right comes after r, and r doesn't come after the
+	// cursor - only the right can hold elements past the cursor.
+	if (after && cf_digest_compare(&r->key, after) >= 0) {
+		as_index_reduce_traverse(tree, r->right_h, after, v_a);
+		return;
 	}
 
+	as_index_reduce_traverse(tree, r->left_h, after, v_a);
+
 	if (v_a->pos >= v_a->alloc_sz) {
 		return;
 	}
@@ -784,8 +894,32 @@ as_index_reduce_traverse(as_index_tree *tree, cf_arenax_handle r_h,
 	v_a->indexes[v_a->pos].r_h = r_h;
 	v_a->pos++;
 
-	if (r->right_h != sentinel_h) {
-		as_index_reduce_traverse(tree, r->right_h, sentinel_h, v_a);
+	// Everything on the right comes after r, so after the cursor.
+	as_index_reduce_traverse(tree, r->right_h, NULL, v_a);
+}
+
+
+// Lock and make a callback for each element collected by a traversal.
+void
+as_index_reduce_callbacks(as_index_tree *tree, as_index_ph_array *v_a,
+		as_index_reduce_fn cb, void *udata)
+{
+	for (uint32_t i = 0; i < v_a->pos; i++) {
+		as_index_ref r_ref;
+
+		r_ref.skip_lock = false;
+		r_ref.r = v_a->indexes[i].r;
+		r_ref.r_h = v_a->indexes[i].r_h;
+
+		olock_vlock(g_record_locks, &r_ref.r->key, &r_ref.olock);
+
+		// Ignore this record if it's "half created" or deleted.
+		if (as_index_invalid_record_done(tree, &r_ref)) {
+			continue;
+		}
+
+		// Callback MUST call as_record_done() to unlock and release record.
+		cb(&r_ref, udata);
 	}
 }
 
@@ -809,13 +943,15 @@ as_index_reduce_sync_traverse(as_index_tree *tree, as_index *r,
 
 
 int
-as_index_search_lockless(as_index_tree *tree, cf_digest *keyd, as_index **ret,
-		cf_arenax_handle *ret_h)
+as_index_search_lockless(as_index_tree *tree, as_index_sprig *sprig,
+		cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h)
 {
-	cf_arenax_handle r_h = tree->root->left_h;
+	cf_arenax_handle r_h = sprig->root->left_h;
 	as_index *r = RESOLVE_H(r_h);
 
 	while (r_h != tree->sentinel_h) {
+		as_index_prefetch_children(tree, r);
+
 		int cmp = cf_digest_compare(keyd, &r->key);
 
 		if (cmp == 0) {
@@ -839,7 +975,8 @@ as_index_search_lockless(as_index_tree *tree, cf_digest *keyd, as_index **ret,
 
 
 void
-as_index_insert_rebalance(as_index_tree *tree, as_index_ele *ele)
+as_index_insert_rebalance(as_index_tree *tree, as_index_sprig *sprig,
+		as_index_ele *ele)
 {
 	// Entering here, ele is the last element on the stack. It turns out during
 	// insert rebalancing we won't ever need new elements on the stack, but make
@@ -924,19 +1061,20 @@ as_index_insert_rebalance(as_index_tree *tree, as_index_ele *ele)
 		}
 	}
 
-	RESOLVE_H(tree->root->left_h)->color = AS_BLACK;
+	RESOLVE_H(sprig->root->left_h)->color = AS_BLACK;
 }
 
 
 void
-as_index_delete_rebalance(as_index_tree *tree, as_index_ele *ele)
+as_index_delete_rebalance(as_index_tree *tree, as_index_sprig *sprig,
+		as_index_ele *ele)
 {
 	// Entering here, ele is the last element on the stack. It's possible as r_e
 	// crawls up the tree, we'll need new elements on the stack, in which case
 	// ele keeps building the stack down while r_e goes up.
 	as_index_ele *r_e = ele;
 
-	while (r_e->me->color == AS_BLACK && r_e->me_h != tree->root->left_h) {
+	while (r_e->me->color == AS_BLACK && r_e->me_h != sprig->root->left_h) {
 		as_index *r_parent = r_e->parent->me;
 
 		if (r_e->me_h == r_parent->left_h) {
@@ -1000,7 +1138,7 @@ as_index_delete_rebalance(as_index_tree *tree, as_index_ele *ele)
 
 				as_index_rotate_left(tree, r_e->parent, ele);
 
-				RESOLVE_H(tree->root->left_h)->color = AS_BLACK;
+				RESOLVE_H(sprig->root->left_h)->color = AS_BLACK;
 
 				return;
 			}
@@ -1066,7 +1204,7 @@ as_index_delete_rebalance(as_index_tree *tree, as_index_ele *ele)
 
 				as_index_rotate_right(tree, r_e->parent, ele);
 
-				RESOLVE_H(tree->root->left_h)->color = AS_BLACK;
+				RESOLVE_H(sprig->root->left_h)->color = AS_BLACK;
 
 				return;
 			}
@@ -120,9 +120,13 @@ as_namespace_create(char *name, uint16_t replication_factor)
 	ns->conflict_resolution_policy = AS_NAMESPACE_CONFLICT_RESOLUTION_POLICY_GENERATION;
 	ns->data_in_index = false;
 	ns->evict_hist_buckets = 10000; // for 30 day TTL, bucket width is 4 minutes 20 seconds
+	ns->evict_policy = AS_EVICT_POLICY_TTL;
+	ns->evict_sample_size = 16;
 	ns->evict_tenths_pct = 5; // default eviction amount is 0.5%
+	ns->expiration_index = false; // nsup reduces partition trees to expire
 	ns->hwm_disk = 0.5; // default high water mark for eviction is 50%
 	ns->hwm_memory = 0.6; // default high water mark for eviction is 60%
+	ns->index_huge_pages = false;
 	ns->ldt_enabled = false; // By default ldt is not enabled
 	ns->ldt_gc_sleep_us = 500; // Default is sleep for .5Ms. This translates to constant 2k Subrecord
 							   // GC per second.
@@ -131,6 +135,7 @@ as_namespace_create(char *name, uint16_t replication_factor)
 	ns->migrate_order = 5;
 	ns->migrate_sleep = 1;
 	ns->obj_size_hist_max = OBJ_SIZE_HIST_NUM_BUCKETS;
+	ns->partition_tree_sprigs = 1; // one lock per partition tree
 	ns->single_bin = false;
 	ns->stop_writes_pct = 0.9; // stop writes when 90% of either memory or disk is used
 
@@ -148,6 +153,11 @@ as_namespace_create(char *name, uint16_t replication_factor)
 	ns->storage_filesize = 1024LL * 1024LL * 1024LL * 16LL; // default file size is 16G per file
 	ns->storage_scheduler_mode = NULL; // null indicates default is to not change scheduler mode
 	ns->storage_write_block_size = 1024 * 1024;
+	ns->storage_async_read_depth = 0; // don't read records asynchronously
+	ns->storage_cold_start_threads = 4; // per device, adding records to index during cold start
+	ns->storage_compression = AS_STORAGE_COMPRESSION_NONE; // store records uncompressed
+	ns->storage_compression_level = 1; // if compressing, favor speed
+	ns->storage_defrag_adaptive = false; // always sleep defrag-sleep between wblocks
 	ns->storage_defrag_lwm_pct = 50; // defrag if occupancy of block is < 50%
 	ns->storage_defrag_queue_min = 0; // don't defrag unless the queue has this many eligible wblocks (0: defrag anything queued)
 	ns->storage_defrag_sleep = 1000; // sleep this many microseconds between each wblock
@@ -158,8 +168,10 @@ as_namespace_create(char *name, uint16_t replication_factor)
 	ns->storage_min_avail_pct = 5; // stop writes when < 5% disk is writable
 	ns->storage_num_write_blocks = 64; // number of write blocks to use with KV store devices
 	ns->storage_post_write_queue = 256; // number of wblocks per device used as post-write cache
+	ns->storage_read_cache_size = 0; // no read cache
 	ns->storage_read_block_size = 64 * 1024; // size in bytes of read buffers to use with KV store devices
 	// [Note - current FusionIO maximum read buffer size is 1MB - 512B.]
+	ns->storage_write_stripes = 1; // writes to a device all fill the same swb
 	ns->storage_write_threads = 1;
 
 	// SINDEX
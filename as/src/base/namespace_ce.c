@@ -149,7 +149,13 @@ as_namespace_setup(as_namespace* ns, uint32_t instance, uint32_t stage_capacity)
 		cf_crash(AS_NAMESPACE, "ns %s can't allocate index arena", ns->name);
 	}
 
-	cf_arenax_err arena_result = cf_arenax_create(ns->arena, 0, as_index_size_get(ns), stage_capacity, 0, CF_ARENAX_BIGLOCK);
+	uint32_t arena_flags = CF_ARENAX_BIGLOCK;
+
+	if (ns->index_huge_pages) {
+		arena_flags |= CF_ARENAX_HUGE_PAGES;
+	}
+
+	cf_arenax_err arena_result = cf_arenax_create(ns->arena, 0, as_index_size_get(ns), stage_capacity, 0, arena_flags);
 
 	if (arena_result != CF_ARENAX_OK) {
 		cf_crash(AS_NAMESPACE, "ns %s can't create arena: %s", ns->name, cf_arenax_errstr(arena_result));
@@ -40,6 +40,7 @@
 
 #include "base/datamodel.h"
 #include "base/ldt.h"
+#include "base/particle_blob.h"
 #include "base/proto.h"
 #include "storage/storage.h"
 
@@ -868,6 +869,26 @@ as_bin_particle_to_client(const as_bin *b, as_msg_op *op)
 	return added_size;
 }
 
+// Returns the client value size, and points at the value in the particle if
+// it can be sent as is, i.e. for blobs and strings, otherwise sets null.
+uint32_t
+as_bin_particle_client_value_ref(const as_bin *b, const uint8_t **p_value)
+{
+	*p_value = NULL;
+
+	if (! (b && as_bin_inuse(b)) || as_bin_is_hidden(b)) {
+		return 0;
+	}
+
+	uint8_t type = as_bin_get_particle_type(b);
+
+	if (particle_vtable[type]->to_wire_fn == blob_to_wire) {
+		*p_value = blob_wire_value(b->particle);
+	}
+
+	return particle_vtable[type]->wire_size_fn(b->particle);
+}
+
 uint32_t
 as_bin_particle_pickled_size(const as_bin *b)
 {
@@ -226,6 +226,13 @@ blob_to_wire(const as_particle *p, uint8_t *wire)
 	return p_blob_mem->sz;
 }
 
+// Wire value is the same as the particle data - no need to copy it.
+const uint8_t *
+blob_wire_value(const as_particle *p)
+{
+	return ((blob_mem *)p)->data;
+}
+
 //------------------------------------------------
 // Handle as_val translation.
 //
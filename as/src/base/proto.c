@@ -27,6 +27,8 @@
 #include "base/proto.h"
 
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -86,6 +88,96 @@ as_msg_swap_field(as_msg_field *mf)
 	mf->field_sz = ntohl(mf->field_sz);
 }
 
+// Values at least this big are sent in place by as_msg_make_response_iov().
+#define MIN_IN_PLACE_VALUE_SZ (4 * 1024)
+
+
+// Writes everything up to the ops - returns where the ops go.
+static uint8_t *
+write_response_header(uint8_t *buf, size_t msg_sz, uint32_t result_code,
+		uint32_t generation, uint32_t void_time, uint16_t bin_count,
+		uint64_t trid, const char *setname, uint32_t setname_len)
+{
+	cl_msg *msgp = (cl_msg *)buf;
+
+	msgp->proto.version = PROTO_VERSION;
+	msgp->proto.type = PROTO_TYPE_AS_MSG;
+	msgp->proto.sz = msg_sz - sizeof(as_proto);
+	as_proto_swap(&msgp->proto);
+
+	as_msg *m = &msgp->msg;
+
+	m->header_sz = sizeof(as_msg);
+	m->info1 = 0;
+	m->info2 = 0;
+	m->info3 = 0;
+	m->unused = 0;
+	m->result_code = result_code;
+	m->generation = generation;
+	m->record_ttl = void_time;
+	m->transaction_ttl = 0;
+	m->n_ops = bin_count;
+	m->n_fields = 0;
+
+	buf += sizeof(cl_msg);
+
+	if (trid != 0) {
+		m->n_fields++;
+
+		as_msg_field *trfield = (as_msg_field *)buf;
+
+		trfield->field_sz = 1 + sizeof(uint64_t);
+		trfield->type = AS_MSG_FIELD_TYPE_TRID;
+		*(uint64_t *)trfield->data = cf_swap_to_be64(trid);
+
+		buf += sizeof(as_msg_field) + sizeof(uint64_t);
+		as_msg_swap_field(trfield);
+	}
+
+	if (setname) {
+		m->n_fields++;
+
+		as_msg_field *trfield = (as_msg_field *)buf;
+
+		trfield->field_sz = 1 + setname_len;
+		trfield->type = AS_MSG_FIELD_TYPE_SET;
+		memcpy(trfield->data, setname, setname_len);
+
+		buf += sizeof(as_msg_field) + setname_len;
+		as_msg_swap_field(trfield);
+	}
+
+	as_msg_swap_header(m);
+
+	return buf;
+}
+
+
+// Writes op header and name, but not value - op is left in host order.
+static as_msg_op *
+write_response_op_name(uint8_t *buf, as_msg_op **ops, as_bin **bins,
+		uint16_t i, as_namespace *ns)
+{
+	as_msg_op *op = (as_msg_op *)buf;
+
+	op->version = 0;
+
+	if (ops) {
+		op->op = ops[i]->op;
+		memcpy(op->name, ops[i]->name, ops[i]->name_sz);
+		op->name_sz = ops[i]->name_sz;
+	}
+	else {
+		op->op = AS_MSG_OP_READ;
+		op->name_sz = as_bin_memcpy_name(ns, op->name, bins[i]);
+	}
+
+	op->op_sz = 4 + op->name_sz;
+
+	return op;
+}
+
+
 //
 // This function will attempt to fill the passed in buffer,
 // but if too small, will malloc and return that.
@@ -145,82 +237,202 @@ as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 
 	*msg_sz_in = msg_sz;
 
-	uint8_t *buf = b;
-	cl_msg *msgp = (cl_msg *)buf;
+	uint8_t *buf = write_response_header(b, msg_sz, result_code, generation,
+			void_time, bin_count, trid, setname, setname_len);
 
-	msgp->proto.version = PROTO_VERSION;
-	msgp->proto.type = PROTO_TYPE_AS_MSG;
-	msgp->proto.sz = msg_sz - sizeof(as_proto);
-	as_proto_swap(&msgp->proto);
+	for (uint16_t i = 0; i < bin_count; i++) {
+		as_msg_op *op = write_response_op_name(buf, ops, bins, i, ns);
 
-	as_msg *m = &msgp->msg;
+		buf += sizeof(as_msg_op) + op->name_sz;
+		buf += as_bin_particle_to_client(bins[i], op);
 
-	m->header_sz = sizeof(as_msg);
-	m->info1 = 0;
-	m->info2 = 0;
-	m->info3 = 0;
-	m->unused = 0;
-	m->result_code = result_code;
-	m->generation = generation;
-	m->record_ttl = void_time;
-	m->transaction_ttl = 0;
-	m->n_ops = bin_count;
-	m->n_fields = 0;
+		as_msg_swap_op(op);
+	}
 
-	buf += sizeof(cl_msg);
+	return (cl_msg *)b;
+}
 
-	if (trid != 0) {
-		m->n_fields++;
 
-		as_msg_field *trfield = (as_msg_field *)buf;
+// Like as_msg_make_response_msg(), but blob and string values big enough to
+// be worth it aren't copied - the message is a list of iovecs, alternating
+// between the (allocated) rest of the message and values in place. Caller must
+// keep the referenced particles alive until the message is sent. Returns false
+// if there are no such values, or on allocation failure - caller should then
+// make the response the usual way.
+bool
+as_msg_make_response_iov(uint32_t result_code, uint32_t generation,
+		uint32_t void_time, as_msg_op **ops, as_bin **bins, uint16_t bin_count,
+		as_namespace *ns, uint64_t trid, const char *setname, as_msg_iov *mi)
+{
+	size_t buf_sz = sizeof(cl_msg);
+	size_t ref_sz = 0;
+	uint32_t max_n_iov = 1;
 
-		trfield->field_sz = 1 + sizeof(uint64_t);
-		trfield->type = AS_MSG_FIELD_TYPE_TRID;
-		*(uint64_t *)trfield->data = cf_swap_to_be64(trid);
+	buf_sz += sizeof(as_msg_op) * bin_count;
 
-		buf += sizeof(as_msg_field) + sizeof(uint64_t);
-		as_msg_swap_field(trfield);
+	for (uint16_t i = 0; i < bin_count; i++) {
+		if (ops) {
+			buf_sz += ops[i]->name_sz;
+		}
+		else if (bins[i]) {
+			buf_sz += ns->single_bin ?
+					0 : strlen(as_bin_get_name_from_id(ns, bins[i]->id));
+		}
+		else {
+			cf_crash(AS_PROTO, "making response message with null bin and op");
+		}
+
+		const uint8_t *value;
+		uint32_t value_sz = as_bin_particle_client_value_ref(bins[i], &value);
+
+		if (value && value_sz >= MIN_IN_PLACE_VALUE_SZ) {
+			ref_sz += value_sz;
+			max_n_iov += 2;
+		}
+		else {
+			buf_sz += value_sz;
+		}
 	}
 
-	if (setname) {
-		m->n_fields++;
+	mi->iov = NULL;
 
-		as_msg_field *trfield = (as_msg_field *)buf;
+	if (ref_sz == 0) {
+		return false;
+	}
 
-		trfield->field_sz = 1 + setname_len;
-		trfield->type = AS_MSG_FIELD_TYPE_SET;
-		memcpy(trfield->data, setname, setname_len);
+	if (trid != 0) {
+		buf_sz += sizeof(as_msg_field) + sizeof(trid);
+	}
 
-		buf += sizeof(as_msg_field) + setname_len;
-		as_msg_swap_field(trfield);
+	uint32_t setname_len = 0;
+
+	if (setname) {
+		setname_len = strlen(setname);
+		buf_sz += sizeof(as_msg_field) + setname_len;
 	}
 
-	as_msg_swap_header(m);
+	// One allocation for the iovecs and the rest of the message.
+	uint8_t *mem = cf_malloc((sizeof(struct iovec) * max_n_iov) + buf_sz);
+
+	if (! mem) {
+		return false;
+	}
+
+	mi->iov = (struct iovec *)mem;
+	mi->n_iov = 0;
+	mi->msg_sz = buf_sz + ref_sz;
+
+	uint8_t *b = mem + (sizeof(struct iovec) * max_n_iov);
+	uint8_t *buf = write_response_header(b, mi->msg_sz, result_code, generation,
+			void_time, bin_count, trid, setname, setname_len);
+	uint8_t *seg = b;
 
 	for (uint16_t i = 0; i < bin_count; i++) {
-		as_msg_op *op = (as_msg_op *)buf;
+		as_msg_op *op = write_response_op_name(buf, ops, bins, i, ns);
 
-		op->version = 0;
+		buf += sizeof(as_msg_op) + op->name_sz;
 
-		if (ops) {
-			op->op = ops[i]->op;
-			memcpy(op->name, ops[i]->name, ops[i]->name_sz);
-			op->name_sz = ops[i]->name_sz;
+		const uint8_t *value;
+		uint32_t value_sz = as_bin_particle_client_value_ref(bins[i], &value);
+
+		if (value && value_sz >= MIN_IN_PLACE_VALUE_SZ) {
+			op->particle_type = as_bin_get_particle_type(bins[i]);
+			op->op_sz += value_sz;
+
+			mi->iov[mi->n_iov].iov_base = seg;
+			mi->iov[mi->n_iov++].iov_len = buf - seg;
+			mi->iov[mi->n_iov].iov_base = (void *)value;
+			mi->iov[mi->n_iov++].iov_len = value_sz;
+			seg = buf;
 		}
 		else {
-			op->op = AS_MSG_OP_READ;
-			op->name_sz = as_bin_memcpy_name(ns, op->name, bins[i]);
+			buf += as_bin_particle_to_client(bins[i], op);
 		}
 
-		op->op_sz = 4 + op->name_sz;
+		as_msg_swap_op(op);
+	}
 
-		buf += sizeof(as_msg_op) + op->name_sz;
-		buf += as_bin_particle_to_client(bins[i], op);
+	if (buf != seg) {
+		mi->iov[mi->n_iov].iov_base = seg;
+		mi->iov[mi->n_iov++].iov_len = buf - seg;
+	}
 
-		as_msg_swap_op(op);
+	return true;
+}
+
+
+// Send a response made by as_msg_make_response_iov(), and free it.
+int
+as_msg_send_response_iov(as_file_handle *fd_h, as_msg_iov *mi)
+{
+	int rv = 0;
+
+	if (fd_h->sock == NULL) {
+		cf_crash(AS_PROTO, "fd is NULL");
 	}
 
-	return (cl_msg *)b;
+	struct iovec *iov = mi->iov;
+	uint32_t n_iov = mi->n_iov;
+	size_t msg_sz = mi->msg_sz;
+	size_t pos = 0;
+
+	pthread_mutex_lock(&fd_h->send_lock);
+
+	while (pos < msg_sz) {
+		struct msghdr hdr;
+
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.msg_iov = iov;
+		hdr.msg_iovlen = n_iov < IOV_MAX ? n_iov : IOV_MAX;
+
+		int result = cf_socket_send_msg(fd_h->sock, &hdr, 0);
+
+		if (result > 0) {
+			pos += result;
+
+			// Skip past what was sent.
+			size_t sent = (size_t)result;
+
+			while (n_iov != 0 && sent >= iov->iov_len) {
+				sent -= iov->iov_len;
+				iov++;
+				n_iov--;
+			}
+
+			if (sent != 0) {
+				iov->iov_base = (uint8_t *)iov->iov_base + sent;
+				iov->iov_len -= sent;
+			}
+		}
+		else if (result < 0) {
+			if (errno != EWOULDBLOCK) {
+				// Common when a client aborts.
+				cf_debug(AS_PROTO, "protocol write fail: fd %d sz %zd pos %zd rv %d errno %d", CSFD(fd_h->sock), msg_sz, pos, rv, errno);
+				pthread_mutex_unlock(&fd_h->send_lock);
+				as_end_of_transaction_force_close(fd_h);
+				rv = -1;
+				goto Exit;
+			}
+
+			usleep(1); // yield
+		}
+		else {
+			cf_info(AS_PROTO, "protocol write fail zero return: fd %d sz %zu pos %zu ", CSFD(fd_h->sock), msg_sz, pos);
+			pthread_mutex_unlock(&fd_h->send_lock);
+			as_end_of_transaction_force_close(fd_h);
+			rv = -1;
+			goto Exit;
+		}
+	}
+
+	pthread_mutex_unlock(&fd_h->send_lock);
+	as_end_of_transaction_ok(fd_h);
+
+Exit:
+	cf_free(mi->iov);
+	mi->iov = NULL;
+
+	return rv;
 }
 
 
@@ -239,6 +451,8 @@ as_msg_send_ops_reply(as_file_handle *fd_h, cf_dyn_buf *db)
 	size_t msg_sz = db->used_sz;
 	size_t pos = 0;
 
+	pthread_mutex_lock(&fd_h->send_lock);
+
 	while (pos < msg_sz) {
 		int result = cf_socket_send(fd_h->sock, msgp + pos, msg_sz - pos, MSG_NOSIGNAL);
 
@@ -249,6 +463,7 @@ as_msg_send_ops_reply(as_file_handle *fd_h, cf_dyn_buf *db)
 			if (errno != EWOULDBLOCK) {
 				// Common when a client aborts.
 				cf_debug(AS_PROTO, "protocol write fail: fd %d sz %zd pos %zd rv %d errno %d", CSFD(fd_h->sock), msg_sz, pos, rv, errno);
+				pthread_mutex_unlock(&fd_h->send_lock);
 				as_end_of_transaction_force_close(fd_h);
 				rv = -1;
 				goto Exit;
@@ -258,12 +473,14 @@ as_msg_send_ops_reply(as_file_handle *fd_h, cf_dyn_buf *db)
 		}
 		else {
 			cf_info(AS_PROTO, "protocol write fail zero return: fd %d sz %zu pos %zu ", CSFD(fd_h->sock), msg_sz, pos);
+			pthread_mutex_unlock(&fd_h->send_lock);
 			as_end_of_transaction_force_close(fd_h);
 			rv = -1;
 			goto Exit;
 		}
 	}
 
+	pthread_mutex_unlock(&fd_h->send_lock);
 	as_end_of_transaction_ok(fd_h);
 
 Exit:
@@ -697,6 +914,9 @@ as_msg_send_reply(as_file_handle *fd_h, uint32_t result_code, uint32_t generatio
 //	cf_detail(AS_PROTO, "write fd %d",fd);
 
 	size_t pos = 0;
+
+	pthread_mutex_lock(&fd_h->send_lock);
+
 	while (pos < msg_sz) {
 		int rv = cf_socket_send(fd_h->sock, msgp + pos, msg_sz - pos, MSG_NOSIGNAL);
 		if (rv > 0) {
@@ -706,6 +926,7 @@ as_msg_send_reply(as_file_handle *fd_h, uint32_t result_code, uint32_t generatio
 			if (errno != EWOULDBLOCK) {
 				// common message when a client aborts
 				cf_debug(AS_PROTO, "protocol write fail: fd %d sz %zd pos %zd rv %d errno %d", CSFD(fd_h->sock), msg_sz, pos, rv, errno);
+				pthread_mutex_unlock(&fd_h->send_lock);
 				as_end_of_transaction_force_close(fd_h);
 				rv = -1;
 				goto Exit;
@@ -713,12 +934,14 @@ as_msg_send_reply(as_file_handle *fd_h, uint32_t result_code, uint32_t generatio
 			usleep(1); // Yield
 		} else {
 			cf_info(AS_PROTO, "protocol write fail zero return: fd %d sz %zu pos %zu ", CSFD(fd_h->sock), msg_sz, pos);
+			pthread_mutex_unlock(&fd_h->send_lock);
 			as_end_of_transaction_force_close(fd_h);
 			rv = -1;
 			goto Exit;
 		}
 	}
 
+	pthread_mutex_unlock(&fd_h->send_lock);
 	as_end_of_transaction_ok(fd_h);
 
 Exit:
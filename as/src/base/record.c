@@ -33,6 +33,7 @@
 #include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_atomic.h"
 #include "citrusleaf/cf_digest.h"
+#include "citrusleaf/cf_random.h"
 
 #include "arenax.h"
 #include "fault.h"
@@ -40,6 +41,7 @@
 
 #include "base/cfg.h"
 #include "base/datamodel.h"
+#include "base/expire_index.h"
 #include "base/index.h"
 #include "base/ldt.h"
 #include "base/rec_props.h"
@@ -59,6 +61,12 @@
 /* Used for debugging/tracing */
 static char * MOD = "partition.c::06/28/13";
 
+// LFU access counts are logarithmic - each access above the initial count is
+// less likely to increment it - and decay by one per period without access.
+#define LFU_INIT_COUNT 5
+#define LFU_LOG_FACTOR 10
+#define LFU_DECAY_PERIOD 60 // seconds
+
 
 /* as_record_initialize
  * Initialize the record.
@@ -86,6 +94,13 @@ void as_record_initialize(as_index_ref *r_ref, as_namespace *ns)
 		r->dim = NULL;
 	}
 
+	if (ns->evict_policy != AS_EVICT_POLICY_TTL) {
+		as_index_access *access = as_index_get_access(r);
+
+		access->last_access = as_record_void_time_get();
+		access->lfu_count = LFU_INIT_COUNT;
+	}
+
 	// clear everything owned by record
 	r->generation = 0;
 	r->void_time = 0;
@@ -292,6 +307,67 @@ as_record_done(as_index_ref *r_ref, as_namespace *ns)
 	cf_atomic64_decr(&g_stats.global_record_ref_count);
 }
 
+// Cheap per-thread random numbers, good enough for LFU increments.
+static inline uint32_t
+lfu_rand32()
+{
+	static __thread uint64_t state = 0;
+
+	if (state == 0) {
+		while ((state = cf_get_rand64()) == 0) {
+			;
+		}
+	}
+
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+
+	return (uint32_t)(state >> 32);
+}
+
+// Returns the LFU access count after decay for time since last access.
+uint8_t
+as_record_lfu_count(as_record *r, uint32_t now)
+{
+	as_index_access *access = as_index_get_access(r);
+	uint32_t n_periods = now > access->last_access ?
+			(now - access->last_access) / LFU_DECAY_PERIOD : 0;
+
+	return n_periods >= access->lfu_count ?
+			0 : access->lfu_count - (uint8_t)n_periods;
+}
+
+// Record an access, for LRU or LFU eviction. Record lock must be held.
+void
+as_record_touch(as_namespace *ns, as_record *r)
+{
+	if (ns->evict_policy == AS_EVICT_POLICY_TTL) {
+		return;
+	}
+
+	as_index_access *access = as_index_get_access(r);
+	uint32_t now = as_record_void_time_get();
+
+	if (ns->evict_policy == AS_EVICT_POLICY_LFU) {
+		uint8_t count = as_record_lfu_count(r, now);
+
+		if (count < UINT8_MAX) {
+			uint32_t base = count > LFU_INIT_COUNT ? count - LFU_INIT_COUNT : 0;
+
+			// Increment with probability 1 / (base * LFU_LOG_FACTOR + 1).
+			if ((uint64_t)lfu_rand32() * (base * LFU_LOG_FACTOR + 1) <
+					(uint64_t)UINT32_MAX + 1) {
+				count++;
+			}
+		}
+
+		access->lfu_count = count;
+	}
+
+	access->last_access = now;
+}
+
 // Called only for data-in-memory multi-bin, with no key currently stored.
 // Note - have to modify if/when other metadata joins key in as_rec_space.
 void
@@ -659,6 +735,11 @@ as_record_flatten_component(as_partition_reservation *rsv, as_storage_rd *rd,
 		return rv;
     }
 
+	if (rsv->p->expire_index && ! as_ldt_record_is_sub(r)) {
+		as_expire_index_add(rsv->p->expire_index, &r->key, r->void_time,
+				c->void_time);
+	}
+
 	r->void_time  = c->void_time;
 	r->last_update_time  = c->last_update_time;
 	r->generation = c->generation;
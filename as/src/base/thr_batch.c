@@ -113,6 +113,8 @@ batch_build_response(batch_transaction* btr, cf_buf_builder** bb_r)
 						as_msg_make_error_response_bufbuilder(&bmd->keyd, AS_PROTO_RESULT_FAIL_NOTFOUND, bb_r, ns->name);
 					}
 					else {
+						as_record_touch(ns, r);
+
 						// Make sure it's brought in from storage if necessary.
 						as_storage_rd rd;
 						if (get_data) {
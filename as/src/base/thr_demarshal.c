@@ -37,7 +37,6 @@
 #include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_atomic.h"
 #include "citrusleaf/cf_clock.h"
-#include "citrusleaf/cf_queue.h"
 
 #include "fault.h"
 #include "jem.h"
@@ -80,25 +79,17 @@ static demarshal_args *g_demarshal_args = 0;
 // File handle reaper.
 //
 
-pthread_mutex_t	g_file_handle_a_LOCK = PTHREAD_MUTEX_INITIALIZER;
+// Slots are filled by demarshal threads with a compare-and-swap, and emptied
+// only by the reaper - no lock is needed.
 as_file_handle	**g_file_handle_a = 0;
 uint			g_file_handle_a_sz;
 pthread_t		g_demarshal_reaper_th;
 
 void *thr_demarshal_reaper_fn(void *arg);
-static cf_queue *g_freeslot = 0;
 
-void
-thr_demarshal_pause(as_file_handle *fd_h)
-{
-	fd_h->trans_active = true;
-}
-
-void
-thr_demarshal_resume(as_file_handle *fd_h)
+static void
+thr_demarshal_rearm(as_file_handle *fd_h)
 {
-	fd_h->trans_active = false;
-
 	// Make the demarshal thread aware of pending connection data (if any).
 	// Writing to an FD's event mask makes the epoll instance re-check for
 	// data, even when edge-triggered. If there is data, the demarshal thread
@@ -113,43 +104,97 @@ thr_demarshal_resume(as_file_handle *fd_h)
 			sizeof(err_ok) / sizeof(int32_t), err_ok));
 }
 
+void
+thr_demarshal_pause(as_file_handle *fd_h)
+{
+	ck_pr_inc_32(&fd_h->n_trans_active);
+
+	// Until we know it's pipelined, don't read more behind it.
+	fd_h->exclusive = true;
+}
+
+void
+thr_demarshal_resume(as_file_handle *fd_h)
+{
+	ck_pr_dec_32(&fd_h->n_trans_active);
+	thr_demarshal_rearm(fd_h);
+}
+
+// Only called by the demarshal thread that owns the file handle.
+static bool
+thr_demarshal_can_read(as_file_handle *fd_h)
+{
+	uint32_t n_trans_active = ck_pr_load_32(&fd_h->n_trans_active);
+
+	if (n_trans_active == 0) {
+		fd_h->exclusive = false;
+		return true;
+	}
+
+	// Pipelined single-record transactions may overlap, up to the limit.
+	return fd_h->pipelined && ! fd_h->exclusive &&
+			n_trans_active < g_config.proto_pipeline_max;
+}
+
+// Pipelined responses are matched to requests by transaction id, so only
+// single-record transactions that have one may be pipelined.
+static bool
+thr_demarshal_is_pipelined(const as_transaction *tr)
+{
+	return g_config.proto_pipeline_max != 0 &&
+			tr->msgp->proto.type == PROTO_TYPE_AS_MSG &&
+			(tr->msgp->msg.info3 & AS_MSG_INFO3_PIPELINE) != 0 &&
+			(as_transaction_has_digest(tr) || as_transaction_has_key(tr)) &&
+			as_transaction_trid(tr) != 0;
+}
+
+// Called once, before demarshal threads start.
 void
 demarshal_file_handle_init()
 {
 	struct rlimit rl;
 
-	pthread_mutex_lock(&g_file_handle_a_LOCK);
+	if (-1 == getrlimit(RLIMIT_NOFILE, &rl)) {
+		cf_crash(AS_DEMARSHAL, "getrlimit: %s", cf_strerror(errno));
+	}
 
-	if (g_file_handle_a == 0) {
-		if (-1 == getrlimit(RLIMIT_NOFILE, &rl)) {
-			cf_crash(AS_DEMARSHAL, "getrlimit: %s", cf_strerror(errno));
-		}
+	// Initialize the message pointer array and the unread byte counters.
+	g_file_handle_a = cf_calloc(rl.rlim_cur, sizeof(as_proto *));
+	cf_assert(g_file_handle_a, AS_DEMARSHAL, CF_CRITICAL, "allocation: %s", cf_strerror(errno));
+	g_file_handle_a_sz = rl.rlim_cur;
 
-		// Initialize the message pointer array and the unread byte counters.
-		g_file_handle_a = cf_calloc(rl.rlim_cur, sizeof(as_proto *));
-		cf_assert(g_file_handle_a, AS_DEMARSHAL, CF_CRITICAL, "allocation: %s", cf_strerror(errno));
-		g_file_handle_a_sz = rl.rlim_cur;
+	pthread_create(&g_demarshal_reaper_th, 0, thr_demarshal_reaper_fn, 0);
 
-		for (int i = 0; i < g_file_handle_a_sz; i++) {
-			cf_queue_push(g_freeslot, &i);
-		}
+	// If config value is 0, set a maximum proto size based on the RLIMIT.
+	if (g_config.n_proto_fd_max == 0) {
+		g_config.n_proto_fd_max = rl.rlim_cur / 2;
+		cf_info(AS_DEMARSHAL, "setting default client file descriptors to %d", g_config.n_proto_fd_max);
+	}
+}
 
-		pthread_create(&g_demarshal_reaper_th, 0, thr_demarshal_reaper_fn, 0);
+// Claim a free slot, searching on from where this thread last inserted. The
+// table is sized well above the connection limit, so a free slot is usually
+// found in a few probes.
+static bool
+demarshal_file_handle_insert(as_file_handle *fd_h, uint *p_cursor)
+{
+	for (uint n = 0; n < g_file_handle_a_sz; n++) {
+		uint j = (*p_cursor + n) % g_file_handle_a_sz;
 
-		// If config value is 0, set a maximum proto size based on the RLIMIT.
-		if (g_config.n_proto_fd_max == 0) {
-			g_config.n_proto_fd_max = rl.rlim_cur / 2;
-			cf_info(AS_DEMARSHAL, "setting default client file descriptors to %d", g_config.n_proto_fd_max);
+		if (! g_file_handle_a[j] &&
+				ck_pr_cas_ptr(&g_file_handle_a[j], NULL, fd_h)) {
+			*p_cursor = j + 1;
+			return true;
 		}
 	}
 
-	pthread_mutex_unlock(&g_file_handle_a_LOCK);
+	return false;
 }
 
 // Keep track of the connections, since they're precious. Kill anything that
 // hasn't been used in a while. The file handle array keeps a reference count,
 // and allows a reaper to run through and find the ones to reap. The table is
-// only written by the demarshal threads, and only read by the reaper thread.
+// only filled by the demarshal threads, and only emptied by the reaper thread.
 void *
 thr_demarshal_reaper_fn(void *arg)
 {
@@ -166,8 +211,6 @@ thr_demarshal_reaper_fn(void *arg)
 			last = now;
 		}
 
-		pthread_mutex_lock(&g_file_handle_a_LOCK);
-
 		for (int i = 0; i < g_file_handle_a_sz; i++) {
 			if (g_file_handle_a[i]) {
 				as_file_handle *fd_h = g_file_handle_a[i];
@@ -180,7 +223,6 @@ thr_demarshal_reaper_fn(void *arg)
 				if (fd_h->reap_me) {
 					cf_debug(AS_DEMARSHAL, "Reaping FD %d as requested", CSFD(fd_h->sock));
 					g_file_handle_a[i] = 0;
-					cf_queue_push(g_freeslot, &i);
 					as_release_file_handle(fd_h);
 					fd_h = 0;
 				}
@@ -195,7 +237,6 @@ thr_demarshal_reaper_fn(void *arg)
 					cf_socket_shutdown(fd_h->sock); // will trigger epoll errors
 					cf_debug(AS_DEMARSHAL, "remove unused connection, fd %d", CSFD(fd_h->sock));
 					g_file_handle_a[i] = 0;
-					cf_queue_push(g_freeslot, &i);
 					as_release_file_handle(fd_h);
 					fd_h = 0;
 					g_stats.reaper_count++;
@@ -206,8 +247,6 @@ thr_demarshal_reaper_fn(void *arg)
 			}
 		}
 
-		pthread_mutex_unlock(&g_file_handle_a_LOCK);
-
 		if ((g_file_handle_a_sz / 10) > (g_file_handle_a_sz - inuse_cnt)) {
 			cf_warning(AS_DEMARSHAL, "less than ten percent file handles remaining: %d max %d inuse",
 					g_file_handle_a_sz, inuse_cnt);
@@ -374,12 +413,16 @@ log_as_proto_and_peeked_data(as_proto *proto, uint8_t *peekbuf, size_t peeked_da
 // Set of threads which talk to client over the connection for doing the needful
 // processing. Note that once fd is assigned to a thread all the work on that fd
 // is done by that thread. Fair fd usage is expected of the client. First thread
-// is special - also does accept [listens for new connections]. It is the only
-// thread which does it.
+// is special - also does accept [listens for new connections]. Unless
+// reuse-port is configured, it is the only thread which does it - with
+// reuse-port, every thread has its own service (and localhost) listener, the
+// kernel spreads connections across them, and each thread keeps the
+// connections it accepts.
 void *
 thr_demarshal(void *arg)
 {
 	cf_socket_cfg *s, *ls, *xs;
+	cf_socket_cfg my_s, my_ls;
 	cf_poll poll;
 	int nevents, i, n;
 	cf_clock last_fd_print = 0;
@@ -418,12 +461,46 @@ thr_demarshal(void *arg)
 
 	cf_poll_create(&poll);
 
+	// In shard mode this thread is a shard - other shards wake it to run
+	// transactions for its partitions.
+	cf_socket *wake_sock = NULL;
+
+	if (g_config.shard_transactions) {
+		wake_sock = as_tsvc_shard_attach((uint32_t)thr_id);
+		cf_poll_add_socket(poll, wake_sock, EPOLLIN, &wake_sock);
+	}
+
+	// With reuse-port, other threads open their own listeners on the same
+	// address & port as the first thread's.
+	if (thr_id != 0 && g_config.socket_reuse_port) {
+		my_s = *s;
+
+		if (0 != cf_socket_init_server(&my_s)) {
+			cf_crash(AS_DEMARSHAL, "couldn't initialize service socket for thread %d", thr_id);
+		}
+
+		cf_socket_disable_blocking(my_s.sock);
+		s = &my_s;
+		cf_poll_add_socket(poll, s->sock, EPOLLIN | EPOLLERR | EPOLLHUP, &s->sock);
+
+		if (ls->sock) {
+			my_ls = *ls;
+
+			if (0 != cf_socket_init_server(&my_ls)) {
+				cf_crash(AS_DEMARSHAL, "couldn't initialize localhost service socket for thread %d", thr_id);
+			}
+
+			cf_socket_disable_blocking(my_ls.sock);
+			ls = &my_ls;
+			cf_poll_add_socket(poll, ls->sock, EPOLLIN | EPOLLERR | EPOLLHUP, &ls->sock);
+		}
+	}
+
 	// First thread accepts new connection at interface socket.
 	if (thr_id == 0) {
-		demarshal_file_handle_init();
-
 		cf_poll_add_socket(poll, s->sock, EPOLLIN | EPOLLERR | EPOLLHUP, &s->sock);
-		cf_info(AS_DEMARSHAL, "Service started: socket %s:%d", s->addr, s->port);
+		cf_info(AS_DEMARSHAL, "Service started: socket %s:%d%s", s->addr, s->port,
+				g_config.socket_reuse_port ? " - all demarshal threads accept" : "");
 
 		if (ls->sock) {
 			cf_poll_add_socket(poll, ls->sock, EPOLLIN | EPOLLERR | EPOLLHUP, &ls->sock);
@@ -440,6 +517,7 @@ thr_demarshal(void *arg)
 	cf_detail(AS_DEMARSHAL, "demarshal thread started: id %d", thr_id);
 
 	int id_cntr = 0;
+	uint slot_cursor = (uint)thr_id * (g_file_handle_a_sz / MAX_DEMARSHAL_THREADS);
 
 	// Demarshal transactions from the socket.
 	for ( ; ; ) {
@@ -462,6 +540,12 @@ thr_demarshal(void *arg)
 		for (i = 0; i < nevents; i++) {
 			cf_socket **ssock = events[i].data;
 
+			if (ssock == &wake_sock) {
+				// Handed transactions are run below, after all events.
+				as_tsvc_shard_clear_wake();
+				continue;
+			}
+
 			if (ssock == &s->sock || ssock == &ls->sock || ssock == &xs->sock) {
 				// Accept new connections on the service socket.
 				cf_socket *csock;
@@ -513,7 +597,10 @@ thr_demarshal(void *arg)
 
 				fd_h->last_used = cf_getms();
 				fd_h->reap_me = false;
-				fd_h->trans_active = false;
+				fd_h->pipelined = false;
+				fd_h->exclusive = false;
+				fd_h->n_trans_active = 0;
+				pthread_mutex_init(&fd_h->send_lock, NULL);
 				fd_h->proto = 0;
 				fd_h->proto_unread = 0;
 				fd_h->fh_info = 0;
@@ -525,31 +612,23 @@ thr_demarshal(void *arg)
 				// into global table fails) because fd state could be anything.
 				cf_rc_reserve(fd_h);
 
-				pthread_mutex_lock(&g_file_handle_a_LOCK);
-
-				int j;
-				bool inserted = true;
-
-				if (0 != cf_queue_pop(g_freeslot, &j, CF_QUEUE_NOWAIT)) {
-					inserted = false;
-				}
-				else {
-					g_file_handle_a[j] = fd_h;
-				}
-
-				pthread_mutex_unlock(&g_file_handle_a_LOCK);
-
-				if (!inserted) {
+				if (! demarshal_file_handle_insert(fd_h, &slot_cursor)) {
 					cf_info(AS_DEMARSHAL, "unable to add socket to file handle table");
 					cf_socket_shutdown(csock);
 					cf_socket_close(csock);
 					cf_rc_free(fd_h); // will free even with ref-count of 2
 				}
 				else {
-					// Round-robin pick up demarshal thread epoll_fd and add
-					// this new connection to epoll.
-					int id = (id_cntr++) % g_demarshal_args->num_threads;
-					fd_h->poll = g_demarshal_args->polls[id];
+					if (g_config.socket_reuse_port) {
+						// Keep connections this thread accepted.
+						fd_h->poll = poll;
+					}
+					else {
+						// Round-robin pick up demarshal thread epoll_fd and
+						// add this new connection to epoll.
+						int id = (id_cntr++) % g_demarshal_args->num_threads;
+						fd_h->poll = g_demarshal_args->polls[id];
+					}
 
 					// Place the client socket in the event queue.
 					cf_poll_add_socket(fd_h->poll, csock, EPOLLIN | EPOLLET | EPOLLRDHUP, fd_h);
@@ -578,7 +657,7 @@ thr_demarshal(void *arg)
 					goto NextEvent_FD_Cleanup;
 				}
 
-				if (fd_h->trans_active) {
+				if (! thr_demarshal_can_read(fd_h)) {
 					goto NextEvent;
 				}
 
@@ -841,6 +920,18 @@ thr_demarshal(void *arg)
 
 					ASD_TRANS_DEMARSHAL(nodeid, (uint64_t) tr.msgp, as_transaction_trid(&tr));
 
+					bool pipelined = thr_demarshal_is_pipelined(&tr);
+
+					if (pipelined) {
+						fd_h->pipelined = true;
+						fd_h->exclusive = false;
+
+						// Edge-triggered - make sure we come back for any
+						// requests already buffered behind this one. Do it
+						// before handing off, after which fd_h may be gone.
+						thr_demarshal_rearm(fd_h);
+					}
+
 					// Either process the transaction directly in this thread,
 					// or queue it for processing by another thread (tsvc/info).
 					if (0 != thr_tsvc_process_or_enqueue(&tr)) {
@@ -867,11 +958,9 @@ NextEvent_FD_Cleanup:
 				}
 				// Remove the fd from the events list.
 				cf_poll_delete_socket(poll, sock);
-				pthread_mutex_lock(&g_file_handle_a_LOCK);
 				fd_h->reap_me = true;
 				as_release_file_handle(fd_h);
 				fd_h = 0;
-				pthread_mutex_unlock(&g_file_handle_a_LOCK);
 NextEvent:
 				;
 			}
@@ -879,6 +968,10 @@ NextEvent:
 			// We should never be canceled externally, but just in case...
 			pthread_testcancel();
 		}
+
+		if (wake_sock) {
+			as_tsvc_shard_drain();
+		}
 	}
 
 	return NULL;
@@ -894,14 +987,17 @@ as_demarshal_start()
 
 	dm->num_threads = g_config.n_service_threads;
 
-	g_freeslot = cf_queue_create(sizeof(int), true);
-	if (!g_freeslot) {
-		cf_crash(AS_DEMARSHAL, " Couldn't create reaper free list ");
+	// Threads may all accept connections, so do this up front.
+	demarshal_file_handle_init();
+
+	if (g_config.shard_transactions) {
+		as_tsvc_shards_init((uint32_t)dm->num_threads);
 	}
 
 	// Start the listener socket: note that because this is done after privilege
 	// de-escalation, we can't use privileged ports.
 	g_config.socket.reuse_addr = g_config.socket_reuse_addr;
+	g_config.socket.reuse_port = g_config.socket_reuse_port;
 	if (0 != cf_socket_init_server(&g_config.socket)) {
 		cf_crash(AS_DEMARSHAL, "couldn't initialize service socket");
 	}
@@ -912,6 +1008,7 @@ as_demarshal_start()
 	if (g_config.localhost_socket.addr) {
 		cf_debug(AS_DEMARSHAL, "Opening a localhost service socket");
 		g_config.localhost_socket.reuse_addr = g_config.socket_reuse_addr;
+		g_config.localhost_socket.reuse_port = g_config.socket_reuse_port;
 		if (0 != cf_socket_init_server(&g_config.localhost_socket)) {
 			cf_crash(AS_DEMARSHAL, "couldn't initialize localhost service socket");
 		}
@@ -49,6 +49,7 @@
 #include "fault.h"
 #include "jem.h"
 #include "meminfo.h"
+#include "olock.h"
 #include "socket.h"
 
 #include "ai_obj.h"
@@ -439,6 +440,54 @@ info_command_get_sl(char *name, char *params, cf_dyn_buf *db)
 	return 0;
 }
 
+int
+info_command_record_locks(char *name, char *params, cf_dyn_buf *db)
+{
+	// Command Format:  "record-locks"
+	//
+	// Reports lock totals and the most contended stripes, hottest first, as
+	// <stripe>:<acquired>:<contended>.
+
+	olock_stats stats;
+
+	olock_get_stats(g_record_locks, &stats);
+
+	info_append_uint32(db, "stripes", g_record_locks->n_locks);
+	info_append_uint64(db, "acquired", stats.n_acquired);
+	info_append_uint64(db, "contended", stats.n_contended);
+
+	cf_dyn_buf_append_string(db, "hot=");
+
+	for (uint32_t i = 0; i < stats.n_hot; i++) {
+		olock_hot *hot = &stats.hot[i];
+
+		if (i != 0) {
+			cf_dyn_buf_append_char(db, ',');
+		}
+
+		cf_dyn_buf_append_uint32(db, hot->stripe);
+		cf_dyn_buf_append_char(db, ':');
+		cf_dyn_buf_append_uint64(db, hot->n_acquired);
+		cf_dyn_buf_append_char(db, ':');
+		cf_dyn_buf_append_uint64(db, hot->n_contended);
+	}
+
+	return 0;
+}
+
+int
+info_command_record_locks_reset(char *name, char *params, cf_dyn_buf *db)
+{
+	// Command Format:  "record-locks-reset"
+
+	olock_clear_stats(g_record_locks);
+	cf_info(AS_INFO, "record-locks: counters reset");
+
+	cf_dyn_buf_append_string(db, "ok");
+
+	return 0;
+}
+
 int
 info_command_tip(char *name, char *params, cf_dyn_buf *db)
 {
@@ -1639,6 +1688,7 @@ info_service_config_get(cf_dyn_buf *db)
 	info_append_uint32(db, "nsup-delete-sleep", g_config.nsup_delete_sleep);
 	info_append_uint32(db, "nsup-period", g_config.nsup_period);
 	info_append_bool(db, "nsup-startup-evict", g_config.nsup_startup_evict);
+	info_append_uint32(db, "nsup-threads", g_config.nsup_threads);
 	info_append_uint64(db, "paxos-max-cluster-size", g_config.paxos_max_cluster_size);
 
 	info_append_string(db, "paxos-protocol",
@@ -1653,6 +1703,7 @@ info_service_config_get(cf_dyn_buf *db)
 
 	info_append_uint32(db, "paxos-retransmit-period", g_config.paxos_retransmit_period);
 	info_append_int(db, "proto-fd-idle-ms", g_config.proto_fd_idle_ms);
+	info_append_uint32(db, "proto-pipeline-max", g_config.proto_pipeline_max);
 	info_append_int(db, "proto-slow-netio-sleep-ms", g_config.proto_slow_netio_sleep_ms); // dynamic only
 	info_append_uint32(db, "query-batch-size", g_config.query_bsize);
 	info_append_uint32(db, "query-buf-size", g_config.query_buf_size); // dynamic only
@@ -1671,12 +1722,14 @@ info_service_config_get(cf_dyn_buf *db)
 	info_append_uint32(db, "query-threshold", g_config.query_threshold);
 	info_append_uint64(db, "query-untracked-time-ms", g_config.query_untracked_time_ms);
 	info_append_uint32(db, "query-worker-threads", g_config.query_worker_threads);
+	info_append_bool(db, "record-locks-adaptive", g_config.record_locks_adaptive);
 	info_append_bool(db, "respond-client-on-master-completion", g_config.respond_client_on_master_completion);
 	info_append_bool(db, "run-as-daemon", g_config.run_as_daemon);
 	info_append_uint32(db, "scan-max-active", g_config.scan_max_active);
 	info_append_uint32(db, "scan-max-done", g_config.scan_max_done);
 	info_append_uint32(db, "scan-max-udf-transactions", g_config.scan_max_udf_transactions);
 	info_append_uint32(db, "scan-threads", g_config.scan_threads);
+	info_append_bool(db, "shard-transactions", g_config.shard_transactions);
 	info_append_uint32(db, "sindex-builder-threads", g_config.sindex_builder_threads);
 
 	if (g_config.sindex_data_max_memory != ULONG_MAX) {
@@ -1731,6 +1784,7 @@ info_network_config_get(cf_dyn_buf *db)
 	}
 
 	info_append_bool(db, "service.reuse-address", g_config.socket_reuse_addr);
+	info_append_bool(db, "service.reuse-port", g_config.socket_reuse_port);
 
 	// Heartbeat:
 
@@ -1802,9 +1856,23 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 	info_append_bool(db, "enable-benchmarks-write", ns->write_benchmarks_enabled);
 	info_append_bool(db, "enable-hist-proxy", ns->proxy_hist_enabled);
 	info_append_uint32(db, "evict-hist-buckets", ns->evict_hist_buckets);
+
+	if (ns->evict_policy == AS_EVICT_POLICY_LRU) {
+		info_append_string(db, "evict-policy", "lru");
+	}
+	else if (ns->evict_policy == AS_EVICT_POLICY_LFU) {
+		info_append_string(db, "evict-policy", "lfu");
+	}
+	else {
+		info_append_string(db, "evict-policy", "ttl");
+	}
+
+	info_append_uint32(db, "evict-sample-size", ns->evict_sample_size);
 	info_append_uint32(db, "evict-tenths-pct", ns->evict_tenths_pct);
+	info_append_bool(db, "expiration-index", ns->expiration_index);
 	info_append_int(db, "high-water-disk-pct", (int)(ns->hwm_disk * 100));
 	info_append_int(db, "high-water-memory-pct", (int)(ns->hwm_memory * 100));
+	info_append_bool(db, "index-huge-pages", ns->index_huge_pages);
 	info_append_bool(db, "ldt-enabled", ns->ldt_enabled);
 	info_append_uint32(db, "ldt-gc-rate", ns->ldt_gc_sleep_us / 1000000);
 	info_append_uint32(db, "ldt-page-size", ns->ldt_page_size);
@@ -1812,6 +1880,7 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 	info_append_uint32(db, "migrate-order", ns->migrate_order);
 	info_append_uint32(db, "migrate-sleep", ns->migrate_sleep);
 	// Note - no obj-size-hist-max, too much to reverse rounding algorithm.
+	info_append_uint32(db, "partition-tree-sprigs", ns->partition_tree_sprigs);
 	info_append_string(db, "read-consistency-level-override", NS_READ_CONSISTENCY_LEVEL_NAME());
 	info_append_bool(db, "single-bin", ns->single_bin);
 	info_append_int(db, "stop-writes-pct", (int)(ns->stop_writes_pct * 100));
@@ -1845,7 +1914,13 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 		info_append_string(db, "storage-engine.scheduler-mode", ns->storage_scheduler_mode ? ns->storage_scheduler_mode : "null");
 		info_append_uint32(db, "storage-engine.write-block-size", ns->storage_write_block_size);
 		info_append_bool(db, "storage-engine.data-in-memory", ns->storage_data_in_memory);
+		info_append_uint32(db, "storage-engine.async-read-depth", ns->storage_async_read_depth);
 		info_append_bool(db, "storage-engine.cold-start-empty", ns->storage_cold_start_empty);
+		info_append_uint32(db, "storage-engine.cold-start-threads", ns->storage_cold_start_threads);
+		info_append_string(db, "storage-engine.compression",
+				ns->storage_compression == AS_STORAGE_COMPRESSION_ZLIB ? "zlib" : "none");
+		info_append_uint32(db, "storage-engine.compression-level", ns->storage_compression_level);
+		info_append_bool(db, "storage-engine.defrag-adaptive", ns->storage_defrag_adaptive);
 		info_append_uint32(db, "storage-engine.defrag-lwm-pct", ns->storage_defrag_lwm_pct);
 		info_append_uint32(db, "storage-engine.defrag-queue-min", ns->storage_defrag_queue_min);
 		info_append_uint32(db, "storage-engine.defrag-sleep", ns->storage_defrag_sleep);
@@ -1857,6 +1932,8 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 		info_append_uint64(db, "storage-engine.max-write-cache", ns->storage_max_write_cache);
 		info_append_uint32(db, "storage-engine.min-avail-pct", ns->storage_min_avail_pct);
 		info_append_uint32(db, "storage-engine.post-write-queue", ns->storage_post_write_queue);
+		info_append_uint64(db, "storage-engine.read-cache-size", ns->storage_read_cache_size);
+		info_append_uint32(db, "storage-engine.write-stripes", ns->storage_write_stripes);
 		info_append_uint32(db, "storage-engine.write-threads", ns->storage_write_threads);
 	}
 
@@ -2140,6 +2217,16 @@ info_command_config_set(char *name, char *params, cf_dyn_buf *db)
 			cf_info(AS_INFO, "Changing value of proto-fd-idle-ms from %d to %d ", g_config.proto_fd_idle_ms, val);
 			g_config.proto_fd_idle_ms = val;
 		}
+		else if (0 == as_info_parameter_get(params, "proto-pipeline-max", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val))
+				goto Error;
+			if (val < 0 || val > MAX_PROTO_PIPELINE) {
+				cf_warning(AS_INFO, "proto-pipeline-max must be between 0 and %d", MAX_PROTO_PIPELINE);
+				goto Error;
+			}
+			cf_info(AS_INFO, "Changing value of proto-pipeline-max from %u to %d ", g_config.proto_pipeline_max, val);
+			g_config.proto_pipeline_max = (uint32_t)val;
+		}
 		else if (0 == as_info_parameter_get(params, "proto-slow-netio-sleep-ms", context, &context_len)) {
 			if (0 != cf_str_atoi(context, &val))
 				goto Error;
@@ -2158,6 +2245,12 @@ info_command_config_set(char *name, char *params, cf_dyn_buf *db)
 			cf_info(AS_INFO, "Changing value of nsup-period from %d to %d ", g_config.nsup_period, val);
 			g_config.nsup_period = val;
 		}
+		else if (0 == as_info_parameter_get(params, "nsup-threads", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val) || val < 1 || val > MAX_NSUP_THREADS)
+				goto Error;
+			cf_info(AS_INFO, "Changing value of nsup-threads from %u to %d ", g_config.nsup_threads, val);
+			g_config.nsup_threads = (uint32_t)val;
+		}
 		else if (0 == as_info_parameter_get(params, "paxos-retransmit-period", context, &context_len)) {
 			if (0 != cf_str_atoi(context, &val))
 				goto Error;
@@ -2828,6 +2921,19 @@ info_command_config_set(char *name, char *params, cf_dyn_buf *db)
 			cf_info(AS_INFO, "Changing value of ldt-gc-rate of ns %s from %u to %d", ns->name, (1000 * 1000)/ns->ldt_gc_sleep_us , val);
 			ns->ldt_gc_sleep_us = 1000 * 1000 / rate;
 		}
+		else if (0 == as_info_parameter_get(params, "defrag-adaptive", context, &context_len)) {
+			if (strncmp(context, "true", 4) == 0 || strncmp(context, "yes", 3) == 0) {
+				cf_info(AS_INFO, "Changing value of defrag-adaptive of ns %s from %s to %s", ns->name, bool_val[ns->storage_defrag_adaptive], context);
+				ns->storage_defrag_adaptive = true;
+			}
+			else if (strncmp(context, "false", 5) == 0 || strncmp(context, "no", 2) == 0) {
+				cf_info(AS_INFO, "Changing value of defrag-adaptive of ns %s from %s to %s", ns->name, bool_val[ns->storage_defrag_adaptive], context);
+				ns->storage_defrag_adaptive = false;
+			}
+			else {
+				goto Error;
+			}
+		}
 		else if (0 == as_info_parameter_get(params, "defrag-lwm-pct", context, &context_len)) {
 			if (0 != cf_str_atoi(context, &val)) {
 				goto Error;
@@ -4928,6 +5034,10 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 
 		if (! ns->storage_data_in_memory) {
 			info_append_int(db, "cache_read_pct", (int)(ns->cache_read_pct + 0.5));
+
+			if (ns->storage_read_cache_size != 0) {
+				info_append_int(db, "read_cache_hit_pct", (int)(ns->read_cache_hit_pct + 0.5));
+			}
 		}
 	}
 
@@ -6096,6 +6206,8 @@ as_info_init()
 	as_info_set_command("mem", info_command_mem, PERM_NONE);                                  // Report on memory usage.
 	as_info_set_command("mstats", info_command_mstats, PERM_LOGGING_CTRL);                    // Dump GLibC-level memory stats.
 	as_info_set_command("mtrace", info_command_mtrace, PERM_SERVICE_CTRL);                    // Control GLibC-level memory tracing.
+	as_info_set_command("record-locks", info_command_record_locks, PERM_NONE);                // Report record lock contention.
+	as_info_set_command("record-locks-reset", info_command_record_locks_reset, PERM_SERVICE_CTRL); // Zero record lock contention counters.
 	as_info_set_command("set-config", info_command_config_set, PERM_SET_CONFIG);              // Set config values.
 	as_info_set_command("set-log", info_command_log_set, PERM_LOGGING_CTRL);                  // Set values in the log system.
 	as_info_set_command("show-devices", info_command_show_devices, PERM_LOGGING_CTRL);        // Print snapshot of wblocks to the log file.
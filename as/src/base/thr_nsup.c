@@ -41,6 +41,7 @@
 #include "citrusleaf/cf_clock.h"
 #include "citrusleaf/cf_digest.h"
 #include "citrusleaf/cf_queue.h"
+#include "citrusleaf/cf_random.h"
 
 #include "fault.h"
 #include "linear_hist.h"
@@ -48,13 +49,16 @@
 
 #include "base/cfg.h"
 #include "base/datamodel.h"
+#include "base/expire_index.h"
 #include "base/index.h"
 #include "base/ldt.h"
 #include "base/proto.h"
 #include "base/thr_sindex.h"
 #include "base/thr_tsvc.h"
 #include "base/transaction.h"
+#include "base/xdr_serverside.h"
 #include "storage/storage.h"
+#include "transaction/rw_utils.h"
 
 
 //==========================================================
@@ -700,20 +704,101 @@ queue_for_delete(as_namespace* ns, cf_digest* p_digest)
 	}
 }
 
+//------------------------------------------------
+// Delete a record from within a reduce callback,
+// without generating a delete transaction. Calls
+// as_record_done().
+//
+static void
+delete_in_place(as_namespace* ns, as_index_tree* tree, as_index_ref* r_ref,
+		bool is_master)
+{
+	as_record* r = r_ref->r;
+	cf_digest keyd = r->key;
+
+	if (ns->storage_data_in_memory) {
+		as_storage_rd rd;
+
+		as_storage_record_open(ns, r, &rd, &keyd);
+		delete_adjust_sindex(&rd);
+		as_storage_record_close(r, &rd);
+	}
+
+	uint16_t set_id = as_index_get_set_id(r);
+	as_generation generation = r->generation;
+
+	as_index_delete(tree, &keyd);
+	as_record_done(r_ref, ns);
+
+	if (is_master && xdr_must_ship_delete(ns, true, false)) {
+		xdr_write(ns, keyd, generation, 0, true, set_id, NULL);
+	}
+}
+
+//------------------------------------------------
+// A reduce thread's own copies of the namespace's
+// histograms, created as needed, and merged into
+// the originals when the thread is done.
+//
+typedef struct reduce_hists_s {
+	linear_hist*	obj_size_hist;
+	linear_hist*	set_obj_size_hists[AS_SET_MAX_COUNT + 1];
+	linear_hist*	evict_hist;
+	linear_hist*	ttl_hist;
+	linear_hist*	set_ttl_hists[AS_SET_MAX_COUNT + 1];
+} reduce_hists;
+
+static void
+reduce_hist_insert(linear_hist** p_thread_hist, linear_hist* hist,
+		uint32_t point)
+{
+	if (! *p_thread_hist) {
+		*p_thread_hist = linear_hist_create_like(hist);
+	}
+
+	linear_hist_insert_data_point(*p_thread_hist, point);
+}
+
+static void
+reduce_hist_merge(linear_hist* hist, linear_hist* thread_hist)
+{
+	if (thread_hist) {
+		linear_hist_merge(hist, thread_hist);
+		linear_hist_destroy(thread_hist);
+	}
+}
+
+// Caller must serialize merges.
+static void
+reduce_hists_merge(as_namespace* ns, reduce_hists* hists)
+{
+	reduce_hist_merge(ns->obj_size_hist, hists->obj_size_hist);
+	reduce_hist_merge(ns->evict_hist, hists->evict_hist);
+	reduce_hist_merge(ns->ttl_hist, hists->ttl_hist);
+
+	for (uint32_t set_id = 0; set_id <= AS_SET_MAX_COUNT; set_id++) {
+		reduce_hist_merge(ns->set_obj_size_hists[set_id],
+				hists->set_obj_size_hists[set_id]);
+		reduce_hist_merge(ns->set_ttl_hists[set_id],
+				hists->set_ttl_hists[set_id]);
+	}
+}
+
 //------------------------------------------------
 // Insert data into object size histograms.
 //
 static void
-add_to_obj_size_histograms(as_namespace* ns, as_index* r)
+add_to_obj_size_histograms(reduce_hists* hists, as_namespace* ns, as_index* r)
 {
 	uint32_t set_id = as_index_get_set_id(r);
 	linear_hist* set_obj_size_hist = ns->set_obj_size_hists[set_id];
 	uint64_t n_rblocks = r->storage_key.ssd.n_rblocks;
 
-	linear_hist_insert_data_point(ns->obj_size_hist, n_rblocks);
+	reduce_hist_insert(&hists->obj_size_hist, ns->obj_size_hist, n_rblocks);
 
 	if (set_obj_size_hist) {
-		linear_hist_insert_data_point(set_obj_size_hist, n_rblocks);
+		reduce_hist_insert(&hists->set_obj_size_hists[set_id],
+				set_obj_size_hist, n_rblocks);
 	}
 }
 
@@ -721,19 +806,34 @@ add_to_obj_size_histograms(as_namespace* ns, as_index* r)
 // Insert data into TTL histograms.
 //
 static void
-add_to_ttl_histograms(as_namespace* ns, as_index* r)
+add_to_ttl_histograms(reduce_hists* hists, as_namespace* ns, as_index* r)
 {
 	uint32_t set_id = as_index_get_set_id(r);
 	linear_hist* set_ttl_hist = ns->set_ttl_hists[set_id];
 	uint32_t void_time = r->void_time;
 
-	linear_hist_insert_data_point(ns->ttl_hist, void_time);
+	reduce_hist_insert(&hists->ttl_hist, ns->ttl_hist, void_time);
 
 	if (set_ttl_hist) {
-		linear_hist_insert_data_point(set_ttl_hist, void_time);
+		reduce_hist_insert(&hists->set_ttl_hists[set_id], set_ttl_hist,
+				void_time);
 	}
 }
 
+//------------------------------------------------
+// Common start of all master reduce callbacks'
+// udata. Each reduce thread works on its own copy
+// of the udata, and sets the tree per partition.
+//
+typedef struct reduce_hdr_s {
+	as_namespace*	ns;
+	as_index_tree*	tree;
+	reduce_hists*	hists;
+} reduce_hdr;
+
+// Adds a reduce thread's counts into the totals.
+typedef void (*reduce_merge_fn)(void* udata, const void* thread_udata);
+
 //------------------------------------------------
 // Reduce callback deletes sets.
 // - does set deletion
@@ -742,7 +842,7 @@ add_to_ttl_histograms(as_namespace* ns, as_index* r)
 // - counts 0-void-time records
 //
 typedef struct sets_delete_info_s {
-	as_namespace*	ns;
+	reduce_hdr		hdr;
 	uint32_t		now;
 	bool*			sets_deleting;
 	uint32_t		num_deleted;
@@ -755,7 +855,7 @@ sets_delete_reduce_cb(as_index_ref* r_ref, void* udata)
 {
 	as_index* r = r_ref->r;
 	sets_delete_info* p_info = (sets_delete_info*)udata;
-	as_namespace* ns = p_info->ns;
+	as_namespace* ns = p_info->hdr.ns;
 	uint32_t set_id = as_index_get_set_id(r);
 
 	if (p_info->sets_deleting[set_id]) {
@@ -770,29 +870,40 @@ sets_delete_reduce_cb(as_index_ref* r_ref, void* udata)
 
 	if (void_time != 0) {
 		if (p_info->now > void_time) {
-			queue_for_delete(ns, &r->key);
 			p_info->num_expired++;
+			delete_in_place(ns, p_info->hdr.tree, r_ref, true);
+			return;
 		}
-		else {
-			add_to_obj_size_histograms(ns, r);
-			add_to_ttl_histograms(ns, r);
-		}
+
+		add_to_obj_size_histograms(p_info->hdr.hists, ns, r);
+		add_to_ttl_histograms(p_info->hdr.hists, ns, r);
 	}
 	else {
-		add_to_obj_size_histograms(ns, r);
+		add_to_obj_size_histograms(p_info->hdr.hists, ns, r);
 		p_info->num_0_void_time++;
 	}
 
 	as_record_done(r_ref, ns);
 }
 
+static void
+sets_delete_merge(void* udata, const void* thread_udata)
+{
+	sets_delete_info* p_info = (sets_delete_info*)udata;
+	const sets_delete_info* p_thread_info = (const sets_delete_info*)thread_udata;
+
+	p_info->num_deleted += p_thread_info->num_deleted;
+	p_info->num_expired += p_thread_info->num_expired;
+	p_info->num_0_void_time += p_thread_info->num_0_void_time;
+}
+
 //------------------------------------------------
 // Reduce callback prepares for eviction.
 // - builds object size, eviction & TTL histograms
 // - counts 0-void-time records
 //
 typedef struct evict_prep_info_s {
-	as_namespace*	ns;
+	reduce_hdr		hdr;
 	bool*			sets_not_evicting;
 	uint32_t		num_0_void_time;
 } evict_prep_info;
@@ -802,18 +913,19 @@ evict_prep_reduce_cb(as_index_ref* r_ref, void* udata)
 {
 	as_index* r = r_ref->r;
 	evict_prep_info* p_info = (evict_prep_info*)udata;
-	as_namespace* ns = p_info->ns;
+	as_namespace* ns = p_info->hdr.ns;
 	uint32_t set_id = as_index_get_set_id(r);
 	uint32_t void_time = r->void_time;
 
-	add_to_obj_size_histograms(ns, r);
+	add_to_obj_size_histograms(p_info->hdr.hists, ns, r);
 
 	if (void_time != 0) {
 		if (! p_info->sets_not_evicting[set_id]) {
-			linear_hist_insert_data_point(ns->evict_hist, void_time);
+			reduce_hist_insert(&p_info->hdr.hists->evict_hist, ns->evict_hist,
+					void_time);
 		}
 
-		add_to_ttl_histograms(ns, r);
+		add_to_ttl_histograms(p_info->hdr.hists, ns, r);
 	}
 	else {
 		p_info->num_0_void_time++;
@@ -822,13 +934,22 @@ evict_prep_reduce_cb(as_index_ref* r_ref, void* udata)
 	as_record_done(r_ref, ns);
 }
 
+static void
+evict_prep_merge(void* udata, const void* thread_udata)
+{
+	evict_prep_info* p_info = (evict_prep_info*)udata;
+	const evict_prep_info* p_thread_info = (const evict_prep_info*)thread_udata;
+
+	p_info->num_0_void_time += p_thread_info->num_0_void_time;
+}
+
 //------------------------------------------------
 // Reduce callback evicts records.
 // - evicts based on general threshold
 // - does expiration on eviction-disabled sets
 //
 typedef struct evict_info_s {
-	as_namespace*	ns;
+	reduce_hdr		hdr;
 	uint32_t		now;
 	bool*			sets_not_evicting;
 	uint32_t		evict_void_time;
@@ -840,18 +961,22 @@ evict_reduce_cb(as_index_ref* r_ref, void* udata)
 {
 	as_index* r = r_ref->r;
 	evict_info* p_info = (evict_info*)udata;
-	as_namespace* ns = p_info->ns;
+	as_namespace* ns = p_info->hdr.ns;
 	uint32_t set_id = as_index_get_set_id(r);
 	uint32_t void_time = r->void_time;
 
 	if (void_time != 0) {
-		if (p_info->sets_not_evicting[set_id]) {
-			if (p_info->now > void_time) {
-				queue_for_delete(ns, &r->key);
-				p_info->num_evicted++;
-			}
+		// Already expired - no need to replicate, proles expire their own.
+		if (p_info->now > void_time &&
+				(p_info->sets_not_evicting[set_id] ||
+						void_time < p_info->evict_void_time)) {
+			p_info->num_evicted++;
+			delete_in_place(ns, p_info->hdr.tree, r_ref, true);
+			return;
 		}
-		else if (void_time < p_info->evict_void_time) {
+
+		if (! p_info->sets_not_evicting[set_id] &&
+				void_time < p_info->evict_void_time) {
 			queue_for_delete(ns, &r->key);
 			p_info->num_evicted++;
 		}
@@ -860,6 +985,15 @@ evict_reduce_cb(as_index_ref* r_ref, void* udata)
 	as_record_done(r_ref, ns);
 }
 
+static void
+evict_merge(void* udata, const void* thread_udata)
+{
+	evict_info* p_info = (evict_info*)udata;
+	const evict_info* p_thread_info = (const evict_info*)thread_udata;
+
+	p_info->num_evicted += p_thread_info->num_evicted;
+}
+
 //------------------------------------------------
 // Reduce callback expires records.
 // - does expiration
@@ -867,7 +1001,7 @@ evict_reduce_cb(as_index_ref* r_ref, void* udata)
 // - counts 0-void-time records
 //
 typedef struct expire_info_s {
-	as_namespace*	ns;
+	reduce_hdr		hdr;
 	uint32_t		now;
 	uint32_t		num_expired;
 	uint32_t		num_0_void_time;
@@ -878,44 +1012,424 @@ expire_reduce_cb(as_index_ref* r_ref, void* udata)
 {
 	as_index* r = r_ref->r;
 	expire_info* p_info = (expire_info*)udata;
-	as_namespace* ns = p_info->ns;
+	as_namespace* ns = p_info->hdr.ns;
 	uint32_t void_time = r->void_time;
 
 	if (void_time != 0) {
 		if (p_info->now > void_time) {
-			queue_for_delete(ns, &r->key);
 			p_info->num_expired++;
+			delete_in_place(ns, p_info->hdr.tree, r_ref, true);
+			return;
 		}
-		else {
-			add_to_obj_size_histograms(ns, r);
-			add_to_ttl_histograms(ns, r);
-		}
+
+		add_to_obj_size_histograms(p_info->hdr.hists, ns, r);
+		add_to_ttl_histograms(p_info->hdr.hists, ns, r);
 	}
 	else {
-		add_to_obj_size_histograms(ns, r);
+		add_to_obj_size_histograms(p_info->hdr.hists, ns, r);
 		p_info->num_0_void_time++;
 	}
 
 	as_record_done(r_ref, ns);
 }
 
+static void
+expire_merge(void* udata, const void* thread_udata)
+{
+	expire_info* p_info = (expire_info*)udata;
+	const expire_info* p_thread_info = (const expire_info*)thread_udata;
+
+	p_info->num_expired += p_thread_info->num_expired;
+	p_info->num_0_void_time += p_thread_info->num_0_void_time;
+}
+
+//------------------------------------------------
+// Reduce callback expires prole records. Masters
+// no longer replicate expiration deletes, so each
+// node expires its own proles.
+//
+typedef struct prole_expire_info_s {
+	reduce_hdr		hdr;
+	uint32_t		now;
+	uint32_t		num_expired;
+} prole_expire_info;
+
+static void
+prole_expire_reduce_cb(as_index_ref* r_ref, void* udata)
+{
+	prole_expire_info* p_info = (prole_expire_info*)udata;
+	uint32_t void_time = r_ref->r->void_time;
+
+	if (void_time != 0 && p_info->now > void_time) {
+		p_info->num_expired++;
+		delete_in_place(p_info->hdr.ns, p_info->hdr.tree, r_ref, false);
+		return;
+	}
+
+	as_record_done(r_ref, p_info->hdr.ns);
+}
+
+//------------------------------------------------
+// Threads reduce partitions, taking the next
+// unclaimed partition each time, so faster threads
+// pick up the slack from slower ones.
+//
+typedef struct reduce_thread_info_s {
+	as_namespace*		ns;
+	cf_atomic32			pid;
+	as_index_reduce_fn	cb;
+	const void*			udata_template; // counters zeroed
+	void*				udata;
+	size_t				udata_sz;
+	reduce_merge_fn		merge;
+	pthread_mutex_t		merge_lock;
+	uint32_t			prole_now; // 0 means don't expire proles
+	cf_atomic32			n_prole_expired;
+	cf_atomic32			n_waits;
+	const char*			tag;
+} reduce_thread_info;
+
+void*
+run_reduce_partitions(void* udata)
+{
+	reduce_thread_info* p_info = (reduce_thread_info*)udata;
+	as_namespace* ns = p_info->ns;
+
+	// Copy the template, not the caller's udata - threads that finish early
+	// merge their counts into that.
+	// (Declared as uint64_t array for alignment.)
+	uint64_t thread_udata[(p_info->udata_sz + 7) / 8];
+
+	memcpy(thread_udata, p_info->udata_template, p_info->udata_sz);
+
+	reduce_hists hists;
+
+	memset(&hists, 0, sizeof(hists));
+
+	reduce_hdr* hdr = (reduce_hdr*)thread_udata;
+
+	hdr->hists = &hists;
+
+	prole_expire_info prole_info;
+
+	memset(&prole_info, 0, sizeof(prole_info));
+	prole_info.hdr.ns = ns;
+	prole_info.now = p_info->prole_now;
+
+	as_partition_reservation rsv;
+	int pid;
+
+	while ((pid = (int)cf_atomic32_incr(&p_info->pid)) < AS_PARTITIONS) {
+		if (0 == as_partition_reserve_write(ns, pid, &rsv, 0, 0)) {
+			hdr->tree = rsv.p->vp;
+			as_index_reduce(rsv.p->vp, p_info->cb, thread_udata);
+			as_partition_release(&rsv);
+		}
+		else if (p_info->prole_now != 0 &&
+				0 == as_partition_reserve_read(ns, pid, &rsv, 0, 0)) {
+			prole_info.hdr.tree = rsv.p->vp;
+			as_index_reduce(rsv.p->vp, prole_expire_reduce_cb, &prole_info);
+			as_partition_release(&rsv);
+		}
+		else {
+			continue;
+		}
+
+		while (cf_queue_sz(g_p_nsup_delete_q) > DELETE_Q_SAFETY_THRESHOLD) {
+			usleep(DELETE_Q_SAFETY_SLEEP_us);
+			cf_atomic32_incr(&p_info->n_waits);
+		}
+
+		cf_debug(AS_NSUP, "{%s} %s done partition index %d", ns->name, p_info->tag, pid);
+	}
+
+	pthread_mutex_lock(&p_info->merge_lock);
+	p_info->merge(p_info->udata, thread_udata);
+	reduce_hists_merge(ns, &hists);
+	pthread_mutex_unlock(&p_info->merge_lock);
+
+	cf_atomic32_add(&p_info->n_prole_expired, prole_info.num_expired);
+
+	return NULL;
+}
+
 //------------------------------------------------
 // Reduce all master partitions, using specified
-// functionality. Throttle to make sure deletions
+// functionality, spread over nsup-threads threads.
+// If prole_now is non-zero, also expire records in
+// prole partitions. Throttle to make sure deletions
 // generated by reducing each partition don't blow
 // up the delete queue.
 //
 static void
-reduce_master_partitions(as_namespace* ns, as_index_reduce_fn cb, void* udata, uint32_t* p_n_waits, const char* tag)
+reduce_master_partitions(as_namespace* ns, as_index_reduce_fn cb, void* udata,
+		size_t udata_sz, reduce_merge_fn merge, uint32_t prole_now,
+		uint32_t* p_n_waits, const char* tag)
 {
-	as_partition_reservation rsv;
+	// Snapshot before any thread can merge into udata - its counters are
+	// still zero.
+	uint64_t udata_template[(udata_sz + 7) / 8];
+
+	memcpy(udata_template, udata, udata_sz);
+
+	reduce_thread_info info;
+
+	info.ns = ns;
+	info.pid = -1;
+	info.cb = cb;
+	info.udata_template = udata_template;
+	info.udata = udata;
+	info.udata_sz = udata_sz;
+	info.merge = merge;
+	pthread_mutex_init(&info.merge_lock, NULL);
+	info.prole_now = prole_now;
+	info.n_prole_expired = 0;
+	info.n_waits = 0;
+	info.tag = tag;
+
+	uint32_t n_threads = g_config.nsup_threads;
+
+	if (n_threads <= 1) {
+		run_reduce_partitions(&info);
+	}
+	else {
+		pthread_t threads[n_threads];
+
+		for (uint32_t n = 0; n < n_threads; n++) {
+			if (0 != pthread_create(&threads[n], NULL, run_reduce_partitions, &info)) {
+				cf_crash(AS_NSUP, "{%s} failed to create %s thread", ns->name, tag);
+			}
+		}
+
+		for (uint32_t n = 0; n < n_threads; n++) {
+			pthread_join(threads[n], NULL);
+		}
+	}
+
+	pthread_mutex_destroy(&info.merge_lock);
+
+	*p_n_waits += info.n_waits;
+
+	if (info.n_prole_expired != 0) {
+		cf_info(AS_NSUP, "{%s} %s expired %u prole records", ns->name, tag, info.n_prole_expired);
+	}
+}
+
+//------------------------------------------------
+// Expiration index callback expires a record if
+// it's due, or re-adds it if its void-time has
+// moved later.
+//
+typedef struct index_expire_info_s {
+	as_namespace*	ns;
+	as_index_tree*	tree;
+	as_expire_index* ei;
+	bool			is_master;
+	uint32_t		now;
+	uint32_t		num_expired;
+	uint32_t		num_prole_expired;
+} index_expire_info;
+
+static void
+index_expire_cb(cf_digest* keyd, uint32_t void_time, void* udata)
+{
+	index_expire_info* p_info = (index_expire_info*)udata;
+	as_namespace* ns = p_info->ns;
+
+	as_index_ref r_ref;
+	r_ref.skip_lock = false;
+
+	if (0 != as_record_get(p_info->tree, keyd, &r_ref, ns)) {
+		return; // already deleted
+	}
+
+	uint32_t current_void_time = r_ref.r->void_time;
+
+	if (current_void_time == 0 || p_info->now <= current_void_time) {
+		// Moved later - only this entry can cover it. (If it moved earlier, an
+		// entry was added for that.)
+		if (current_void_time > void_time) {
+			as_expire_index_add(p_info->ei, keyd, 0, current_void_time);
+		}
+
+		as_record_done(&r_ref, ns);
+		return;
+	}
+
+	if (p_info->is_master) {
+		p_info->num_expired++;
+	}
+	else {
+		p_info->num_prole_expired++;
+	}
+
+	delete_in_place(ns, p_info->tree, &r_ref, p_info->is_master);
+}
+
+// With an expiration index, still reduce (to build
+// histograms) on the first cycle, and at least once
+// every this many cycles.
+#define INDEX_HIST_REBUILD_CYCLES 10
+
+//------------------------------------------------
+// Expire records using the expiration index - cost
+// is proportional to the number of records due.
+// Entries for partitions not held are left until
+// the partition is held again.
+//
+static void
+expire_by_index(as_namespace* ns, uint32_t now, uint32_t* p_n_expired)
+{
+	index_expire_info cb_info;
+
+	memset(&cb_info, 0, sizeof(cb_info));
+	cb_info.ns = ns;
+	cb_info.now = now;
+
+	uint64_t n_popped = 0;
+	uint64_t n_remaining = 0;
+
+	for (int n = 0; n < AS_PARTITIONS; n++) {
+		as_partition_reservation rsv;
+		as_expire_index* ei = ns->partitions[n].expire_index;
+
+		if (0 == as_partition_reserve_write(ns, n, &rsv, 0, 0)) {
+			cb_info.is_master = true;
+		}
+		else if (0 == as_partition_reserve_read(ns, n, &rsv, 0, 0)) {
+			cb_info.is_master = false;
+		}
+		else {
+			n_remaining += as_expire_index_n_entries(ei);
+			continue;
+		}
+
+		cb_info.tree = rsv.p->vp;
+		cb_info.ei = ei;
+
+		n_popped += as_expire_index_pop_due(ei, now, index_expire_cb, &cb_info);
+		n_remaining += as_expire_index_n_entries(ei);
+
+		as_partition_release(&rsv);
+	}
+
+	*p_n_expired = cb_info.num_expired;
+
+	cf_info(AS_NSUP, "{%s} expiration index: popped %"PRIu64", expired %u master %u prole, %"PRIu64" entries remain",
+			ns->name, n_popped, cb_info.num_expired, cb_info.num_prole_expired, n_remaining);
+}
+
+//------------------------------------------------
+// Sample callback finds the least recently (or
+// least frequently) accessed evictable record.
+//
+typedef struct sample_evict_info_s {
+	as_namespace*	ns;
+	uint32_t		now;
+	bool*			sets_not_evicting;
+	bool			found;
+	uint64_t		worst_score;
+	cf_digest		worst_keyd;
+} sample_evict_info;
+
+static void
+sample_evict_reduce_cb(as_index_ref* r_ref, void* udata)
+{
+	as_index* r = r_ref->r;
+	sample_evict_info* p_info = (sample_evict_info*)udata;
+	as_namespace* ns = p_info->ns;
+	as_index_access* access = as_index_get_access(r);
+
+	// Skip 0-void-time records, protected sets, and records already queued.
+	if (r->void_time != 0 &&
+			! p_info->sets_not_evicting[as_index_get_set_id(r)] &&
+			access->last_access != UINT32_MAX) {
+		uint64_t score = access->last_access;
+
+		// LFU breaks ties between equal counts by recency.
+		if (ns->evict_policy == AS_EVICT_POLICY_LFU) {
+			score |= (uint64_t)as_record_lfu_count(r, p_info->now) << 32;
+		}
+
+		if (! p_info->found || score < p_info->worst_score) {
+			p_info->found = true;
+			p_info->worst_score = score;
+			p_info->worst_keyd = r->key;
+		}
+	}
+
+	as_record_done(r_ref, ns);
+}
+
+//------------------------------------------------
+// Evict evict-tenths-pct of each master partition's
+// records, each one the worst of evict-sample-size
+// records following a random digest.
+//
+static uint32_t
+evict_by_sampling(as_namespace* ns, uint32_t now, bool* sets_not_evicting,
+		uint32_t* p_n_waits)
+{
+	sample_evict_info cb_info;
+
+	cb_info.ns = ns;
+	cb_info.now = now;
+	cb_info.sets_not_evicting = sets_not_evicting;
+
+	uint64_t n_target_x1000 = 0; // carry fractions across partitions
+	uint32_t n_evicted = 0;
+	uint32_t n_misses = 0;
 
 	for (int n = 0; n < AS_PARTITIONS; n++) {
+		as_partition_reservation rsv;
+
 		if (0 != as_partition_reserve_write(ns, n, &rsv, 0, 0)) {
 			continue;
 		}
 
-		as_index_reduce(rsv.p->vp, cb, udata);
+		as_index_tree* tree = rsv.p->vp;
+
+		n_target_x1000 += (uint64_t)as_index_tree_size(tree) * ns->evict_tenths_pct;
+
+		uint64_t quota = n_target_x1000 / 1000 > n_evicted ?
+				n_target_x1000 / 1000 - n_evicted : 0;
+		uint64_t max_attempts = quota * 4;
+
+		for (uint64_t a = 0; quota != 0 && a < max_attempts; a++) {
+			cf_digest keyd;
+			uint64_t rand[3] = { cf_get_rand64(), cf_get_rand64(), cf_get_rand64() };
+
+			memcpy(keyd.digest, rand, sizeof(keyd.digest));
+
+			// Keep the partition bits, so the digest falls among the tree's.
+			*(uint32_t*)keyd.digest =
+					(*(uint32_t*)keyd.digest & ~AS_PARTITION_MASK) | (uint32_t)n;
+
+			cb_info.found = false;
+
+			as_index_reduce_sample(tree, &keyd, ns->evict_sample_size,
+					sample_evict_reduce_cb, &cb_info);
+
+			if (! cb_info.found) {
+				n_misses++;
+				continue;
+			}
+
+			as_index_ref r_ref;
+			r_ref.skip_lock = false;
+
+			if (0 != as_record_get(tree, &cb_info.worst_keyd, &r_ref, ns)) {
+				continue;
+			}
+
+			// Mark it so later samples pass it over while it's queued.
+			as_index_get_access(r_ref.r)->last_access = UINT32_MAX;
+			as_record_done(&r_ref, ns);
+
+			queue_for_delete(ns, &cb_info.worst_keyd);
+			n_evicted++;
+			quota--;
+		}
 
 		as_partition_release(&rsv);
 
@@ -923,9 +1437,13 @@ reduce_master_partitions(as_namespace* ns, as_index_reduce_fn cb, void* udata, u
 			usleep(DELETE_Q_SAFETY_SLEEP_us);
 			(*p_n_waits)++;
 		}
-
-		cf_debug(AS_NSUP, "{%s} %s done partition index %d, waits %u", ns->name, tag, n, *p_n_waits);
 	}
+
+	cf_info(AS_NSUP, "{%s} %s sampled eviction: evicted %u, %u samples found nothing evictable",
+			ns->name, ns->evict_policy == AS_EVICT_POLICY_LRU ? "lru" : "lfu",
+			n_evicted, n_misses);
+
+	return n_evicted;
 }
 
 //------------------------------------------------
@@ -1148,6 +1666,11 @@ thr_nsup(void *arg)
 		prole_pids[n] = -1;
 	}
 
+	// Cycles since the last reduce, for namespaces with an expiration index.
+	uint32_t index_cycles[g_config.n_namespaces];
+
+	memset(index_cycles, 0, sizeof(index_cycles));
+
 	uint64_t last_time = cf_get_seconds();
 
 	for ( ; ; ) {
@@ -1171,7 +1694,14 @@ thr_nsup(void *arg)
 
 			cf_info(AS_NSUP, "{%s} nsup start", ns->name);
 
-			linear_hist_clear(ns->obj_size_hist, 0, cf_atomic32_get(ns->obj_size_hist_max));
+			// With an expiration index, most cycles don't reduce, and leave
+			// histograms as of the last cycle that did.
+			bool use_index = ns->expiration_index && index_cycles[i] != 0;
+			bool clear_hists = ! use_index;
+
+			if (clear_hists) {
+				linear_hist_clear(ns->obj_size_hist, 0, cf_atomic32_get(ns->obj_size_hist_max));
+			}
 
 			// The "now" used for all expiration and eviction.
 			uint32_t now = as_record_void_time_get();
@@ -1179,7 +1709,9 @@ thr_nsup(void *arg)
 			// Get the histogram range - used by all histograms.
 			uint32_t ttl_range = (uint32_t)get_ttl_range(ns, now);
 
-			linear_hist_clear(ns->ttl_hist, now, ttl_range);
+			if (clear_hists) {
+				linear_hist_clear(ns->ttl_hist, now, ttl_range);
+			}
 
 			uint32_t n_expired_records = 0;
 			uint32_t n_0_void_time_records = 0;
@@ -1202,8 +1734,13 @@ thr_nsup(void *arg)
 			for (uint32_t j = 0; j < num_sets; j++) {
 				uint32_t set_id = j + 1;
 
-				clear_set_obj_size_hist(ns, set_id);
-				clear_set_ttl_hist(ns, set_id, now, ttl_range);
+				if (clear_hists || ! ns->set_obj_size_hists[set_id]) {
+					clear_set_obj_size_hist(ns, set_id);
+				}
+
+				if (clear_hists || ! ns->set_ttl_hists[set_id]) {
+					clear_set_ttl_hist(ns, set_id, now, ttl_range);
+				}
 
 				as_set* p_set;
 
@@ -1232,16 +1769,28 @@ thr_nsup(void *arg)
 			}
 
 			if (do_set_deletion) {
+				if (! clear_hists) {
+					linear_hist_clear(ns->obj_size_hist, 0, cf_atomic32_get(ns->obj_size_hist_max));
+					linear_hist_clear(ns->ttl_hist, now, ttl_range);
+
+					for (uint32_t j = 0; j < num_sets; j++) {
+						uint32_t set_id = j + 1;
+
+						linear_hist_clear(ns->set_obj_size_hists[set_id], 0, cf_atomic32_get(ns->obj_size_hist_max));
+						linear_hist_clear(ns->set_ttl_hists[set_id], now, ttl_range);
+					}
+				}
+
 				sets_delete_info cb_info;
 
 				memset(&cb_info, 0, sizeof(cb_info));
-				cb_info.ns = ns;
+				cb_info.hdr.ns = ns;
 				cb_info.now = now;
 				cb_info.sets_deleting = sets_deleting;
 
 				// Reduce master partitions, doing set deletion and general
 				// expiration.
-				reduce_master_partitions(ns, sets_delete_reduce_cb, &cb_info, &n_set_waits, "sets-delete");
+				reduce_master_partitions(ns, sets_delete_reduce_cb, &cb_info, sizeof(cb_info), sets_delete_merge, now, &n_set_waits, "sets-delete");
 
 				n_deleted_set_records = cb_info.num_deleted;
 				n_expired_records = cb_info.num_expired;
@@ -1272,7 +1821,11 @@ thr_nsup(void *arg)
 			cf_atomic32_set(&ns->stop_writes, stop_writes ? 1 : 0);
 			cf_atomic32_set(&ns->hwm_breached, hwm_breached ? 1 : 0);
 
-			if (hwm_breached) {
+			bool sampled_eviction = hwm_breached &&
+					ns->evict_policy != AS_EVICT_POLICY_TTL;
+			bool expired_by_index = false;
+
+			if (hwm_breached && ! sampled_eviction) {
 				// Eviction is necessary.
 
 				linear_hist_clear(ns->obj_size_hist, 0, cf_atomic32_get(ns->obj_size_hist_max));
@@ -1289,19 +1842,19 @@ thr_nsup(void *arg)
 				evict_prep_info cb_info1;
 
 				memset(&cb_info1, 0, sizeof(cb_info1));
-				cb_info1.ns = ns;
+				cb_info1.hdr.ns = ns;
 				cb_info1.sets_not_evicting = sets_not_evicting;
 
 				// Reduce master partitions, building histograms to calculate
 				// general eviction threshold.
-				reduce_master_partitions(ns, evict_prep_reduce_cb, &cb_info1, &n_general_waits, "evict-prep");
+				reduce_master_partitions(ns, evict_prep_reduce_cb, &cb_info1, sizeof(cb_info1), evict_prep_merge, 0, &n_general_waits, "evict-prep");
 
 				n_0_void_time_records = cb_info1.num_0_void_time;
 
 				evict_info cb_info2;
 
 				memset(&cb_info2, 0, sizeof(cb_info2));
-				cb_info2.ns = ns;
+				cb_info2.hdr.ns = ns;
 				cb_info2.now = now;
 				cb_info2.sets_not_evicting = sets_not_evicting;
 
@@ -1313,7 +1866,7 @@ thr_nsup(void *arg)
 
 					// Reduce master partitions, deleting records up to
 					// threshold. (This automatically deletes expired records.)
-					reduce_master_partitions(ns, evict_reduce_cb, &cb_info2, &n_general_waits, "evict");
+					reduce_master_partitions(ns, evict_reduce_cb, &cb_info2, sizeof(cb_info2), evict_merge, now, &n_general_waits, "evict");
 
 					evict_ttl = cb_info2.evict_void_time - now;
 					n_evicted_records = cb_info2.num_evicted;
@@ -1324,7 +1877,7 @@ thr_nsup(void *arg)
 
 					// Reduce master partitions, deleting expired records,
 					// including those in eviction-protected sets.
-					reduce_master_partitions(ns, evict_reduce_cb, &cb_info2, &n_general_waits, "expire-protected-sets");
+					reduce_master_partitions(ns, evict_reduce_cb, &cb_info2, sizeof(cb_info2), evict_merge, now, &n_general_waits, "expire-protected-sets");
 
 					// Count these as expired rather than evicted, since we can.
 					n_expired_records = cb_info2.num_evicted;
@@ -1333,23 +1886,53 @@ thr_nsup(void *arg)
 				// For now there's no get_info() call for evict_hist.
 				//linear_hist_save_info(ns->evict_hist);
 			}
+			else if (! do_set_deletion && use_index) {
+				// TTL-based eviction is not necessary, only expiration - the
+				// expiration index has the records due, no need to reduce.
+				// Histograms and 0-void-time count are left as of the last
+				// reduce.
+
+				expire_by_index(ns, now, &n_expired_records);
+				n_0_void_time_records = ns->non_expirable_objects;
+				expired_by_index = true;
+			}
 			else if (! do_set_deletion) {
-				// Eviction is not necessary, only expiration. (But if set
-				// deletion was done, expiration has already been done.)
+				// TTL-based eviction is not necessary, only expiration. (But if
+				// set deletion was done, expiration has already been done.)
 
 				expire_info cb_info;
 
 				memset(&cb_info, 0, sizeof(cb_info));
-				cb_info.ns = ns;
+				cb_info.hdr.ns = ns;
 				cb_info.now = now;
 
 				// Reduce master partitions, deleting expired records.
-				reduce_master_partitions(ns, expire_reduce_cb, &cb_info, &n_general_waits, "expire");
+				reduce_master_partitions(ns, expire_reduce_cb, &cb_info, sizeof(cb_info), expire_merge, now, &n_general_waits, "expire");
 
 				n_expired_records = cb_info.num_expired;
 				n_0_void_time_records = cb_info.num_0_void_time;
 			}
 
+			// A reduce did the expiring, but the expiration index must still
+			// move on, or due entries pile up. Most will find their records
+			// already gone.
+			if (ns->expiration_index && ! expired_by_index) {
+				uint32_t n_index_expired = 0;
+
+				expire_by_index(ns, now, &n_index_expired);
+				n_expired_records += n_index_expired;
+			}
+
+			if (ns->expiration_index) {
+				index_cycles[i] = expired_by_index ?
+						(index_cycles[i] + 1) % INDEX_HIST_REBUILD_CYCLES : 1;
+			}
+
+			if (sampled_eviction) {
+				// Expiration is done - evict sampled records by access.
+				n_evicted_records = evict_by_sampling(ns, now, sets_not_evicting, &n_general_waits);
+			}
+
 			linear_hist_dump(ns->obj_size_hist);
 			linear_hist_save_info(ns->obj_size_hist);
 			linear_hist_dump(ns->ttl_hist);
@@ -22,21 +22,25 @@
 
 #include "base/thr_tsvc.h"
 
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
 
 #include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_atomic.h"
 #include "citrusleaf/cf_clock.h"
 #include "citrusleaf/cf_digest.h"
-#include "citrusleaf/cf_queue.h"
 
 #include "fault.h"
+#include "mpmc_queue.h"
+#include "socket.h"
 #include "util.h"
 
 #include "base/cfg.h"
@@ -345,7 +349,8 @@ process_transaction(as_transaction *tr)
 			as_partition_release(&tr->rsv);
 			break;
 		case TRANS_IN_PROGRESS:
-			// Don't free msg or release reservation - both owned by rw_request.
+			// Don't free msg or release reservation - both owned by rw_request
+			// (or by an async read).
 			free_msgp = false;
 			break;
 		case TRANS_WAITING:
@@ -397,27 +402,36 @@ Cleanup:
 } // end process_transaction()
 
 
+// Transactions beyond this go to a queue's (locked) overflow.
+#define TSVC_QUEUE_CAPACITY (8 * 1024)
+
+// Small enough that a thread doesn't sit on work its siblings could take.
+#define TSVC_POP_BATCH_SIZE 8
+
 // Service transactions - arg is the queue we're to service.
 void *
 thr_tsvc(void *arg)
 {
-	cf_queue *q = (cf_queue *) arg;
+	mpmc_queue *q = (mpmc_queue *) arg;
 
 	cf_assert(arg, AS_TSVC, CF_CRITICAL, "invalid argument");
 
-	// Wait for a transaction to arrive.
+	// Wait for transactions to arrive - take a few per wakeup.
 	for ( ; ; ) {
-		as_transaction tr;
-		if (0 != cf_queue_pop(q, &tr, CF_QUEUE_FOREVER)) {
-			cf_crash(AS_TSVC, "unable to pop from transaction queue");
-		}
+		uint8_t buf[TSVC_POP_BATCH_SIZE * AS_TRANSACTION_HEAD_SIZE];
+		uint32_t n_trs = mpmc_queue_pop_batch(q, buf, TSVC_POP_BATCH_SIZE);
 
-		if (g_config.svc_benchmarks_enabled &&
-				tr.benchmark_time != 0 && ! as_transaction_is_restart(&tr)) {
-			histogram_insert_data_point(g_stats.svc_queue_hist, tr.benchmark_time);
-		}
+		for (uint32_t i = 0; i < n_trs; i++) {
+			as_transaction tr;
+			memcpy(&tr, buf + (i * AS_TRANSACTION_HEAD_SIZE), AS_TRANSACTION_HEAD_SIZE);
 
-		process_transaction(&tr);
+			if (g_config.svc_benchmarks_enabled &&
+					tr.benchmark_time != 0 && ! as_transaction_is_restart(&tr)) {
+				histogram_insert_data_point(g_stats.svc_queue_hist, tr.benchmark_time);
+			}
+
+			process_transaction(&tr);
+		}
 	}
 
 	return NULL;
@@ -432,7 +446,7 @@ transaction_thread(int i, int j)
 	return g_transaction_threads + (g_config.n_transaction_threads_per_queue * i) + j;
 }
 
-cf_queue* g_transaction_queues[MAX_TRANSACTION_QUEUES];
+mpmc_queue* g_transaction_queues[MAX_TRANSACTION_QUEUES];
 uint32_t g_current_q = 0;
 
 void
@@ -475,7 +489,11 @@ as_tsvc_init()
 
 	// Create the transaction queues.
 	for (int i = 0; i < g_config.n_transaction_queues ; i++) {
-		g_transaction_queues[i] = cf_queue_create(AS_TRANSACTION_HEAD_SIZE, true);
+		g_transaction_queues[i] = mpmc_queue_create(AS_TRANSACTION_HEAD_SIZE, TSVC_QUEUE_CAPACITY);
+
+		if (! g_transaction_queues[i]) {
+			cf_crash(AS_TSVC, "transaction queue %d create failed", i);
+		}
 	}
 
 	// Allocate the transaction threads that service all the queues.
@@ -496,11 +514,277 @@ as_tsvc_init()
 } // end thr_tsvc_init()
 
 
+//==========================================================
+// Shard-per-core mode.
+//
+// With shard-transactions, each service (demarshal) thread is a shard, pinned
+// to a CPU, which owns the partitions whose ids are congruent to its index
+// modulo the number of shards. A shard runs transactions for its own partitions
+// to completion in its own thread. Others are handed to the owning shard via a
+// single-producer single-consumer ring - one per (producer, owner) pair - and
+// the owner is woken through an eventfd in its poll set when the producer finds
+// it may have drained the ring. If a ring is full, the transaction falls back
+// to the transaction queues, as do transactions from all other sources.
+//
+// An owner's inbound slots are split across its producers, so ring memory grows
+// only linearly with the number of shards (until rings hit their minimum size).
+//
+
+#define SHARD_INBOUND_SLOTS 1024 // per owner - must be power of 2
+#define SHARD_RING_MIN_SIZE 8 // must be power of 2
+
+typedef struct shard_ring_s {
+	uint32_t	head; // written only by owner
+	uint8_t		pad0[60];
+	uint32_t	tail; // written only by producer
+	uint8_t		pad1[60];
+	uint8_t		trs[][AS_TRANSACTION_HEAD_SIZE];
+} __attribute__ ((aligned(64))) shard_ring;
+
+typedef struct tsvc_shard_s {
+	cf_socket	wake_sock; // eventfd
+	uint8_t*	rings; // inbound, indexed by producer shard - see shard_ring_of()
+} tsvc_shard;
+
+static tsvc_shard* g_shards = NULL;
+static uint32_t g_n_shards = 0;
+static uint32_t g_ring_size = 0; // power of 2
+static size_t g_ring_stride = 0;
+static uint32_t* g_shard_cpus = NULL; // CPUs to pin to, from our affinity mask
+static uint32_t g_n_shard_cpus = 0;
+static __thread int32_t t_shard_id = -1; // -1 if not a shard thread
+
+
+static inline shard_ring*
+shard_ring_of(const tsvc_shard* shard, uint32_t producer)
+{
+	return (shard_ring*)(shard->rings + (producer * g_ring_stride));
+}
+
+
+static void
+shard_cpus_init()
+{
+	cpu_set_t cpus;
+
+	if (0 != sched_getaffinity(0, sizeof(cpus), &cpus)) {
+		cf_warning(AS_TSVC, "shard sched_getaffinity failed: %s - won't pin shards",
+				cf_strerror(errno));
+		return;
+	}
+
+	uint32_t n_cpus = (uint32_t)CPU_COUNT(&cpus);
+
+	if (n_cpus == 0) {
+		return;
+	}
+
+	if (! (g_shard_cpus = cf_malloc(sizeof(uint32_t) * n_cpus))) {
+		cf_crash(AS_TSVC, "shard cpu array allocation failed");
+	}
+
+	for (uint32_t cpu = 0; cpu < CPU_SETSIZE && g_n_shard_cpus < n_cpus; cpu++) {
+		if (CPU_ISSET(cpu, &cpus)) {
+			g_shard_cpus[g_n_shard_cpus++] = cpu;
+		}
+	}
+}
+
+
+void
+as_tsvc_shards_init(uint32_t n_shards)
+{
+	g_shards = cf_malloc(sizeof(tsvc_shard) * n_shards);
+
+	if (! g_shards) {
+		cf_crash(AS_TSVC, "shard array allocation failed");
+	}
+
+	g_ring_size = SHARD_INBOUND_SLOTS;
+
+	while (g_ring_size > SHARD_RING_MIN_SIZE &&
+			g_ring_size * n_shards > SHARD_INBOUND_SLOTS) {
+		g_ring_size >>= 1;
+	}
+
+	// Keep each ring on its own cache lines.
+	g_ring_stride = (sizeof(shard_ring) +
+			(g_ring_size * AS_TRANSACTION_HEAD_SIZE) + 63) & ~(size_t)63;
+
+	for (uint32_t i = 0; i < n_shards; i++) {
+		tsvc_shard* shard = &g_shards[i];
+		int fd = eventfd(0, EFD_NONBLOCK);
+
+		if (fd < 0) {
+			cf_crash(AS_TSVC, "shard %u eventfd failed: %s", i, cf_strerror(errno));
+		}
+
+		shard->wake_sock.fd = fd;
+
+		size_t rings_size = g_ring_stride * n_shards;
+
+		if (! (shard->rings = cf_valloc(rings_size))) {
+			cf_crash(AS_TSVC, "shard %u ring allocation failed", i);
+		}
+
+		memset(shard->rings, 0, rings_size);
+	}
+
+	g_n_shards = n_shards;
+
+	shard_cpus_init();
+
+	cf_info(AS_TSVC, "shard transactions: %u shards, partition id modulo %u selects shard, %u-slot rings, %u cpus",
+			n_shards, n_shards, g_ring_size, g_n_shard_cpus);
+}
+
+
+// Called by each service thread - makes the calling thread the shard, and
+// returns the socket to add to its poll set for wakeups.
+cf_socket*
+as_tsvc_shard_attach(uint32_t shard_id)
+{
+	t_shard_id = (int32_t)shard_id;
+
+	if (g_n_shard_cpus != 0) {
+		uint32_t cpu = g_shard_cpus[shard_id % g_n_shard_cpus];
+		cpu_set_t cpus;
+
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+
+		if (0 != pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) {
+			cf_warning(AS_TSVC, "shard %u failed to pin to cpu %u", shard_id, cpu);
+		}
+	}
+
+	return &g_shards[shard_id].wake_sock;
+}
+
+
+// Called by a shard when its wakeup socket is readable.
+void
+as_tsvc_shard_clear_wake()
+{
+	uint64_t count;
+
+	// Non-blocking - may already be clear.
+	if (read(CSFD(&g_shards[t_shard_id].wake_sock), &count, sizeof(count)) < 0 &&
+			errno != EAGAIN) {
+		cf_warning(AS_TSVC, "shard %d eventfd read failed: %s", t_shard_id,
+				cf_strerror(errno));
+	}
+}
+
+
+// Called by a shard after each batch of poll events - runs the transactions
+// other shards have handed it.
+void
+as_tsvc_shard_drain()
+{
+	tsvc_shard* shard = &g_shards[t_shard_id];
+
+	for (uint32_t i = 0; i < g_n_shards; i++) {
+		shard_ring* ring = shard_ring_of(shard, i);
+		uint32_t head = ring->head;
+		uint32_t tail;
+
+		// Re-check after draining - pairs with the producer's check of head,
+		// so either we see its transaction or it sees it must wake us.
+		while (head != (tail = ck_pr_load_32(&ring->tail))) {
+			ck_pr_fence_load();
+
+			do {
+				as_transaction tr;
+
+				memcpy(&tr, ring->trs[head & (g_ring_size - 1)], AS_TRANSACTION_HEAD_SIZE);
+				ck_pr_fence_release();
+				ck_pr_store_32(&ring->head, ++head);
+
+				if (g_config.svc_benchmarks_enabled &&
+						tr.benchmark_time != 0 && ! as_transaction_is_restart(&tr)) {
+					histogram_insert_data_point(g_stats.svc_queue_hist, tr.benchmark_time);
+				}
+
+				process_transaction(&tr);
+			} while (head != tail);
+
+			ck_pr_fence_memory();
+		}
+	}
+}
+
+
+static bool
+shard_push(uint32_t owner, const as_transaction *tr)
+{
+	tsvc_shard* shard = &g_shards[owner];
+	shard_ring* ring = shard_ring_of(shard, (uint32_t)t_shard_id);
+	uint32_t tail = ring->tail;
+
+	if (tail - ck_pr_load_32(&ring->head) == g_ring_size) {
+		return false;
+	}
+
+	memcpy(ring->trs[tail & (g_ring_size - 1)], tr, AS_TRANSACTION_HEAD_SIZE);
+	ck_pr_fence_store();
+	ck_pr_store_32(&ring->tail, tail + 1);
+	ck_pr_fence_memory();
+
+	// If the owner is still behind our previous transaction, it's yet to
+	// re-check the ring and will find this one - otherwise wake it.
+	if (ck_pr_load_32(&ring->head) == tail) {
+		uint64_t one = 1;
+
+		if (write(CSFD(&shard->wake_sock), &one, sizeof(one)) < 0) {
+			cf_warning(AS_TSVC, "shard %u eventfd write failed: %s", owner,
+					cf_strerror(errno));
+		}
+	}
+
+	return true;
+}
+
+
+// In a shard thread, run transactions for the shard's partitions here, and
+// hand others to the owning shard.
+static int
+shard_process_or_forward(as_transaction *tr)
+{
+	// Multi-record transactions get their own threads - no need to route.
+	if (! as_transaction_has_digest(tr) && ! as_transaction_has_key(tr)) {
+		process_transaction(tr);
+		return 0;
+	}
+
+	proto_peek ppeek;
+	as_msg_peek(tr, &ppeek);
+
+	uint32_t owner = as_partition_getid(ppeek.keyd) % g_n_shards;
+
+	if (owner == (uint32_t)t_shard_id) {
+		process_transaction(tr);
+		return 0;
+	}
+
+	if (shard_push(owner, tr)) {
+		return 0;
+	}
+
+	// Owner is backed up - don't stall this shard waiting for it.
+	return thr_tsvc_enqueue(tr);
+}
+
+
 // Peek into packet and decide if transaction can be executed inline in
 // demarshal thread or if it must be enqueued, and handle appropriately.
 int
 thr_tsvc_process_or_enqueue(as_transaction *tr)
 {
+	if (t_shard_id >= 0) {
+		return shard_process_or_forward(tr);
+	}
+
 	// If transaction is for data-in-memory namespace, process in this thread.
 	if (g_config.allow_inline_transactions &&
 			g_config.n_namespaces_in_memory != 0 &&
@@ -560,13 +844,13 @@ thr_tsvc_enqueue(as_transaction *tr)
 		n_q = (g_current_q++) % g_config.n_transaction_queues;
 	}
 
-	cf_queue *q;
+	mpmc_queue *q;
 
 	if ((q = g_transaction_queues[n_q]) == NULL) {
 		cf_crash(AS_TSVC, "transaction queue #%d not initialized!", n_q);
 	}
 
-	if (cf_queue_push(q, tr) != 0) {
+	if (mpmc_queue_push(q, tr) != 0) {
 		cf_crash(AS_TSVC, "transaction queue push failed - out of memory?");
 	}
 
@@ -582,12 +866,21 @@ thr_tsvc_queue_get_size()
 
 	for (int i = 0; i < g_config.n_transaction_queues; i++) {
 		if (g_transaction_queues[i]) {
-			qs += cf_queue_sz(g_transaction_queues[i]);
+			qs += (int)mpmc_queue_sz(g_transaction_queues[i]);
 		}
 		else {
 			cf_detail(AS_TSVC, "no queue when getting size");
 		}
 	}
 
+	// Include transactions waiting in shard rings.
+	for (uint32_t i = 0; i < g_n_shards; i++) {
+		for (uint32_t j = 0; j < g_n_shards; j++) {
+			shard_ring* ring = shard_ring_of(&g_shards[i], j);
+
+			qs += (int)(ck_pr_load_32(&ring->tail) - ck_pr_load_32(&ring->head));
+		}
+	}
+
 	return qs;
 } // end thr_tsvc_queue_get_size()
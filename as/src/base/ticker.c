@@ -431,6 +431,24 @@ log_line_device_usage(as_namespace* ns)
 				available_pct,
 				ns->cache_read_pct
 				);
+
+		if (ns->storage_read_cache_size != 0) {
+			uint32_t n_read_cache_hits = ns->n_read_cache_hits;
+			uint32_t n_read_cache_lookups = ns->n_read_cache_misses +
+					n_read_cache_hits;
+
+			cf_atomic32_set(&ns->n_read_cache_hits, 0);
+			cf_atomic32_set(&ns->n_read_cache_misses, 0);
+
+			ns->read_cache_hit_pct =
+					(float)(100 * n_read_cache_hits) /
+					(float)(n_read_cache_lookups == 0 ? 1 : n_read_cache_lookups);
+
+			cf_info(AS_INFO, "{%s} read-cache: hit-pct %.2f",
+					ns->name,
+					ns->read_cache_hit_pct
+					);
+		}
 	}
 }
 
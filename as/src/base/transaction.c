@@ -334,7 +334,8 @@ as_transaction_init_iudf(as_transaction *tr, as_namespace *ns, cf_digest *keyd)
 void
 as_transaction_demarshal_error(as_transaction* tr, uint32_t error_code)
 {
-	as_msg_send_reply(tr->from.proto_fd_h, error_code, 0, 0, NULL, NULL, 0, NULL, 0, NULL);
+	// Fields are flagged only once parsed - until then, trid is 0.
+	as_msg_send_reply(tr->from.proto_fd_h, error_code, 0, 0, NULL, NULL, 0, NULL, as_transaction_trid(tr), NULL);
 	tr->from.proto_fd_h = NULL;
 
 	cf_free(tr->msgp);
@@ -471,6 +472,7 @@ as_release_file_handle(as_file_handle *proto_fd_h)
 		proto_fd_h->security_filter = NULL;
 	}
 
+	pthread_mutex_destroy(&proto_fd_h->send_lock);
 	cf_rc_free(proto_fd_h);
 	cf_atomic64_incr(&g_stats.proto_connections_closed);
 }
@@ -1176,6 +1176,7 @@ fabric_accept_fn(void *argv)
 	sc.addr = "0.0.0.0";     // inaddr any!
 	sc.port = g_config.fabric_port;
 	sc.reuse_addr = (g_config.socket_reuse_addr) ? true : false;
+	sc.reuse_port = false;
 	sc.type = SOCK_STREAM;
 	if (0 != cf_socket_init_server(&sc)) {
 		cf_crash(AS_FABRIC, "Could not create fabric listener socket - check configuration");
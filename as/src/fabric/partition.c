@@ -42,6 +42,7 @@
 #include "base/cfg.h"
 #include "base/cluster_config.h"
 #include "base/datamodel.h"
+#include "base/expire_index.h"
 #include "base/index.h"
 #include "base/ldt.h"
 #include "fabric/fabric.h"
@@ -292,7 +293,7 @@ as_partition_reinit(as_partition *p, as_namespace *ns, int pid)
 		}
 	}
 	else {
-		p->vp = as_index_tree_create(ns->arena,
+		p->vp = as_index_tree_create(ns->arena, ns->partition_tree_sprigs,
 				(as_index_value_destructor)&as_record_destroy, ns,
 				ns->tree_roots ? &ns->tree_roots[pid] : NULL);
 	}
@@ -321,7 +322,7 @@ as_partition_reinit(as_partition *p, as_namespace *ns, int pid)
 		}
 	}
 	else {
-		p->sub_vp = as_index_tree_create(ns->arena,
+		p->sub_vp = as_index_tree_create(ns->arena, 1,
 				(as_index_value_destructor)&as_record_destroy, ns,
 				ns->sub_tree_roots ? &ns->sub_tree_roots[pid] : NULL);
 	}
@@ -343,14 +344,14 @@ set_partition_desync_lockfree(as_partition *p, as_partition_vinfo *vinfo,
 
 	as_index_tree *t = p->vp;
 
-	p->vp = as_index_tree_create(ns->arena,
+	p->vp = as_index_tree_create(ns->arena, ns->partition_tree_sprigs,
 			(as_index_value_destructor)&as_record_destroy, ns,
 			ns->tree_roots ? &ns->tree_roots[pid] : NULL);
 	as_index_tree_release(t, ns);
 
 	as_index_tree *sub_t = p->sub_vp;
 
-	p->sub_vp = as_index_tree_create(ns->arena,
+	p->sub_vp = as_index_tree_create(ns->arena, 1,
 			(as_index_value_destructor)&as_record_destroy, ns,
 			ns->sub_tree_roots ? &ns->sub_tree_roots[pid] : NULL);
 	as_index_tree_release(sub_t, ns);
@@ -368,7 +369,7 @@ set_partition_absent_lockfree(as_partition *p, as_partition_vinfo *vinfo, as_nam
 {
 	as_index_tree *t = p->vp;
 
-	p->vp = as_index_tree_create(ns->arena, (as_index_value_destructor)&as_record_destroy, ns, ns->tree_roots ? &ns->tree_roots[pid] : NULL);
+	p->vp = as_index_tree_create(ns->arena, ns->partition_tree_sprigs, (as_index_value_destructor)&as_record_destroy, ns, ns->tree_roots ? &ns->tree_roots[pid] : NULL);
 	// A Change:  Set the State BEFORE the tree release, just in case that
 	// is opening too large of a time window.
 	p->state = AS_PARTITION_STATE_ABSENT; // Move the state setting ABOVE the tree release.
@@ -379,7 +380,7 @@ set_partition_absent_lockfree(as_partition *p, as_partition_vinfo *vinfo, as_nam
 
 	as_index_tree *sub_t = p->sub_vp;
 
-	p->sub_vp = as_index_tree_create(ns->arena, (as_index_value_destructor)&as_record_destroy, ns, ns->sub_tree_roots ? &ns->sub_tree_roots[pid] : NULL);
+	p->sub_vp = as_index_tree_create(ns->arena, 1, (as_index_value_destructor)&as_record_destroy, ns, ns->sub_tree_roots ? &ns->sub_tree_roots[pid] : NULL);
 
 	if (sub_t) {
 		as_index_tree_release(sub_t, ns);
@@ -427,6 +428,8 @@ as_partition_init(as_partition *p, as_namespace *ns, int pid)
 
 	p->vp = NULL;
 	p->sub_vp = NULL;
+	p->expire_index = ns->expiration_index ?
+			as_expire_index_create(as_record_void_time_get()) : NULL;
 	as_partition_reinit(p, ns, pid);
 }
 
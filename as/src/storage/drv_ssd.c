@@ -37,6 +37,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -47,6 +48,10 @@
 #include <linux/fs.h> // for BLKGETSIZE64
 #include <sys/ioctl.h>
 #include <sys/param.h> // for MAX()
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <zlib.h>
 
 #include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_atomic.h"
@@ -58,10 +63,12 @@
 #include "fault.h"
 #include "hist.h"
 #include "jem.h"
+#include "util.h"
 #include "vmapx.h"
 
 #include "base/datamodel.h"
 #include "base/cfg.h"
+#include "base/expire_index.h"
 #include "base/index.h"
 #include "base/ldt.h"
 #include "base/proto.h"
@@ -94,6 +101,7 @@ extern bool as_cold_start_evict_if_needed(as_namespace* ns);
 #define SSD_DEFAULT_INFO_LENGTH		(128)
 
 #define SSD_BLOCK_MAGIC		0x037AF200
+#define SSD_BLOCK_MAGIC_COMPRESSED	0x037AF201 // data[] is compressed
 #define LENGTH_BASE			offsetof(struct drv_ssd_block_s, keyd)
 
 #define DEFRAG_STARTUP_RESERVE	4
@@ -115,7 +123,7 @@ typedef struct {
 // Per-record metadata on device.
 //
 typedef struct drv_ssd_block_s {
-	cf_signature	sig;			// deprecated
+	cf_signature	sig;			// deprecated - if compressed, size of data[] before compression
 	uint32_t		magic;
 	uint32_t		length;			// total after this field - this struct's pointer + 16
 	cf_digest		keyd;
@@ -144,67 +152,204 @@ typedef struct drv_ssd_bin_s {
 // Miscellaneous utility functions.
 //
 
-// Get an open file descriptor from the pool, or a fresh one if necessary.
-int
-ssd_fd_get(drv_ssd *ssd)
+// Open the fd shared by all I/O on a device (or shadow). All I/O is positional
+// - pread()/pwrite() - so concurrent users don't interfere.
+static int
+ssd_fd_open(const char *name, int open_flag)
 {
-	int fd = -1;
-	int rv = cf_queue_pop(ssd->fd_q, (void*)&fd, CF_QUEUE_NOWAIT);
-
-	if (rv != CF_QUEUE_OK) {
-		fd = open(ssd->name, ssd->open_flag, S_IRUSR | S_IWUSR);
+	int fd = open(name, open_flag, S_IRUSR | S_IWUSR);
 
-		if (-1 == fd) {
-			cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED open: errno %d (%s)",
-					ssd->name, errno, cf_strerror(errno));
-		}
+	if (-1 == fd) {
+		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED open: errno %d (%s)",
+				name, errno, cf_strerror(errno));
 	}
 
 	return fd;
 }
 
 
-int
-ssd_shadow_fd_get(drv_ssd *ssd)
+// Decide which device a record belongs on.
+static inline int
+ssd_get_file_id(drv_ssds *ssds, cf_digest *keyd)
 {
-	int fd = -1;
-	int rv = cf_queue_pop(ssd->shadow_fd_q, (void*)&fd, CF_QUEUE_NOWAIT);
+	return keyd->digest[DIGEST_STORAGE_BYTE] % ssds->n_ssds;
+}
 
-	if (rv != CF_QUEUE_OK) {
-		fd = open(ssd->shadow_name, ssd->open_flag, S_IRUSR | S_IWUSR);
 
-		if (-1 == fd) {
-			cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED open: errno %d (%s)",
-					ssd->shadow_name, errno, cf_strerror(errno));
-		}
+static inline bool
+ssd_block_magic_ok(const drv_ssd_block *block)
+{
+	return block->magic == SSD_BLOCK_MAGIC ||
+			block->magic == SSD_BLOCK_MAGIC_COMPRESSED;
+}
+
+
+// Returns an allocated, uncompressed copy of a compressed block, or null if the
+// block can't be decompressed.
+static drv_ssd_block*
+ssd_block_decompress(const drv_ssd_block *block, const char *ssd_name)
+{
+	uint32_t data_sz = block->sig;
+	uint64_t block_sz = (uint64_t)block->length + LENGTH_BASE;
+
+	if (data_sz == 0 || data_sz > MAX_WRITE_BLOCK_SIZE ||
+			block_sz < sizeof(drv_ssd_block) ||
+			block_sz > MAX_WRITE_BLOCK_SIZE) {
+		cf_warning(AS_DRV_SSD, "%s: bad compressed block: size %lu data size %u",
+				ssd_name, block_sz, data_sz);
+		return NULL;
 	}
 
-	return fd;
+	drv_ssd_block *dblock = cf_malloc(sizeof(drv_ssd_block) + data_sz);
+
+	if (! dblock) {
+		return NULL;
+	}
+
+	memcpy(dblock, block, sizeof(drv_ssd_block));
+
+	uLongf out_sz = data_sz;
+	int rv = uncompress(dblock->data, &out_sz, block->data,
+			(uLong)(block_sz - sizeof(drv_ssd_block)));
+
+	if (rv != Z_OK || out_sz != data_sz) {
+		cf_warning(AS_DRV_SSD, "%s: failed decompressing block: rv %d size %lu data size %u",
+				ssd_name, rv, (uint64_t)out_sz, data_sz);
+		cf_free(dblock);
+		return NULL;
+	}
+
+	dblock->sig = 0;
+	dblock->magic = SSD_BLOCK_MAGIC;
+	dblock->length = (uint32_t)(sizeof(drv_ssd_block) + data_sz - LENGTH_BASE);
+
+	return dblock;
 }
 
 
-// Save an open file descriptor in the pool
-static inline void
-ssd_fd_put(drv_ssd *ssd, int fd)
+//------------------------------------------------
+// ssd_defrag_q class.
+//
+
+static ssd_defrag_q*
+defrag_q_create(uint32_t write_block_size)
 {
-	cf_queue_push(ssd->fd_q, (void*)&fd);
+	ssd_defrag_q *q = cf_malloc(sizeof(ssd_defrag_q));
+
+	if (! q) {
+		return NULL;
+	}
+
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+	q->write_block_size = write_block_size;
+	q->n_wblocks = 0;
+	q->min_bucket = SSD_DEFRAG_Q_N_BUCKETS;
+	q->n_pops = 0;
+	q->fair_bucket = 0;
+
+	for (uint32_t b = 0; b < SSD_DEFRAG_Q_N_BUCKETS; b++) {
+		// Not thread safe - protected by q->lock.
+		if (! (q->buckets[b] = cf_queue_create(sizeof(uint32_t), false))) {
+			cf_free(q);
+			return NULL;
+		}
+	}
+
+	return q;
 }
 
+static inline uint32_t
+defrag_q_bucket(ssd_defrag_q *q, uint32_t inuse_sz)
+{
+	uint32_t b = (uint32_t)(((uint64_t)inuse_sz * SSD_DEFRAG_Q_N_BUCKETS) /
+			q->write_block_size);
 
-static inline void
-ssd_shadow_fd_put(drv_ssd *ssd, int fd)
+	return b < SSD_DEFRAG_Q_N_BUCKETS ? b : SSD_DEFRAG_Q_N_BUCKETS - 1;
+}
+
+static void
+defrag_q_push(ssd_defrag_q *q, uint32_t wblock_id, uint32_t inuse_sz,
+		bool to_head)
 {
-	cf_queue_push(ssd->shadow_fd_q, (void*)&fd);
+	uint32_t b = defrag_q_bucket(q, inuse_sz);
+
+	pthread_mutex_lock(&q->lock);
+
+	if (to_head) {
+		cf_queue_push_head(q->buckets[b], &wblock_id);
+	}
+	else {
+		cf_queue_push(q->buckets[b], &wblock_id);
+	}
+
+	if (b < q->min_bucket) {
+		q->min_bucket = b;
+	}
+
+	if (q->n_wblocks++ == 0) {
+		pthread_cond_signal(&q->cond);
+	}
+
+	pthread_mutex_unlock(&q->lock);
 }
 
+// Pops from the emptiest bucket. Wblocks may have emptied further while queued,
+// but never filled - the bucket order is still good. Every so often pops from
+// the next bucket in turn instead, so a steady supply of emptier wblocks can't
+// leave fuller ones queued forever.
+static bool
+defrag_q_pop(ssd_defrag_q *q, uint32_t *p_wblock_id, bool wait)
+{
+	pthread_mutex_lock(&q->lock);
 
-// Decide which device a record belongs on.
-static inline int
-ssd_get_file_id(drv_ssds *ssds, cf_digest *keyd)
+	while (q->n_wblocks == 0) {
+		if (! wait) {
+			pthread_mutex_unlock(&q->lock);
+			return false;
+		}
+
+		pthread_cond_wait(&q->cond, &q->lock);
+	}
+
+	if (++q->n_pops % SSD_DEFRAG_Q_FAIR_INTERVAL == 0) {
+		uint32_t b = q->fair_bucket < q->min_bucket ?
+				q->min_bucket : q->fair_bucket;
+
+		// There's at least one wblock at or above min_bucket.
+		while (cf_queue_pop(q->buckets[b], p_wblock_id, CF_QUEUE_NOWAIT) !=
+				CF_QUEUE_OK) {
+			if (++b == SSD_DEFRAG_Q_N_BUCKETS) {
+				b = q->min_bucket;
+			}
+		}
+
+		q->fair_bucket = b + 1 < SSD_DEFRAG_Q_N_BUCKETS ? b + 1 : 0;
+	}
+	else {
+		while (cf_queue_pop(q->buckets[q->min_bucket], p_wblock_id,
+				CF_QUEUE_NOWAIT) != CF_QUEUE_OK) {
+			q->min_bucket++;
+		}
+	}
+
+	q->n_wblocks--;
+
+	pthread_mutex_unlock(&q->lock);
+
+	return true;
+}
+
+static inline uint32_t
+defrag_q_sz(ssd_defrag_q *q)
 {
-	return keyd->digest[DIGEST_STORAGE_BYTE] % ssds->n_ssds;
+	return q->n_wblocks; // not under lock - just a stat
 }
 
+//
+// END - ssd_defrag_q class.
+//------------------------------------------------
+
 
 // Put a wblock on the free queue for reuse.
 void
@@ -235,8 +380,12 @@ static inline void
 push_wblock_to_defrag_q(drv_ssd *ssd, uint32_t wblock_id)
 {
 	if (ssd->defrag_wblock_q) { // null until devices are loaded at startup
-		ssd->alloc_table->wblock_state[wblock_id].state = WBLOCK_STATE_DEFRAG;
-		cf_queue_push(ssd->defrag_wblock_q, &wblock_id);
+		ssd_wblock_state *p_wblock_state =
+				&ssd->alloc_table->wblock_state[wblock_id];
+
+		p_wblock_state->state = WBLOCK_STATE_DEFRAG;
+		defrag_q_push(ssd->defrag_wblock_q, wblock_id,
+				cf_atomic32_get(p_wblock_state->inuse_sz), false);
 		cf_atomic_int_incr(&ssd->n_defrag_wblock_reads);
 	}
 }
@@ -444,6 +593,11 @@ ssd_block_free(drv_ssd *ssd, uint64_t rblock_id, uint64_t n_rblocks, char *msg)
 
 	cf_atomic64_sub(&ssd->inuse_size, size);
 
+	// These rblocks may soon hold another record.
+	if (ssd->read_cache) {
+		ssd_read_cache_remove(ssd->read_cache, rblock_id);
+	}
+
 	ssd_wblock_state *p_wblock_state = &at->wblock_state[wblock_id];
 
 	pthread_mutex_lock(&p_wblock_state->LOCK);
@@ -704,7 +858,8 @@ ssd_is_full(drv_ssd *ssd, uint32_t wblock_id)
 
 	// Not using push_wblock_to_defrag_q() - state is already DEFRAG, we
 	// definitely have a queue, and it's better to push back to head.
-	cf_queue_push_head(ssd->defrag_wblock_q, &wblock_id);
+	defrag_q_push(ssd->defrag_wblock_q, wblock_id,
+			cf_atomic32_get(p_wblock_state->inuse_sz), true);
 
 	pthread_mutex_unlock(&p_wblock_state->LOCK);
 
@@ -717,8 +872,10 @@ ssd_is_full(drv_ssd *ssd, uint32_t wblock_id)
 }
 
 
+// If the wblock is read, *p_read_ns is set to how long that took.
 int
-ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
+ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf,
+		uint64_t *p_read_ns)
 {
 	if (ssd_is_full(ssd, wblock_id)) {
 		return 0;
@@ -734,42 +891,33 @@ ssd_defrag_wblock(drv_ssd *ssd, uint32_t wblock_id, uint8_t *read_buf)
 		goto Finished;
 	}
 
-	int fd = ssd_fd_get(ssd);
 	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
 
-	uint64_t start_ns = ssd->ns->storage_benchmarks_enabled ? cf_getns() : 0;
-
-	if (lseek(fd, (off_t)file_offset, SEEK_SET) != (off_t)file_offset) {
-		cf_warning(AS_DRV_SSD, "%s: seek failed: offset %lu: errno %d (%s)",
-				ssd->name, file_offset, errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
-		goto Finished;
-	}
+	// Always timed - defrag paces itself by it.
+	uint64_t start_ns = cf_getns();
 
-	ssize_t rlen = read(fd, read_buf, ssd->write_block_size);
+	ssize_t rlen = pread(ssd->fd, read_buf, ssd->write_block_size,
+			(off_t)file_offset);
 
 	if (rlen != (ssize_t)ssd->write_block_size) {
-		cf_warning(AS_DRV_SSD, "%s: read failed (%ld): errno %d (%s)",
-				ssd->name, rlen, errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
+		cf_warning(AS_DRV_SSD, "%s: read failed (%ld): offset %lu: errno %d (%s)",
+				ssd->name, rlen, file_offset, errno, cf_strerror(errno));
 		goto Finished;
 	}
 
-	if (start_ns != 0) {
+	*p_read_ns = cf_getns() - start_ns;
+
+	if (ssd->ns->storage_benchmarks_enabled) {
 		histogram_insert_data_point(ssd->hist_large_block_read, start_ns);
 	}
 
-	ssd_fd_put(ssd, fd);
-
 	size_t wblock_offset = 0; // current offset within the wblock, in bytes
 
 	while (wblock_offset < ssd->write_block_size &&
 			cf_atomic32_get(p_wblock_state->inuse_sz) != 0) {
 		drv_ssd_block *block = (drv_ssd_block*)&read_buf[wblock_offset];
 
-		if (block->magic != SSD_BLOCK_MAGIC) {
+		if (! ssd_block_magic_ok(block)) {
 			// First block must have magic.
 			if (wblock_offset == 0) {
 				cf_warning(AS_DRV_SSD, "BLOCK CORRUPTED: device %s has bad data on wblock %d",
@@ -849,6 +997,74 @@ Finished:
 }
 
 
+// Most defrag may back off (multiple of defrag-sleep) when devices are busy.
+#define DEFRAG_MAX_BACKOFF 16
+
+// Tracks wblock read latency, as a measure of how busy the device is.
+typedef struct defrag_pacer_s {
+	uint64_t	avg_ns;		// smoothed recent wblock read time
+	uint64_t	floor_ns;	// best recent wblock read time - "idle" device
+} defrag_pacer;
+
+
+// How long to sleep after defragging a wblock. With defrag-adaptive, this is
+// defrag-sleep scaled down when free wblocks run short, and up when the device
+// is loaded - reads slower than its floor, or a write queue backing up.
+static uint32_t
+defrag_pace(drv_ssd *ssd, defrag_pacer *pacer, uint64_t read_ns)
+{
+	as_namespace *ns = ssd->ns;
+	uint32_t sleep_us = ns->storage_defrag_sleep;
+
+	if (read_ns != 0) {
+		pacer->avg_ns = pacer->avg_ns == 0 ?
+				read_ns : (pacer->avg_ns * 7 + read_ns) / 8;
+
+		// Drift up slowly, in case the device got slower for good.
+		if (pacer->floor_ns == 0 || read_ns < pacer->floor_ns) {
+			pacer->floor_ns = read_ns;
+		}
+		else {
+			pacer->floor_ns += (read_ns - pacer->floor_ns) / 1024;
+		}
+	}
+
+	if (! ns->storage_defrag_adaptive || sleep_us == 0) {
+		return sleep_us;
+	}
+
+	uint32_t free_pct = (uint32_t)(((uint64_t)cf_queue_sz(ssd->free_wblock_q) *
+			100) / ssd->alloc_table->n_wblocks);
+
+	// Close to stop-writes - defrag flat out.
+	if (free_pct < ns->storage_min_avail_pct * 2) {
+		return 0;
+	}
+
+	// Getting short - defrag at twice the usual pace, whatever the load.
+	if (free_pct < ns->storage_min_avail_pct * 4) {
+		return sleep_us / 2;
+	}
+
+	uint32_t backoff = 1;
+
+	if (pacer->floor_ns != 0 && pacer->avg_ns > pacer->floor_ns) {
+		backoff += (uint32_t)(pacer->avg_ns / pacer->floor_ns) - 1;
+	}
+
+	if (ns->storage_max_write_q > 0) {
+		backoff += (uint32_t)((cf_queue_sz(ssd->swb_write_q) * 4) /
+				ns->storage_max_write_q);
+	}
+
+	if (backoff > DEFRAG_MAX_BACKOFF) {
+		backoff = DEFRAG_MAX_BACKOFF;
+	}
+
+	return sleep_us * backoff;
+}
+
+
 // Thread "run" function to service a device's defrag queue.
 void*
 run_defrag(void *pv_data)
@@ -861,14 +1077,14 @@ run_defrag(void *pv_data)
 		cf_crash(AS_DRV_SSD, "device %s: defrag valloc failed", ssd->name);
 	}
 
+	defrag_pacer pacer = { 0, 0 };
+
 	while (true) {
 		uint32_t q_min = ssd->ns->storage_defrag_queue_min;
 
 		if (q_min != 0) {
-			if (cf_queue_sz(ssd->defrag_wblock_q) > q_min) {
-				if (CF_QUEUE_OK !=
-						cf_queue_pop(ssd->defrag_wblock_q, &wblock_id,
-								CF_QUEUE_NOWAIT)) {
+			if (defrag_q_sz(ssd->defrag_wblock_q) > q_min) {
+				if (! defrag_q_pop(ssd->defrag_wblock_q, &wblock_id, false)) {
 					// Should never get here!
 					break;
 				}
@@ -879,17 +1095,17 @@ run_defrag(void *pv_data)
 			}
 		}
 		else {
-			if (CF_QUEUE_OK !=
-					cf_queue_pop(ssd->defrag_wblock_q, &wblock_id,
-							CF_QUEUE_FOREVER)) {
+			if (! defrag_q_pop(ssd->defrag_wblock_q, &wblock_id, true)) {
 				// Should never get here!
 				break;
 			}
 		}
 
-		ssd_defrag_wblock(ssd, wblock_id, read_buf);
+		uint64_t read_ns = 0;
 
-		uint32_t sleep_us = ssd->ns->storage_defrag_sleep;
+		ssd_defrag_wblock(ssd, wblock_id, read_buf, &read_ns);
+
+		uint32_t sleep_us = defrag_pace(ssd, &pacer, read_ns);
 
 		if (sleep_us != 0) {
 			usleep(sleep_us);
@@ -973,9 +1189,12 @@ defrag_pen_transfer(defrag_pen *pen, drv_ssd *ssd)
 	// For speed, "customize" instead of using push_wblock_to_defrag_q()...
 	for (uint32_t i = 0; i < pen->n_ids; i++) {
 		uint32_t wblock_id = pen->ids[i];
+		ssd_wblock_state *p_wblock_state =
+				&ssd->alloc_table->wblock_state[wblock_id];
 
-		ssd->alloc_table->wblock_state[wblock_id].state = WBLOCK_STATE_DEFRAG;
-		cf_queue_push(ssd->defrag_wblock_q, &wblock_id);
+		p_wblock_state->state = WBLOCK_STATE_DEFRAG;
+		defrag_q_push(ssd->defrag_wblock_q, wblock_id,
+				p_wblock_state->inuse_sz, false);
 	}
 }
 
@@ -1011,7 +1230,7 @@ run_load_queues(void *pv_data)
 		cf_crash(AS_DRV_SSD, "%s free wblock queue create failed", ssd->name);
 	}
 
-	if (! (ssd->defrag_wblock_q = cf_queue_create(sizeof(uint32_t), true))) {
+	if (! (ssd->defrag_wblock_q = defrag_q_create(ssd->write_block_size))) {
 		cf_crash(AS_DRV_SSD, "%s defrag queue create failed", ssd->name);
 	}
 
@@ -1047,7 +1266,7 @@ run_load_queues(void *pv_data)
 		defrag_pen_destroy(&pens[n]);
 	}
 
-	ssd->n_defrag_wblock_reads = (uint64_t)cf_queue_sz(ssd->defrag_wblock_q);
+	ssd->n_defrag_wblock_reads = (uint64_t)defrag_q_sz(ssd->defrag_wblock_q);
 
 	return NULL;
 }
@@ -1080,7 +1299,7 @@ ssd_load_wblock_queues(drv_ssds *ssds)
 
 		cf_info(AS_DRV_SSD, "%s init wblock free-q %d, defrag-q %d", ssd->name,
 				cf_queue_sz(ssd->free_wblock_q),
-				cf_queue_sz(ssd->defrag_wblock_q));
+				defrag_q_sz(ssd->defrag_wblock_q));
 	}
 }
 
@@ -1109,6 +1328,195 @@ ssd_wblock_init(drv_ssd *ssd)
 }
 
 
+//==========================================================
+// Wblock map - which wblocks are in use, kept in shared
+// memory across a clean shutdown so the next cold start
+// need not read free wblocks.
+//
+
+#define WBLOCK_MAP_MAGIC	0x4145574D41503032 // "AEWMAP02"
+#define WBLOCK_MAP_SHM_BASE	0xAE570000
+
+typedef struct ssd_wblock_map_s {
+	uint64_t	magic;
+	uint64_t	random;				// device header random when saved
+	uint64_t	device_id;			// which device it was saved from
+	uint32_t	write_block_size;
+	uint32_t	n_wblocks;
+	uint8_t		in_use[];			// bitmap
+} ssd_wblock_map;
+
+
+static inline key_t
+ssd_wblock_map_key(drv_ssd *ssd)
+{
+	return (key_t)(WBLOCK_MAP_SHM_BASE | ((ssd->ns->id & 0xFF) << 8) |
+			(ssd->file_id & 0xFF));
+}
+
+
+// Identifies the device a map belongs to - the configured path, and whatever
+// device (or file) is at that path now. The device header can't do this - it's
+// the same on all of a namespace's devices. Returns 0 if unknown.
+static uint64_t
+ssd_wblock_map_device_id(drv_ssd *ssd)
+{
+	struct stat st;
+
+	if (stat(ssd->name, &st) != 0) {
+		return 0;
+	}
+
+	uint64_t id = S_ISBLK(st.st_mode) ?
+			(uint64_t)st.st_rdev : ((uint64_t)st.st_dev << 32) ^ st.st_ino;
+
+	id ^= cf_hash_fnv(ssd->name, strlen(ssd->name));
+
+	return id != 0 ? id : 1;
+}
+
+
+static inline size_t
+ssd_wblock_map_size(uint32_t n_wblocks)
+{
+	return sizeof(ssd_wblock_map) + ((n_wblocks + 7) / 8);
+}
+
+
+// Remove any saved map, so it can't outlive the state it describes.
+static void
+ssd_wblock_map_remove(drv_ssd *ssd)
+{
+	int shmid = shmget(ssd_wblock_map_key(ssd), 0, 0);
+
+	if (shmid != -1) {
+		shmctl(shmid, IPC_RMID, NULL);
+	}
+}
+
+
+// Called at clean shutdown, once all writes are flushed. Failure only costs
+// the next cold start a full device read.
+static void
+ssd_wblock_map_save(drv_ssd *ssd, uint64_t random)
+{
+	ssd_wblock_map_remove(ssd);
+
+	uint64_t device_id = ssd_wblock_map_device_id(ssd);
+
+	if (device_id == 0) {
+		cf_warning(AS_DRV_SSD, "%s: can't identify device for wblock map",
+				ssd->name);
+		return;
+	}
+
+	ssd_alloc_table *at = ssd->alloc_table;
+	size_t size = ssd_wblock_map_size(at->n_wblocks);
+	int shmid = shmget(ssd_wblock_map_key(ssd), size,
+			IPC_CREAT | IPC_EXCL | 0600);
+
+	if (shmid == -1) {
+		cf_warning(AS_DRV_SSD, "%s: can't create wblock map: errno %d (%s)",
+				ssd->name, errno, cf_strerror(errno));
+		return;
+	}
+
+	ssd_wblock_map *map = (ssd_wblock_map*)shmat(shmid, NULL, 0);
+
+	if (map == (void*)-1) {
+		cf_warning(AS_DRV_SSD, "%s: can't attach wblock map: errno %d (%s)",
+				ssd->name, errno, cf_strerror(errno));
+		shmctl(shmid, IPC_RMID, NULL);
+		return;
+	}
+
+	memset(map->in_use, 0, (at->n_wblocks + 7) / 8);
+
+	for (uint32_t i = 0; i < at->n_wblocks; i++) {
+		if (cf_atomic32_get(at->wblock_state[i].inuse_sz) != 0) {
+			map->in_use[i >> 3] |= (uint8_t)(1 << (i & 7));
+		}
+	}
+
+	map->random = random;
+	map->device_id = device_id;
+	map->write_block_size = ssd->write_block_size;
+	map->n_wblocks = at->n_wblocks;
+	map->magic = WBLOCK_MAP_MAGIC; // last - marks map complete
+
+	shmdt(map);
+}
+
+
+// Called at startup, with the random from the device header before it's
+// renewed. The saved map is consumed either way. If it was saved from another
+// device - e.g. devices were reordered in the config - it's ignored and the
+// device is fully read.
+static void
+ssd_wblock_map_load(drv_ssd *ssd, uint64_t random)
+{
+	int shmid = shmget(ssd_wblock_map_key(ssd), 0, 0);
+
+	if (shmid == -1) {
+		return;
+	}
+
+	ssd_wblock_map *map = (ssd_wblock_map*)shmat(shmid, NULL, SHM_RDONLY);
+
+	if (map == (void*)-1) {
+		shmctl(shmid, IPC_RMID, NULL);
+		return;
+	}
+
+	ssd_alloc_table *at = ssd->alloc_table;
+	struct shmid_ds ds;
+
+	if (shmctl(shmid, IPC_STAT, &ds) == 0 &&
+			ds.shm_segsz >= ssd_wblock_map_size(at->n_wblocks) &&
+			map->magic == WBLOCK_MAP_MAGIC && map->random == random &&
+			map->device_id == ssd_wblock_map_device_id(ssd) &&
+			map->write_block_size == ssd->write_block_size &&
+			map->n_wblocks == at->n_wblocks) {
+		size_t map_size = (at->n_wblocks + 7) / 8;
+
+		if ((ssd->load_wblock_map = cf_malloc(map_size)) != NULL) {
+			memcpy(ssd->load_wblock_map, map->in_use, map_size);
+			cf_info(AS_DRV_SSD, "%s: loaded wblock map from last clean shutdown",
+					ssd->name);
+		}
+	}
+	else {
+		cf_info(AS_DRV_SSD, "%s: ignoring stale wblock map", ssd->name);
+	}
+
+	shmdt(map);
+	shmctl(shmid, IPC_RMID, NULL);
+}
+
+
+// True if no wblock in the load buffer at file_offset was in use at the last
+// clean shutdown.
+static bool
+ssd_wblock_map_can_skip(drv_ssd *ssd, off_t file_offset, size_t size)
+{
+	if (! ssd->load_wblock_map) {
+		return false;
+	}
+
+	uint32_t first_id = BYTES_TO_WBLOCK_ID(ssd, file_offset);
+	uint32_t end_id = BYTES_TO_WBLOCK_ID(ssd, file_offset + size);
+
+	for (uint32_t i = first_id; i < end_id; i++) {
+		if (i >= ssd->alloc_table->n_wblocks ||
+				(ssd->load_wblock_map[i >> 3] & (1 << (i & 7))) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
 //==========================================================
 // Storage API implementation: reading records.
 //
@@ -1159,6 +1567,14 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 		memcpy(read_buf, swb->buf + swb_offset, record_size);
 		swb_release(swb);
 	}
+	else if (ssd->read_cache && (read_buf = ssd_read_cache_get(ssd->read_cache,
+			r->storage_key.ssd.rblock_id, (uint32_t)record_size)) != NULL) {
+		// Data is in read cache.
+		cf_atomic32_incr(&rd->ns->n_reads_from_cache);
+		cf_atomic32_incr(&rd->ns->n_read_cache_hits);
+
+		block = (drv_ssd_block*)read_buf;
+	}
 	else {
 		// Normal case - data is read from device.
 		cf_atomic32_incr(&rd->ns->n_reads_from_device);
@@ -1175,25 +1591,15 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 			return -1;
 		}
 
-		int fd = ssd_fd_get(ssd);
-
 		uint64_t start_ns = rd->ns->storage_benchmarks_enabled ? cf_getns() : 0;
 
-		if (lseek(fd, (off_t)read_offset, SEEK_SET) != (off_t)read_offset) {
-			cf_warning(AS_DRV_SSD, "%s: seek failed: offset %lu: errno %d (%s)",
-					ssd->name, read_offset, errno, cf_strerror(errno));
-			cf_free(read_buf);
-			close(fd);
-			return -1;
-		}
-
-		ssize_t rv = read(fd, read_buf, read_size);
+		ssize_t rv = pread(ssd->fd, read_buf, read_size, (off_t)read_offset);
 
 		if (rv != (ssize_t)read_size) {
-			cf_warning(AS_DRV_SSD, "%s: read failed (%ld): size %lu: errno %d (%s)",
-					ssd->name, rv, read_size, errno, cf_strerror(errno));
+			cf_warning(AS_DRV_SSD, "%s: read failed (%ld): size %lu offset %lu: errno %d (%s)",
+					ssd->name, rv, read_size, read_offset, errno,
+					cf_strerror(errno));
 			cf_free(read_buf);
-			close(fd);
 			return -1;
 		}
 
@@ -1201,12 +1607,10 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 			histogram_insert_data_point(ssd->hist_read, start_ns);
 		}
 
-		ssd_fd_put(ssd, fd);
-
 		block = (drv_ssd_block*)(read_buf + record_buf_indent);
 
 		// Sanity checks.
-		if (block->magic != SSD_BLOCK_MAGIC) {
+		if (! ssd_block_magic_ok(block)) {
 			cf_warning(AS_DRV_SSD, "read: bad block magic offset %"PRIu64,
 					read_offset);
 			cf_free(read_buf);
@@ -1218,6 +1622,24 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 			cf_free(read_buf);
 			return -1;
 		}
+
+		if (ssd->read_cache) {
+			cf_atomic32_incr(&rd->ns->n_read_cache_misses);
+			ssd_read_cache_put(ssd->read_cache, r->storage_key.ssd.rblock_id,
+					(const uint8_t*)block, (uint32_t)record_size);
+		}
+	}
+
+	// Blocks are cached (and written) compressed - decompress as the last step.
+	if (block->magic == SSD_BLOCK_MAGIC_COMPRESSED) {
+		block = ssd_block_decompress(block, ssd->name);
+		cf_free(read_buf);
+
+		if (! block) {
+			return -1;
+		}
+
+		read_buf = (uint8_t*)block;
 	}
 
 	rd->u.ssd.block = block;
@@ -1228,12 +1650,461 @@ as_storage_record_read_ssd(as_storage_rd *rd)
 }
 
 
-int
-as_storage_particle_read_all_ssd(as_storage_rd *rd)
-{
-	// If the record hasn't been read, read it.
-	if (rd->u.ssd.block == 0) {
-		if (0 != as_storage_record_read_ssd(rd)) {
+//==========================================================
+// Storage API implementation: async reads.
+//
+
+// Kernel (native) AIO - glibc has no wrappers, so go via syscall().
+
+#define SSD_AIO_MAX_EVENTS 64
+
+typedef struct ssd_aio_read_s {
+	struct iocb				iocb;
+	drv_ssd					*ssd;
+	uint64_t				start_ns;
+	as_storage_prefetch		*pf;
+	as_storage_read_done_fn	cb;
+	void					*udata;
+} ssd_aio_read;
+
+// Async reads started by a thread while plugged, not yet submitted.
+typedef struct ssd_aio_plug_s {
+	bool			plugged;
+	uint32_t		n_reqs;
+	ssd_aio_read	*reqs[AS_STORAGE_MAX_PLUGGED_READS];
+} ssd_aio_plug;
+
+static __thread ssd_aio_plug g_aio_plug;
+
+
+static inline int
+ssd_io_setup(uint32_t n_events, aio_context_t *ctx)
+{
+	return (int)syscall(__NR_io_setup, n_events, ctx);
+}
+
+
+static inline int
+ssd_io_submit(aio_context_t ctx, long n, struct iocb **iocbs)
+{
+	return (int)syscall(__NR_io_submit, ctx, n, iocbs);
+}
+
+
+static inline int
+ssd_io_destroy(aio_context_t ctx)
+{
+	return (int)syscall(__NR_io_destroy, ctx);
+}
+
+
+static inline int
+ssd_io_getevents(aio_context_t ctx, long min_n, long max_n,
+		struct io_event *events)
+{
+	return (int)syscall(__NR_io_getevents, ctx, min_n, max_n, events, NULL);
+}
+
+
+// Data in a write buffer or the read cache is a memcpy away. (Racing with an swb
+// being attached is harmless - it means the record moved.)
+static inline bool
+ssd_record_is_cached(drv_ssd *ssd, uint64_t rblock_id)
+{
+	uint32_t wblock = RBLOCK_ID_TO_WBLOCK_ID(ssd, rblock_id);
+
+	return ssd->alloc_table->wblock_state[wblock].swb ||
+			(ssd->read_cache && ssd_read_cache_has(ssd->read_cache, rblock_id));
+}
+
+
+bool
+as_storage_record_is_cached_ssd(as_storage_rd *rd)
+{
+	as_record *r = rd->r;
+
+	return rd->have_device_block ||
+			STORAGE_RBLOCK_IS_INVALID(r->storage_key.ssd.rblock_id) ||
+			ssd_record_is_cached(rd->u.ssd.ssd, r->storage_key.ssd.rblock_id);
+}
+
+
+// Returns false if the caller must read the record synchronously.
+bool
+as_storage_record_read_async_ssd(as_storage_rd *rd, as_storage_read_done_fn cb,
+		void *udata)
+{
+	as_record *r = rd->r;
+	drv_ssd *ssd = rd->u.ssd.ssd;
+
+	if (ssd->aio_ctx == 0 || rd->have_device_block ||
+			STORAGE_RBLOCK_IS_INVALID(r->storage_key.ssd.rblock_id)) {
+		return false;
+	}
+
+	// Not worth going async - if the record moves, the prefetch won't be
+	// adopted.
+	if (ssd_record_is_cached(ssd, r->storage_key.ssd.rblock_id)) {
+		return false;
+	}
+
+	if (g_aio_plug.plugged &&
+			g_aio_plug.n_reqs == AS_STORAGE_MAX_PLUGGED_READS) {
+		return false;
+	}
+
+	// Beyond the configured depth, fall back to synchronous reads.
+	if (cf_atomic32_incr(&ssd->n_aio_reads) >
+			(int32_t)rd->ns->storage_async_read_depth) {
+		cf_atomic32_decr(&ssd->n_aio_reads);
+		return false;
+	}
+
+	uint64_t record_offset = RBLOCKS_TO_BYTES(r->storage_key.ssd.rblock_id);
+	uint64_t record_end_offset = record_offset +
+			RBLOCKS_TO_BYTES(r->storage_key.ssd.n_rblocks);
+	uint64_t read_offset = BYTES_DOWN_TO_IO_MIN(ssd, record_offset);
+	uint64_t read_end_offset = BYTES_UP_TO_IO_MIN(ssd, record_end_offset);
+	size_t read_size = read_end_offset - read_offset;
+
+	ssd_aio_read *req = cf_malloc(sizeof(ssd_aio_read));
+	as_storage_prefetch *pf = cf_malloc(sizeof(as_storage_prefetch));
+	uint8_t *read_buf = cf_valloc(read_size);
+
+	if (! req || ! pf || ! read_buf) {
+		if (req) {
+			cf_free(req);
+		}
+
+		if (pf) {
+			cf_free(pf);
+		}
+
+		if (read_buf) {
+			cf_free(read_buf);
+		}
+
+		cf_atomic32_decr(&ssd->n_aio_reads);
+		return false;
+	}
+
+	pf->file_id = r->storage_key.ssd.file_id;
+	pf->rblock_id = r->storage_key.ssd.rblock_id;
+	pf->n_rblocks = r->storage_key.ssd.n_rblocks;
+	pf->buf = read_buf;
+	pf->block = (drv_ssd_block*)(read_buf + (record_offset - read_offset));
+
+	memset(&req->iocb, 0, sizeof(req->iocb));
+	req->iocb.aio_data = (uint64_t)req;
+	req->iocb.aio_lio_opcode = IOCB_CMD_PREAD;
+	req->iocb.aio_fildes = (uint32_t)ssd->fd;
+	req->iocb.aio_buf = (uint64_t)read_buf;
+	req->iocb.aio_nbytes = read_size;
+	req->iocb.aio_offset = (int64_t)read_offset;
+
+	req->ssd = ssd;
+	req->start_ns = rd->ns->storage_benchmarks_enabled ? cf_getns() : 0;
+	req->pf = pf;
+	req->cb = cb;
+	req->udata = udata;
+
+	cf_atomic32_incr(&rd->ns->n_reads_from_device);
+
+	if (g_aio_plug.plugged) {
+		g_aio_plug.reqs[g_aio_plug.n_reqs++] = req;
+		return true;
+	}
+
+	struct iocb *iocbs[1] = { &req->iocb };
+
+	if (ssd_io_submit(ssd->aio_ctx, 1, iocbs) != 1) {
+		cf_warning(AS_DRV_SSD, "%s: async read submit failed: errno %d (%s)",
+				ssd->name, errno, cf_strerror(errno));
+		cf_free(read_buf);
+		cf_free(pf);
+		cf_free(req);
+		cf_atomic32_decr(&ssd->n_aio_reads);
+		cf_atomic32_decr(&rd->ns->n_reads_from_device);
+		return false;
+	}
+
+	return true;
+}
+
+
+// Consumes pf. If the prefetched block can't be used, rd is left without a
+// device block, and the next access will read the record synchronously.
+void
+as_storage_record_adopt_prefetch_ssd(as_storage_rd *rd, as_storage_prefetch *pf)
+{
+	as_record *r = rd->r;
+	drv_ssd_block *block = pf->block;
+
+	// The record may have been re-written or defragged while unlocked - even
+	// back to the same rblocks, so the version must match too.
+	if (block && ! rd->have_device_block &&
+			r->storage_key.ssd.file_id == pf->file_id &&
+			r->storage_key.ssd.rblock_id == pf->rblock_id &&
+			r->storage_key.ssd.n_rblocks == pf->n_rblocks &&
+			ssd_block_magic_ok(block) &&
+			cf_digest_compare(&block->keyd, &rd->keyd) == 0 &&
+			block->generation == r->generation &&
+			block->last_update_time == r->last_update_time) {
+		drv_ssd *ssd = rd->u.ssd.ssd;
+
+		if (ssd->read_cache) {
+			cf_atomic32_incr(&rd->ns->n_read_cache_misses);
+			ssd_read_cache_put(ssd->read_cache, pf->rblock_id,
+					(const uint8_t*)block,
+					(uint32_t)RBLOCKS_TO_BYTES(pf->n_rblocks));
+		}
+
+		uint8_t *buf = pf->buf;
+
+		if (block->magic == SSD_BLOCK_MAGIC_COMPRESSED) {
+			block = ssd_block_decompress(block, ssd->name);
+			cf_free(buf);
+			buf = (uint8_t*)block;
+		}
+
+		if (block) {
+			rd->u.ssd.block = block;
+			rd->u.ssd.must_free_block = buf;
+			rd->have_device_block = true;
+		}
+	}
+	else if (pf->buf) {
+		cf_free(pf->buf);
+	}
+
+	cf_free(pf);
+}
+
+
+// Hands the read to the done threads - continuations may block (re-reading
+// from device, sending to a slow client) and mustn't hold up reaping.
+static void
+ssd_aio_read_done(ssd_aio_read *req, int64_t res)
+{
+	drv_ssd *ssd = req->ssd;
+	as_storage_prefetch *pf = req->pf;
+
+	if (res != (int64_t)req->iocb.aio_nbytes) {
+		cf_warning(AS_DRV_SSD, "%s: async read failed (%ld): size %lu",
+				ssd->name, res, (uint64_t)req->iocb.aio_nbytes);
+		cf_free(pf->buf);
+		pf->buf = NULL;
+		pf->block = NULL;
+	}
+	else if (req->start_ns != 0) {
+		histogram_insert_data_point(ssd->hist_read, req->start_ns);
+	}
+
+	cf_atomic32_decr(&ssd->n_aio_reads);
+	cf_queue_push(ssd->aio_done_q, &req);
+}
+
+
+void
+as_storage_read_plug_ssd()
+{
+	g_aio_plug.plugged = true;
+}
+
+
+bool
+as_storage_read_is_plugged_ssd()
+{
+	return g_aio_plug.plugged;
+}
+
+
+static int
+ssd_aio_read_compare(const void *pa, const void *pb)
+{
+	const ssd_aio_read *a = *(ssd_aio_read* const*)pa;
+	const ssd_aio_read *b = *(ssd_aio_read* const*)pb;
+
+	if (a->ssd != b->ssd) {
+		return a->ssd < b->ssd ? -1 : 1;
+	}
+
+	if (a->iocb.aio_offset != b->iocb.aio_offset) {
+		return a->iocb.aio_offset < b->iocb.aio_offset ? -1 : 1;
+	}
+
+	return 0;
+}
+
+
+// Submit held-back reads with one io_submit() per device, in offset order.
+void
+as_storage_read_unplug_ssd()
+{
+	ssd_aio_plug *plug = &g_aio_plug;
+	uint32_t n_reqs = plug->n_reqs;
+
+	// Completions below may start new reads - these are not held back.
+	plug->plugged = false;
+	plug->n_reqs = 0;
+
+	if (n_reqs == 0) {
+		return;
+	}
+
+	ssd_aio_read *reqs[AS_STORAGE_MAX_PLUGGED_READS];
+
+	memcpy(reqs, plug->reqs, n_reqs * sizeof(ssd_aio_read*));
+	qsort(reqs, n_reqs, sizeof(ssd_aio_read*), ssd_aio_read_compare);
+
+	struct iocb *iocbs[AS_STORAGE_MAX_PLUGGED_READS];
+	uint32_t i = 0;
+
+	while (i < n_reqs) {
+		drv_ssd *ssd = reqs[i]->ssd;
+		uint32_t n_dev_reqs = 0;
+
+		while (i + n_dev_reqs < n_reqs && reqs[i + n_dev_reqs]->ssd == ssd) {
+			iocbs[n_dev_reqs] = &reqs[i + n_dev_reqs]->iocb;
+			n_dev_reqs++;
+		}
+
+		uint32_t n_submitted = 0;
+
+		while (n_submitted < n_dev_reqs) {
+			int rv = ssd_io_submit(ssd->aio_ctx, n_dev_reqs - n_submitted,
+					&iocbs[n_submitted]);
+
+			if (rv <= 0) {
+				break;
+			}
+
+			n_submitted += (uint32_t)rv;
+		}
+
+		if (n_submitted < n_dev_reqs) {
+			cf_warning(AS_DRV_SSD, "%s: async read submit failed: errno %d (%s)",
+					ssd->name, errno, cf_strerror(errno));
+
+			// Complete as failed reads - callbacks will read synchronously.
+			for (uint32_t j = n_submitted; j < n_dev_reqs; j++) {
+				ssd_aio_read_done(reqs[i + j], -1);
+			}
+		}
+
+		i += n_dev_reqs;
+	}
+}
+
+
+void*
+run_ssd_aio(void *pv_data)
+{
+	drv_ssd *ssd = (drv_ssd*)pv_data;
+	struct io_event events[SSD_AIO_MAX_EVENTS];
+
+	while (true) {
+		int n_events = ssd_io_getevents(ssd->aio_ctx, 1, SSD_AIO_MAX_EVENTS,
+				events);
+
+		if (n_events < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED async read reap: errno %d (%s)",
+					ssd->name, errno, cf_strerror(errno));
+		}
+
+		for (int i = 0; i < n_events; i++) {
+			ssd_aio_read_done((ssd_aio_read*)events[i].data,
+					(int64_t)events[i].res);
+		}
+	}
+
+	return NULL;
+}
+
+
+// Runs the continuations of reaped async reads.
+void*
+run_ssd_aio_done(void *pv_data)
+{
+	cf_queue *done_q = (cf_queue*)pv_data;
+
+	while (true) {
+		ssd_aio_read *req;
+
+		if (CF_QUEUE_OK != cf_queue_pop(done_q, &req, CF_QUEUE_FOREVER)) {
+			cf_crash(AS_DRV_SSD, "async read done queue pop failed");
+		}
+
+		as_storage_read_done_fn cb = req->cb;
+		void *udata = req->udata;
+		as_storage_prefetch *pf = req->pf;
+
+		cf_free(req);
+
+		cb(udata, pf);
+	}
+
+	return NULL;
+}
+
+
+static void
+ssd_start_aio_threads(drv_ssds *ssds)
+{
+	as_namespace *ns = ssds->ns;
+
+	if (ns->storage_async_read_depth == 0 || ns->storage_data_in_memory) {
+		return;
+	}
+
+	cf_info(AS_DRV_SSD, "ns %s starting async read threads", ns->name);
+
+	cf_queue *done_q = NULL;
+
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		drv_ssd *ssd = &ssds->ssds[i];
+
+		// A failure here isn't fatal - this device just reads synchronously.
+		if (ssd_io_setup(ns->storage_async_read_depth, &ssd->aio_ctx) != 0) {
+			cf_warning(AS_DRV_SSD, "%s: async read setup failed: errno %d (%s)",
+					ssd->name, errno, cf_strerror(errno));
+			ssd->aio_ctx = 0;
+			continue;
+		}
+
+		if (! done_q) {
+			if (! (done_q = cf_queue_create(sizeof(ssd_aio_read*), true))) {
+				cf_crash(AS_DRV_SSD, "ns %s can't create async read done queue",
+						ns->name);
+			}
+
+			// As many as run transactions - continuations do the same work.
+			int n_done_threads = g_config.n_transaction_queues *
+					g_config.n_transaction_threads_per_queue;
+
+			for (int j = 0; j < n_done_threads; j++) {
+				pthread_t thread;
+
+				pthread_create(&thread, 0, run_ssd_aio_done, done_q);
+			}
+		}
+
+		ssd->aio_done_q = done_q;
+		pthread_create(&ssd->aio_thread, 0, run_ssd_aio, ssd);
+	}
+}
+
+
+int
+as_storage_particle_read_all_ssd(as_storage_rd *rd)
+{
+	// If the record hasn't been read, read it.
+	if (rd->u.ssd.block == 0) {
+		if (0 != as_storage_record_read_ssd(rd)) {
 			cf_info(AS_DRV_SSD, "read_all: failed as_storage_record_read_ssd()");
 			return -1;
 		}
@@ -1299,56 +2170,42 @@ ssd_flush_swb(drv_ssd *ssd, ssd_write_buf *swb)
 		;
 	}
 
-	int fd = ssd_fd_get(ssd);
 	off_t write_offset = (off_t)WBLOCK_ID_TO_BYTES(ssd, swb->wblock_id);
 
 	uint64_t start_ns = ssd->ns->storage_benchmarks_enabled ? cf_getns() : 0;
 
-	if (lseek(fd, write_offset, SEEK_SET) != write_offset) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED seek: offset %ld: errno %d (%s)",
-				ssd->name, write_offset, errno, cf_strerror(errno));
-	}
-
-	ssize_t rv_s = write(fd, swb->buf, ssd->write_block_size);
+	ssize_t rv_s = pwrite(ssd->fd, swb->buf, ssd->write_block_size,
+			write_offset);
 
 	if (rv_s != (ssize_t)ssd->write_block_size) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: errno %d (%s)",
-				ssd->name, errno, cf_strerror(errno));
+		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: offset %ld: errno %d (%s)",
+				ssd->name, write_offset, errno, cf_strerror(errno));
 	}
 
 	if (start_ns != 0) {
 		histogram_insert_data_point(ssd->hist_write, start_ns);
 	}
-
-	ssd_fd_put(ssd, fd);
 }
 
 
 void
 ssd_shadow_flush_swb(drv_ssd *ssd, ssd_write_buf *swb)
 {
-	int fd = ssd_shadow_fd_get(ssd);
 	off_t write_offset = (off_t)WBLOCK_ID_TO_BYTES(ssd, swb->wblock_id);
 
 	uint64_t start_ns = ssd->ns->storage_benchmarks_enabled ? cf_getns() : 0;
 
-	if (lseek(fd, write_offset, SEEK_SET) != write_offset) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED seek: offset %ld: errno %d (%s)",
-				ssd->shadow_name, write_offset, errno, cf_strerror(errno));
-	}
-
-	ssize_t rv_s = write(fd, swb->buf, ssd->write_block_size);
+	ssize_t rv_s = pwrite(ssd->shadow_fd, swb->buf, ssd->write_block_size,
+			write_offset);
 
 	if (rv_s != (ssize_t)ssd->write_block_size) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: errno %d (%s)",
-				ssd->shadow_name, errno, cf_strerror(errno));
+		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: offset %ld: errno %d (%s)",
+				ssd->shadow_name, write_offset, errno, cf_strerror(errno));
 	}
 
 	if (start_ns != 0) {
 		histogram_insert_data_point(ssd->hist_shadow_write, start_ns);
 	}
-
-	ssd_shadow_fd_put(ssd, fd);
 }
 
 
@@ -1544,71 +2401,28 @@ ssd_write_calculate_size(as_record *r, as_storage_rd *rd)
 }
 
 
-int
-ssd_write_bins(as_record *r, as_storage_rd *rd)
+// Writers on the same CPU share a stripe - usually uncontended, and the swb
+// stays warm in that CPU's cache.
+static inline ssd_write_stripe*
+ssd_write_stripe_get(drv_ssd *ssd)
 {
-	uint32_t write_size = ssd_write_calculate_size(r, rd);
-	drv_ssd *ssd = rd->u.ssd.ssd;
-
-	if (write_size == 0 || write_size > ssd->write_block_size) {
-		cf_warning(AS_DRV_SSD, "write: rejecting %"PRIx64" write size: %u",
-				*(uint64_t*)&rd->keyd, write_size);
-		return -AS_PROTO_RESULT_FAIL_RECORD_TOO_BIG;
-	}
-
-	// Reserve the portion of the current swb where this record will be written.
-	pthread_mutex_lock(&ssd->write_lock);
-
-	ssd_write_buf *swb = ssd->current_swb;
-
-	if (! swb) {
-		swb = swb_get(ssd);
-		ssd->current_swb = swb;
-
-		if (! swb) {
-			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
-			pthread_mutex_unlock(&ssd->write_lock);
-			return -AS_PROTO_RESULT_FAIL_PARTITION_OUT_OF_SPACE;
-		}
+	if (ssd->n_write_stripes == 1) {
+		return &ssd->write_stripes[0];
 	}
 
-	// Check if there's enough space in current buffer - if not, free and zero
-	// any remaining unused space, enqueue it to be flushed to device, and grab
-	// a new buffer.
-	if (write_size > ssd->write_block_size - swb->pos) {
-		if (ssd->write_block_size != swb->pos) {
-			// Clean the end of the buffer before pushing to write queue.
-			memset(&swb->buf[swb->pos], 0, ssd->write_block_size - swb->pos);
-		}
-
-		// Enqueue the buffer, to be flushed to device.
-		cf_queue_push(ssd->swb_write_q, &swb);
-		cf_atomic_int_incr(&ssd->n_wblock_writes);
-
-		// Get the new buffer.
-		swb = swb_get(ssd);
-		ssd->current_swb = swb;
+	int cpu = sched_getcpu();
 
-		if (! swb) {
-			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
-			pthread_mutex_unlock(&ssd->write_lock);
-			return -AS_PROTO_RESULT_FAIL_PARTITION_OUT_OF_SPACE;
-		}
-	}
-
-	// There's enough space - save the position where this record will be
-	// written, and advance swb->pos for the next writer.
-	uint32_t swb_pos = swb->pos;
-
-	swb->pos += write_size;
-	cf_atomic32_incr(&swb->n_writers);
-
-	pthread_mutex_unlock(&ssd->write_lock);
-	// May now write this record concurrently with others in this swb.
+	return &ssd->write_stripes[cpu < 0 ?
+			0 : (uint32_t)cpu % ssd->n_write_stripes];
+}
 
-	// Flatten data into the block.
 
-	uint8_t *buf = &swb->buf[swb_pos];
+// Flatten a record into a block at buf, which must have write_size bytes.
+// Returns the number of bytes actually used.
+static uint32_t
+ssd_flatten_record(as_record *r, as_storage_rd *rd, uint8_t *buf,
+		uint32_t write_size)
+{
 	uint8_t *buf_start = buf;
 
 	drv_ssd_block *block = (drv_ssd_block*)buf;
@@ -1624,13 +2438,6 @@ ssd_write_bins(as_record *r, as_storage_rd *rd)
 	drv_ssd_bin *ssd_bin = 0;
 	uint32_t write_nbins = 0;
 
-	if (0 == rd->bins) {
-		// TODO - just crash?
-		cf_warning(AS_DRV_SSD, "write bins: no bins array");
-		cf_atomic32_decr(&swb->n_writers);
-		return -AS_PROTO_RESULT_FAIL_UNKNOWN;
-	}
-
 	for (uint16_t i = 0; i < rd->n_bins; i++) {
 		as_bin *bin = &rd->bins[i];
 
@@ -1669,6 +2476,184 @@ ssd_write_bins(as_record *r, as_storage_rd *rd)
 	block->n_bins = write_nbins;
 	block->last_update_time = r->last_update_time;
 
+	return (uint32_t)(buf - buf_start);
+}
+
+
+// Per-thread buffers for compressing records, so writes don't allocate. Sized
+// for the largest write block seen, and kept for the life of the thread.
+typedef struct ssd_compress_scratch_s {
+	uint32_t	write_block_size;
+	uint8_t		*flat;
+	uint8_t		*compressed;
+} ssd_compress_scratch;
+
+static __thread ssd_compress_scratch g_compress_scratch;
+
+
+static bool
+ssd_compress_scratch_reserve(uint32_t write_block_size)
+{
+	ssd_compress_scratch *scratch = &g_compress_scratch;
+
+	if (scratch->write_block_size >= write_block_size) {
+		return true;
+	}
+
+	uint8_t *flat = cf_realloc(scratch->flat, write_block_size);
+
+	if (! flat) {
+		return false;
+	}
+
+	scratch->flat = flat;
+
+	uint8_t *compressed = cf_realloc(scratch->compressed,
+			BYTES_TO_RBLOCK_BYTES((uint32_t)(sizeof(drv_ssd_block) +
+					compressBound(write_block_size))));
+
+	if (! compressed) {
+		return false;
+	}
+
+	scratch->compressed = compressed;
+	scratch->write_block_size = write_block_size;
+
+	return true;
+}
+
+
+// Returns a flattened block in a per-thread buffer (not to be freed) - with
+// data[] compressed if that makes the record take fewer rblocks, in which case
+// *p_write_size is reduced. Valid until this thread's next call.
+static const uint8_t*
+ssd_compress_record(as_record *r, as_storage_rd *rd, uint32_t *p_write_size)
+{
+	if (! ssd_compress_scratch_reserve(rd->u.ssd.ssd->write_block_size)) {
+		return NULL;
+	}
+
+	uint32_t write_size = *p_write_size;
+	uint8_t *flat = g_compress_scratch.flat;
+
+	uint32_t data_sz = ssd_flatten_record(r, rd, flat, write_size) -
+			(uint32_t)sizeof(drv_ssd_block);
+	uLongf compressed_sz = compressBound(data_sz);
+	drv_ssd_block *block = (drv_ssd_block*)g_compress_scratch.compressed;
+
+	int rv = compress2(block->data, &compressed_sz,
+			((drv_ssd_block*)flat)->data, data_sz,
+			(int)rd->ns->storage_compression_level);
+
+	uint32_t compressed_write_size = BYTES_TO_RBLOCK_BYTES(
+			(uint32_t)(sizeof(drv_ssd_block) + compressed_sz));
+
+	if (rv != Z_OK || compressed_write_size >= write_size) {
+		return flat;
+	}
+
+	memcpy(block, flat, sizeof(drv_ssd_block));
+
+	block->sig = data_sz;
+	block->length = compressed_write_size - LENGTH_BASE;
+	block->magic = SSD_BLOCK_MAGIC_COMPRESSED;
+
+	// Don't write stale heap bytes to device.
+	memset(block->data + compressed_sz, 0, compressed_write_size -
+			(sizeof(drv_ssd_block) + compressed_sz));
+
+	*p_write_size = compressed_write_size;
+
+	return (const uint8_t*)block;
+}
+
+
+int
+ssd_write_bins(as_record *r, as_storage_rd *rd)
+{
+	uint32_t write_size = ssd_write_calculate_size(r, rd);
+	drv_ssd *ssd = rd->u.ssd.ssd;
+
+	if (write_size == 0 || write_size > ssd->write_block_size) {
+		cf_warning(AS_DRV_SSD, "write: rejecting %"PRIx64" write size: %u",
+				*(uint64_t*)&rd->keyd, write_size);
+		return -AS_PROTO_RESULT_FAIL_RECORD_TOO_BIG;
+	}
+
+	if (0 == rd->bins) {
+		// TODO - just crash?
+		cf_warning(AS_DRV_SSD, "write bins: no bins array");
+		return -AS_PROTO_RESULT_FAIL_UNKNOWN;
+	}
+
+	// If compressing, flatten the record up front - the space to reserve is
+	// only known afterwards.
+	const uint8_t *flat = NULL;
+
+	if (rd->ns->storage_compression != AS_STORAGE_COMPRESSION_NONE) {
+		flat = ssd_compress_record(r, rd, &write_size);
+	}
+
+	ssd_write_stripe *stripe = ssd_write_stripe_get(ssd);
+
+	// Reserve the portion of the current swb where this record will be written.
+	pthread_mutex_lock(&stripe->lock);
+
+	ssd_write_buf *swb = stripe->swb;
+
+	if (! swb) {
+		swb = swb_get(ssd);
+		stripe->swb = swb;
+
+		if (! swb) {
+			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
+			pthread_mutex_unlock(&stripe->lock);
+			return -AS_PROTO_RESULT_FAIL_PARTITION_OUT_OF_SPACE;
+		}
+	}
+
+	// Check if there's enough space in current buffer - if not, free and zero
+	// any remaining unused space, enqueue it to be flushed to device, and grab
+	// a new buffer.
+	if (write_size > ssd->write_block_size - swb->pos) {
+		if (ssd->write_block_size != swb->pos) {
+			// Clean the end of the buffer before pushing to write queue.
+			memset(&swb->buf[swb->pos], 0, ssd->write_block_size - swb->pos);
+		}
+
+		// Enqueue the buffer, to be flushed to device.
+		cf_queue_push(ssd->swb_write_q, &swb);
+		cf_atomic_int_incr(&ssd->n_wblock_writes);
+		cf_atomic64_incr(&stripe->n_writes);
+
+		// Get the new buffer.
+		swb = swb_get(ssd);
+		stripe->swb = swb;
+
+		if (! swb) {
+			cf_warning(AS_DRV_SSD, "write bins: couldn't get swb");
+			pthread_mutex_unlock(&stripe->lock);
+			return -AS_PROTO_RESULT_FAIL_PARTITION_OUT_OF_SPACE;
+		}
+	}
+
+	// There's enough space - save the position where this record will be
+	// written, and advance swb->pos for the next writer.
+	uint32_t swb_pos = swb->pos;
+
+	swb->pos += write_size;
+	cf_atomic32_incr(&swb->n_writers);
+
+	pthread_mutex_unlock(&stripe->lock);
+	// May now write this record concurrently with others in this swb.
+
+	if (flat) {
+		memcpy(&swb->buf[swb_pos], flat, write_size);
+	}
+	else {
+		ssd_flatten_record(r, rd, &swb->buf[swb_pos], write_size);
+	}
+
 	r->storage_key.ssd.file_id = ssd->file_id;
 	r->storage_key.ssd.rblock_id = BYTES_TO_RBLOCKS(WBLOCK_ID_TO_BYTES(ssd, swb->wblock_id) + swb_pos);
 	r->storage_key.ssd.n_rblocks = BYTES_TO_RBLOCKS(write_size);
@@ -1914,29 +2899,18 @@ as_storage_analyze_wblock(as_namespace* ns, int device_index,
 		return -1;
 	}
 
-	int fd = ssd_fd_get(ssd);
 	uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
 
-	if (lseek(fd, (off_t)file_offset, SEEK_SET) != (off_t)file_offset) {
-		cf_warning(AS_DRV_SSD, "%s: seek failed: offset %lu: errno %d (%s)",
-				ssd->name, file_offset, errno, cf_strerror(errno));
-		cf_free(read_buf);
-		close(fd);
-		return -1;
-	}
-
-	ssize_t rlen = read(fd, read_buf, ssd->write_block_size);
+	ssize_t rlen = pread(ssd->fd, read_buf, ssd->write_block_size,
+			(off_t)file_offset);
 
 	if (rlen != (ssize_t)ssd->write_block_size) {
-		cf_warning(AS_DRV_SSD, "%s: read failed (%ld): errno %d (%s)",
-				ssd->name, rlen, errno, cf_strerror(errno));
+		cf_warning(AS_DRV_SSD, "%s: read failed (%ld): offset %lu: errno %d (%s)",
+				ssd->name, rlen, file_offset, errno, cf_strerror(errno));
 		cf_free(read_buf);
-		close(fd);
 		return -1;
 	}
 
-	ssd_fd_put(ssd, fd);
-
 	uint32_t living_populations[AS_PARTITIONS];
 	uint32_t zombie_populations[AS_PARTITIONS];
 
@@ -1950,7 +2924,7 @@ as_storage_analyze_wblock(as_namespace* ns, int device_index,
 	while (offset < ssd->write_block_size) {
 		drv_ssd_block* p_block = (drv_ssd_block*)&read_buf[offset];
 
-		if (p_block->magic != SSD_BLOCK_MAGIC) {
+		if (! ssd_block_magic_ok(p_block)) {
 			if (offset == 0) {
 				// First block must have magic.
 				cf_warning(AS_DRV_SSD, "analyze wblock ERROR: 1st block has no magic");
@@ -2068,7 +3042,7 @@ ssd_log_stats(drv_ssd *ssd, uint64_t *p_prev_n_total_writes,
 			cf_queue_sz(ssd->free_wblock_q),
 			cf_queue_sz(ssd->swb_free_q),
 			cf_queue_sz(ssd->swb_write_q), n_total_writes, total_write_rate,
-			cf_queue_sz(ssd->defrag_wblock_q), n_defrag_reads, defrag_read_rate,
+			defrag_q_sz(ssd->defrag_wblock_q), n_defrag_reads, defrag_read_rate,
 			n_defrag_writes, defrag_write_rate);
 
 	if (ssd->shadow_name) {
@@ -2104,10 +3078,10 @@ ssd_free_swbs(drv_ssd *ssd)
 
 
 void
-ssd_flush_current_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
-		uint32_t *p_prev_size)
+ssd_flush_current_swb(drv_ssd *ssd, ssd_write_stripe *stripe,
+		uint64_t *p_prev_n_writes, uint32_t *p_prev_size)
 {
-	uint64_t n_writes = cf_atomic_int_get(ssd->n_wblock_writes);
+	uint64_t n_writes = cf_atomic64_get(stripe->n_writes);
 
 	// If there's an active write load, we don't need to flush.
 	if (n_writes != *p_prev_n_writes) {
@@ -2116,14 +3090,14 @@ ssd_flush_current_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
 		return;
 	}
 
-	pthread_mutex_lock(&ssd->write_lock);
+	pthread_mutex_lock(&stripe->lock);
 
-	n_writes = cf_atomic_int_get(ssd->n_wblock_writes);
+	n_writes = cf_atomic64_get(stripe->n_writes);
 
 	// Must check under the lock, could be racing a current swb just queued.
 	if (n_writes != *p_prev_n_writes) {
 
-		pthread_mutex_unlock(&ssd->write_lock);
+		pthread_mutex_unlock(&stripe->lock);
 
 		*p_prev_n_writes = n_writes;
 		*p_prev_size = 0;
@@ -2133,7 +3107,7 @@ ssd_flush_current_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
 	// Flush the current swb if it isn't empty, and has been written to since
 	// last flushed.
 
-	ssd_write_buf *swb = ssd->current_swb;
+	ssd_write_buf *swb = stripe->swb;
 
 	if (swb && swb->pos != *p_prev_size) {
 		*p_prev_size = swb->pos;
@@ -2147,7 +3121,7 @@ ssd_flush_current_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
 		ssd_flush_swb(ssd, swb);
 	}
 
-	pthread_mutex_unlock(&ssd->write_lock);
+	pthread_mutex_unlock(&stripe->lock);
 }
 
 
@@ -2202,17 +3176,13 @@ ssd_flush_defrag_swb(drv_ssd *ssd, uint64_t *p_prev_n_writes,
 void
 ssd_fsync(drv_ssd *ssd)
 {
-	int fd = ssd_fd_get(ssd);
-
 	uint64_t start_ns = ssd->ns->storage_benchmarks_enabled ? cf_getns() : 0;
 
-	fsync(fd);
+	fsync(ssd->fd);
 
 	if (start_ns != 0) {
 		histogram_insert_data_point(ssd->hist_fsync, start_ns);
 	}
-
-	ssd_fd_put(ssd, fd);
 }
 
 
@@ -2274,8 +3244,8 @@ run_ssd_maintenance(void *udata)
 	uint64_t prev_n_defrag_reads = 0;
 	uint64_t prev_n_defrag_writes = 0;
 
-	uint64_t prev_n_writes_flush = 0;
-	uint32_t prev_size_flush = 0;
+	uint64_t prev_n_writes_flush[MAX_SSD_WRITE_STRIPES] = { 0 };
+	uint32_t prev_size_flush[MAX_SSD_WRITE_STRIPES] = { 0 };
 	uint64_t prev_n_writes_defrag_flush = 0;
 	uint32_t prev_size_defrag_flush = 0;
 
@@ -2316,7 +3286,11 @@ run_ssd_maintenance(void *udata)
 		uint64_t flush_max_us = ns->storage_flush_max_us;
 
 		if (flush_max_us != 0 && now >= prev_flush + flush_max_us) {
-			ssd_flush_current_swb(ssd, &prev_n_writes_flush, &prev_size_flush);
+			for (uint32_t i = 0; i < ssd->n_write_stripes; i++) {
+				ssd_flush_current_swb(ssd, &ssd->write_stripes[i],
+						&prev_n_writes_flush[i], &prev_size_flush[i]);
+			}
+
 			prev_flush = now;
 			next = next_time(now, flush_max_us, next);
 		}
@@ -2380,7 +3354,7 @@ as_storage_read_header(drv_ssd *ssd, as_namespace *ns,
 
 	bool use_shadow = ns->cold_start && ssd->shadow_name;
 	const char *ssd_name = use_shadow ? ssd->shadow_name : ssd->name;
-	int fd = use_shadow ? ssd_shadow_fd_get(ssd) : ssd_fd_get(ssd);
+	int fd = use_shadow ? ssd->shadow_fd : ssd->fd;
 
 	size_t peek_size = BYTES_UP_TO_IO_MIN(ssd, sizeof(ssd_device_header));
 	ssd_device_header *header = cf_valloc(peek_size);
@@ -2389,21 +3363,11 @@ as_storage_read_header(drv_ssd *ssd, as_namespace *ns,
 		goto Fail;
 	}
 
-	if (lseek(fd, 0, SEEK_SET) != 0) {
-		cf_warning(AS_DRV_SSD, "%s: seek failed: errno %d (%s)", ssd_name,
-				errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
-		goto Fail;
-	}
-
-	ssize_t sz = read(fd, (void*)header, peek_size);
+	ssize_t sz = pread(fd, (void*)header, peek_size, 0);
 
 	if (sz != (ssize_t)peek_size) {
 		cf_warning(AS_DRV_SSD, "%s: read failed (%ld): errno %d (%s)",
 				ssd_name, sz, errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
 		goto Fail;
 	}
 
@@ -2459,21 +3423,11 @@ as_storage_read_header(drv_ssd *ssd, as_namespace *ns,
 		goto Fail;
 	}
 
-	if (lseek(fd, 0, SEEK_SET) != 0) {
-		cf_warning(AS_DRV_SSD, "%s: seek failed: errno %d (%s)", ssd_name,
-				errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
-		goto Fail;
-	}
-
-	sz = read(fd, (void*)header, h_len);
+	sz = pread(fd, (void*)header, h_len, 0);
 
 	if (sz != (ssize_t)header->header_length) {
 		cf_warning(AS_DRV_SSD, "%s: read failed (%ld): errno %d (%s)",
 				ssd_name, sz, errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
 		goto Fail;
 	}
 
@@ -2488,8 +3442,6 @@ as_storage_read_header(drv_ssd *ssd, as_namespace *ns,
 
 	*header_r = header;
 
-	use_shadow ? ssd_shadow_fd_put(ssd, fd) : ssd_fd_put(ssd, fd);
-
 	return 0;
 
 Fail:
@@ -2498,10 +3450,6 @@ Fail:
 		cf_free(header);
 	}
 
-	if (fd != -1) {
-		use_shadow ? ssd_shadow_fd_put(ssd, fd) : ssd_fd_put(ssd, fd);
-	}
-
 	return rv;
 }
 
@@ -2546,14 +3494,7 @@ as_storage_empty_header(int fd, const char* device_name)
 
 	memset(h, 0, SSD_DEFAULT_HEADER_LENGTH);
 
-	if (0 != lseek(fd, 0, SEEK_SET)) {
-		cf_warning(AS_DRV_SSD, "device %s: empty header: seek error: %s",
-				device_name, cf_strerror(errno));
-		cf_free(h);
-		return false;
-	}
-
-	if (SSD_DEFAULT_HEADER_LENGTH != write(fd, h, SSD_DEFAULT_HEADER_LENGTH)) {
+	if (SSD_DEFAULT_HEADER_LENGTH != pwrite(fd, h, SSD_DEFAULT_HEADER_LENGTH, 0)) {
 		cf_warning(AS_DRV_SSD, "device %s: empty header: write error: %s",
 				device_name, cf_strerror(errno));
 		cf_free(h);
@@ -2570,41 +3511,23 @@ as_storage_empty_header(int fd, const char* device_name)
 void
 as_storage_write_header(drv_ssd *ssd, ssd_device_header *header, size_t size)
 {
-	int fd = ssd_fd_get(ssd);
-
-	if (lseek(fd, 0, SEEK_SET) != 0) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED seek: errno %d (%s)",
-				ssd->name, errno, cf_strerror(errno));
-	}
-
-	ssize_t sz = write(fd, (void*)header, size);
+	ssize_t sz = pwrite(ssd->fd, (void*)header, size, 0);
 
 	if (sz != (ssize_t)size) {
 		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: errno %d (%s)",
 				ssd->name, errno, cf_strerror(errno));
 	}
 
-	ssd_fd_put(ssd, fd);
-
 	if (! ssd->shadow_name) {
 		return;
 	}
 
-	fd = ssd_shadow_fd_get(ssd);
-
-	if (lseek(fd, 0, SEEK_SET) != 0) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED seek: errno %d (%s)",
-				ssd->shadow_name, errno, cf_strerror(errno));
-	}
-
-	sz = write(fd, (void*)header, size);
+	sz = pwrite(ssd->shadow_fd, (void*)header, size, 0);
 
 	if (sz != (ssize_t)size) {
 		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: errno %d (%s)",
 				ssd->shadow_name, errno, cf_strerror(errno));
 	}
-
-	ssd_shadow_fd_put(ssd, fd);
 }
 
 
@@ -2754,13 +3677,15 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 		// Record already existed. Ignore this one if existing record is newer.
 		if (prefer_existing_record(ssd, wblock_id, block, r)) {
 			as_record_done(&r_ref, ns);
-			ssd->record_add_older_counter++;
+			cf_atomic64_incr(&ssd->record_add_older_counter);
 			return -1;
 		}
 	}
 	// The record we're now reading is the latest version (so far) ...
 
 	// Set/reset the record's void-time, last-update-time, and generation.
+	uint32_t old_void_time = r->void_time;
+
 	r->void_time = block->void_time;
 	r->last_update_time = block->last_update_time;
 	r->generation = block->generation;
@@ -2786,7 +3711,7 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 
 			as_index_delete(p_partition->vp, &block->keyd);
 			as_record_done(&r_ref, ns);
-			ssd->record_add_expired_counter++;
+			cf_atomic64_incr(&ssd->record_add_expired_counter);
 			return -1;
 		}
 
@@ -2796,7 +3721,7 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 					r->void_time, ns->cold_start_max_void_time);
 
 			r->void_time = ns->cold_start_max_void_time;
-			ssd->record_add_max_ttl_counter++;
+			cf_atomic64_incr(&ssd->record_add_max_ttl_counter);
 		}
 	}
 
@@ -2806,6 +3731,11 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 	cf_atomic_int_setmax(&p_partition->max_void_time, r->void_time);
 	cf_atomic_int_setmax(&ns->max_void_time, r->void_time);
 
+	if (p_partition->expire_index && ! is_ldt_sub) {
+		as_expire_index_add(p_partition->expire_index, &block->keyd,
+				old_void_time, r->void_time);
+	}
+
 	if (props.size != 0) {
 		// Do this early since set-id is needed for the secondary index update.
 		as_record_apply_properties(r, ns, &props);
@@ -2972,18 +3902,19 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 		ssd_block_free(&ssds->ssds[r->storage_key.ssd.file_id],
 				r->storage_key.ssd.rblock_id, r->storage_key.ssd.n_rblocks,
 				"record-add");
-		ssd->record_add_replace_counter++;
+		cf_atomic64_incr(&ssd->record_add_replace_counter);
 	}
 	else {
-		ssd->record_add_unique_counter++;
+		cf_atomic64_incr(&ssd->record_add_unique_counter);
 	}
 
 	// Update storage accounting to include this record.
 	// TODO - pass in size instead of n_rblocks.
 	uint32_t size = (uint32_t)RBLOCKS_TO_BYTES(n_rblocks);
 
-	ssd->inuse_size += size;
-	ssd->alloc_table->wblock_state[wblock_id].inuse_sz += size;
+	cf_atomic64_add(&ssd->inuse_size, (int64_t)size);
+	cf_atomic32_add(&ssd->alloc_table->wblock_state[wblock_id].inuse_sz,
+			(int32_t)size);
 
 	// Set/reset the record's storage information.
 	r->storage_key.ssd.file_id = ssd->file_id;
@@ -3001,6 +3932,232 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 }
 
 
+//------------------------------------------------
+// Cold start load pipeline - per device, the load thread keeps several
+// large-block reads in flight and scans completed blocks for records, and a
+// pool of workers adds the records to the index. Each worker owns a fixed
+// subset of partitions, so a given digest's versions on a device are still
+// added in device order.
+//
+
+#define LOAD_READ_AHEAD		8 // large-block reads in flight per device
+#define LOAD_N_BUFS			(LOAD_READ_AHEAD * 2)
+#define LOAD_MAX_RECORDS	(LOAD_BUF_SIZE / RBLOCK_SIZE)
+
+typedef struct ssd_load_rec_s {
+	uint32_t		offset; // within the large block
+	uint32_t		n_rblocks;
+	as_partition_id	pid;
+} ssd_load_rec;
+
+typedef struct ssd_load_buf_s {
+	struct iocb		iocb;
+	off_t			file_offset;
+	int64_t			res; // bytes read (or error) once done
+	bool			done;
+	cf_atomic32		n_users; // workers yet to finish with this buf
+	uint32_t		n_recs;
+	ssd_load_rec	recs[LOAD_MAX_RECORDS];
+	uint8_t			*buf;
+} ssd_load_buf;
+
+typedef struct ssd_load_worker_s {
+	drv_ssds		*ssds;
+	drv_ssd			*ssd;
+	uint32_t		id;
+	uint32_t		n_workers;
+	cf_queue		*buf_q; // bufs to add records from - null means stop
+	cf_queue		*free_q; // last worker done with a buf puts it here
+	pthread_t		thread;
+} ssd_load_worker;
+
+
+void*
+run_ssd_load_worker(void *pv_data)
+{
+	ssd_load_worker *w = (ssd_load_worker*)pv_data;
+
+#ifdef USE_JEM
+	// Allocate long-term storage in this namespace's JEMalloc arena.
+	jem_set_arena(w->ssds->ns->jem_arena);
+#endif
+
+	while (true) {
+		ssd_load_buf *lb;
+
+		cf_queue_pop(w->buf_q, &lb, CF_QUEUE_FOREVER);
+
+		if (! lb) {
+			break;
+		}
+
+		for (uint32_t i = 0; i < lb->n_recs; i++) {
+			ssd_load_rec *rec = &lb->recs[i];
+
+			if (rec->pid % w->n_workers != w->id) {
+				continue;
+			}
+
+			drv_ssd_block *block = (drv_ssd_block*)(lb->buf + rec->offset);
+			drv_ssd_block *dblock = NULL;
+
+			if (block->magic == SSD_BLOCK_MAGIC_COMPRESSED) {
+				if (! (dblock = ssd_block_decompress(block, w->ssd->name))) {
+					continue;
+				}
+
+				block = dblock;
+			}
+
+			int add_rv = ssd_record_add(w->ssds, w->ssd, block,
+					BYTES_TO_RBLOCKS(lb->file_offset + rec->offset),
+					rec->n_rblocks);
+
+			if (add_rv == -2) {
+				cf_crash(AS_DRV_SSD, "hit stop-writes limit before drive scan completed");
+			}
+
+			if (dblock) {
+				cf_free(dblock);
+			}
+		}
+
+		if (cf_atomic32_decr(&lb->n_users) == 0) {
+			cf_queue_push(w->free_q, &lb);
+		}
+	}
+
+	return NULL;
+}
+
+
+// Issue a large-block read - synchronously if we have no AIO context.
+static void
+ssd_load_submit(aio_context_t ctx, int fd, ssd_load_buf *lb, off_t file_offset)
+{
+	lb->file_offset = file_offset;
+	lb->done = false;
+
+	if (ctx != 0) {
+		memset(&lb->iocb, 0, sizeof(lb->iocb));
+		lb->iocb.aio_data = (uint64_t)lb;
+		lb->iocb.aio_lio_opcode = IOCB_CMD_PREAD;
+		lb->iocb.aio_fildes = (uint32_t)fd;
+		lb->iocb.aio_buf = (uint64_t)lb->buf;
+		lb->iocb.aio_nbytes = LOAD_BUF_SIZE;
+		lb->iocb.aio_offset = (int64_t)file_offset;
+
+		struct iocb *iocbs[1] = { &lb->iocb };
+
+		if (ssd_io_submit(ctx, 1, iocbs) == 1) {
+			return;
+		}
+	}
+
+	lb->res = (int64_t)pread(fd, lb->buf, LOAD_BUF_SIZE, file_offset);
+	lb->done = true;
+}
+
+
+// Wait for a specific large-block read. (Reads may complete out of order.)
+static void
+ssd_load_wait(aio_context_t ctx, ssd_load_buf *lb, const char *ssd_name)
+{
+	struct io_event events[LOAD_READ_AHEAD];
+
+	while (! lb->done) {
+		int n_events = ssd_io_getevents(ctx, 1, LOAD_READ_AHEAD, events);
+
+		if (n_events < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED load read reap: errno %d (%s)",
+					ssd_name, errno, cf_strerror(errno));
+		}
+
+		for (int i = 0; i < n_events; i++) {
+			ssd_load_buf *done_lb = (ssd_load_buf*)events[i].data;
+
+			done_lb->res = (int64_t)events[i].res;
+			done_lb->done = true;
+		}
+	}
+}
+
+
+// Find the records in a large block just read. Returns false if we should stop
+// sweeping.
+static bool
+ssd_load_scan_buf(drv_ssds *ssds, ssd_load_buf *lb, int *p_error_count)
+{
+	size_t block_offset = 0; // current offset within the 1M block, in bytes
+
+	lb->n_recs = 0;
+
+	while (block_offset < LOAD_BUF_SIZE) {
+		drv_ssd_block *block = (drv_ssd_block*)&lb->buf[block_offset];
+
+		// Look for record magic.
+		if (! ssd_block_magic_ok(block)) {
+			// No record found here.
+			// (Includes normal case of nothing ever written here).
+
+			block_offset += RBLOCK_SIZE;
+
+			// We always write some at the start of a 1M block.
+			if (block_offset == RBLOCK_SIZE) {
+				(*p_error_count)++;
+				break;
+			}
+
+			// Otherwise check the next rblock, looking for magic.
+			continue;
+		}
+
+		// Note - if block->length is sane, we don't need to round up to a
+		// multiple of RBLOCK_SIZE, but let's do it anyway just to be safe.
+		size_t next_block_offset = block_offset +
+				BYTES_TO_RBLOCK_BYTES(block->length + LENGTH_BASE);
+
+		// Sanity-check for 1M block overruns.
+		// TODO - check write_block_size boundaries!
+		if (next_block_offset > LOAD_BUF_SIZE) {
+			cf_warning(AS_DRV_SSD, "error: block extends over read size: foff %"PRIu64" boff %"PRIu64" blen %"PRIu64,
+				(uint64_t)lb->file_offset, block_offset,
+				(uint64_t)block->length);
+
+			(*p_error_count)++;
+			break;
+		}
+
+		// Can't parse this record - skip the rest of this 1M block. (Compressed
+		// records are checked by the workers, once decompressed.)
+		if (block->magic == SSD_BLOCK_MAGIC &&
+				! is_valid_record(block, ssds->ns->name)) {
+			(*p_error_count)++;
+			break;
+		}
+
+		// Found a record - a worker will try to add it to the index.
+		ssd_load_rec *rec = &lb->recs[lb->n_recs++];
+
+		rec->offset = (uint32_t)block_offset;
+		rec->n_rblocks =
+				(uint32_t)BYTES_TO_RBLOCKS(next_block_offset - block_offset);
+		rec->pid = as_partition_getid(block->keyd);
+
+		*p_error_count = 0;
+		block_offset = next_block_offset;
+	}
+
+	// If we encounter enough 1M blocks that have no records, assume we've
+	// read all our data and we're done.
+	return *p_error_count <= 10;
+}
+
+
 // Sweep through storage devices and rebuild the index.
 //
 // If there are LDT records the sweep is done twice, once for LDT parent records
@@ -3008,136 +4165,167 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 int
 ssd_load_device_sweep(drv_ssds *ssds, drv_ssd *ssd)
 {
-	uint8_t *buf = cf_valloc(LOAD_BUF_SIZE);
-
 	bool read_shadow = ssd->shadow_name && ! ssd->sub_sweep;
 	char *read_ssd_name = read_shadow ? ssd->shadow_name : ssd->name;
-	int fd = read_shadow ? ssd_shadow_fd_get(ssd) : ssd_fd_get(ssd);
-	int write_fd = read_shadow ? ssd_fd_get(ssd) : -1;
+	int fd = read_shadow ? ssd->shadow_fd : ssd->fd;
 
-	// Seek past the header.
-	off_t file_offset = ssds->header->header_length;
+	aio_context_t ctx = 0;
 
-	if (lseek(fd, file_offset, SEEK_SET) != file_offset) {
-		cf_warning(AS_DRV_SSD, "%s: seek failed: offset %ld: errno %d (%s)",
-				read_ssd_name, file_offset, errno, cf_strerror(errno));
-		close(fd);
-		fd = -1;
-		goto Finished;
+	if (ssd_io_setup(LOAD_READ_AHEAD, &ctx) != 0) {
+		cf_warning(AS_DRV_SSD, "%s: load read-ahead setup failed, reading synchronously: errno %d (%s)",
+				read_ssd_name, errno, cf_strerror(errno));
+		ctx = 0;
+	}
+
+	cf_queue *free_q = cf_queue_create(sizeof(ssd_load_buf*), true);
+
+	if (! free_q) {
+		cf_crash(AS_DRV_SSD, "can't create load buffer queue");
+	}
+
+	for (int i = 0; i < LOAD_N_BUFS; i++) {
+		ssd_load_buf *lb = cf_malloc(sizeof(ssd_load_buf));
+
+		if (! lb || ! (lb->buf = cf_valloc(LOAD_BUF_SIZE))) {
+			cf_crash(AS_DRV_SSD, "memory allocation in device load");
+		}
+
+		cf_queue_push(free_q, &lb);
 	}
 
-	if (read_shadow && lseek(write_fd, file_offset, SEEK_SET) != file_offset) {
-		cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED seek: offset %ld: errno %d (%s)",
-				ssd->name, file_offset, errno, cf_strerror(errno));
+	uint32_t n_workers = ssds->ns->storage_cold_start_threads;
+	ssd_load_worker workers[n_workers];
+
+	for (uint32_t i = 0; i < n_workers; i++) {
+		ssd_load_worker *w = &workers[i];
+
+		w->ssds = ssds;
+		w->ssd = ssd;
+		w->id = i;
+		w->n_workers = n_workers;
+		w->free_q = free_q;
+
+		if (! (w->buf_q = cf_queue_create(sizeof(ssd_load_buf*), true))) {
+			cf_crash(AS_DRV_SSD, "can't create load worker queue");
+		}
+
+		pthread_create(&w->thread, 0, run_ssd_load_worker, w);
 	}
 
+	// Skip the header.
+	off_t file_offset = ssds->header->header_length;
+	off_t read_offset = file_offset;
+
+	ssd_load_buf *in_flight[LOAD_READ_AHEAD];
+	uint32_t head = 0;
+	uint32_t n_in_flight = 0;
+
 	int error_count = 0;
+	bool done = false;
 
 	ssd->cold_start_block_counter = file_offset / LOAD_BUF_SIZE;
 
 	// Loop over all blocks in device.
 	while (true) {
-		ssize_t rlen = read(fd, buf, LOAD_BUF_SIZE);
+		// Keep the read-ahead pipeline full.
+		while (! done && n_in_flight < LOAD_READ_AHEAD &&
+				read_offset < ssd->file_size) {
+			// Nothing was in use here at the last clean shutdown.
+			if (ssd_wblock_map_can_skip(ssd, read_offset, LOAD_BUF_SIZE)) {
+				read_offset += LOAD_BUF_SIZE;
+				ssd->cold_start_block_counter++;
+				continue;
+			}
 
-		if (rlen != LOAD_BUF_SIZE) {
-			cf_warning(AS_DRV_SSD, "%s: read failed (%ld): errno %d (%s)",
-					read_ssd_name, rlen, errno, cf_strerror(errno));
-			close(fd);
-			fd = -1;
-			goto Finished;
-		}
+			ssd_load_buf *lb;
 
-		if (read_shadow) {
-			// TODO - ok to always write 1Mb blocks?
-			ssize_t sz = write(write_fd, (void*)buf, LOAD_BUF_SIZE);
+			cf_queue_pop(free_q, &lb, CF_QUEUE_FOREVER);
+			ssd_load_submit(ctx, fd, lb, read_offset);
 
-			if (sz != LOAD_BUF_SIZE) {
-				cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: errno %d (%s)",
-						ssd->name, errno, cf_strerror(errno));
-			}
+			in_flight[(head + n_in_flight) % LOAD_READ_AHEAD] = lb;
+			n_in_flight++;
+			read_offset += LOAD_BUF_SIZE;
 		}
 
-		size_t block_offset = 0; // current offset within the 1M block, in bytes
-
-		while (block_offset < LOAD_BUF_SIZE) {
-			drv_ssd_block *block = (drv_ssd_block*)&buf[block_offset];
-
-			// Look for record magic.
-			if (block->magic != SSD_BLOCK_MAGIC) {
-				// No record found here.
-				// (Includes normal case of nothing ever written here).
+		if (n_in_flight == 0) {
+			break;
+		}
 
-				block_offset += RBLOCK_SIZE;
+		ssd_load_buf *lb = in_flight[head];
 
-				// We always write some at the start of a 1M block.
-				if (block_offset == RBLOCK_SIZE) {
-					error_count++;
-					goto NextBlock;
-				}
-				else {
-					// Otherwise check the next rblock, looking for magic.
-					continue;
-				}
-			}
+		head = (head + 1) % LOAD_READ_AHEAD;
+		n_in_flight--;
 
-			// Note - if block->length is sane, we don't need to round up to a
-			// multiple of RBLOCK_SIZE, but let's do it anyway just to be safe.
-			size_t next_block_offset = block_offset +
-					BYTES_TO_RBLOCK_BYTES(block->length + LENGTH_BASE);
+		ssd_load_wait(ctx, lb, read_ssd_name);
 
-			// Sanity-check for 1M block overruns.
-			// TODO - check write_block_size boundaries!
-			if (next_block_offset > LOAD_BUF_SIZE) {
-				cf_warning(AS_DRV_SSD, "error: block extends over read size: foff %"PRIu64" boff %"PRIu64" blen %"PRIu64,
-					file_offset, block_offset, (uint64_t)block->length);
+		// Once done, just drain reads still in flight.
+		if (done) {
+			cf_queue_push(free_q, &lb);
+			continue;
+		}
 
-				error_count++;
-				goto NextBlock;
-			}
+		if (lb->res != LOAD_BUF_SIZE) {
+			cf_warning(AS_DRV_SSD, "%s: read failed (%ld): offset %ld",
+					read_ssd_name, lb->res, lb->file_offset);
+			cf_queue_push(free_q, &lb);
+			done = true;
+			continue;
+		}
 
-			// Found a record - try to add it to the index.
-			int add_rv = ssd_record_add(ssds, ssd, block,
-					BYTES_TO_RBLOCKS(file_offset + block_offset),
-					(uint32_t)BYTES_TO_RBLOCKS(next_block_offset - block_offset));
+		if (read_shadow) {
+			// TODO - ok to always write 1Mb blocks?
+			ssize_t sz = pwrite(ssd->fd, (void*)lb->buf, LOAD_BUF_SIZE,
+					lb->file_offset);
 
-			if (add_rv == -2) {
-				cf_crash(AS_DRV_SSD, "hit stop-writes limit before drive scan completed");
+			if (sz != LOAD_BUF_SIZE) {
+				cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED write: errno %d (%s)",
+						ssd->name, errno, cf_strerror(errno));
 			}
+		}
 
-			if (add_rv == -3) {
-				error_count++;
-				goto NextBlock;
-			}
+		done = ! ssd_load_scan_buf(ssds, lb, &error_count);
 
-			error_count = 0;
-			block_offset = next_block_offset;
+		if (lb->n_recs == 0) {
+			cf_queue_push(free_q, &lb);
 		}
+		else {
+			cf_atomic32_set(&lb->n_users, n_workers);
 
-NextBlock:
-
-		// If we encounter enough 1M blocks that have no records, assume we've
-		// read all our data and we're done.
-		if (error_count > 10) {
-			goto Finished;
+			for (uint32_t i = 0; i < n_workers; i++) {
+				cf_queue_push(workers[i].buf_q, &lb);
+			}
 		}
 
-		file_offset += LOAD_BUF_SIZE;
 		ssd->cold_start_block_counter++;
 	}
 
-Finished:
+	// Stop the workers once they've drained their queues.
+	ssd_load_buf *stop_lb = NULL;
 
-	ssd->cold_start_block_counter = ssd->file_size / LOAD_BUF_SIZE;
+	for (uint32_t i = 0; i < n_workers; i++) {
+		cf_queue_push(workers[i].buf_q, &stop_lb);
+	}
+
+	for (uint32_t i = 0; i < n_workers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		cf_queue_destroy(workers[i].buf_q);
+	}
 
-	if (fd != -1) {
-		read_shadow ? ssd_shadow_fd_put(ssd, fd) : ssd_fd_put(ssd, fd);
+	if (ctx != 0) {
+		ssd_io_destroy(ctx);
 	}
 
-	if (write_fd != -1) {
-		ssd_fd_put(ssd, write_fd);
+	// All bufs are back in the free queue now.
+	ssd_load_buf *lb;
+
+	while (cf_queue_pop(free_q, &lb, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		cf_free(lb->buf);
+		cf_free(lb);
 	}
 
-	cf_free(buf);
+	cf_queue_destroy(free_q);
+
+	ssd->cold_start_block_counter = ssd->file_size / LOAD_BUF_SIZE;
 
 	return 0;
 }
@@ -3193,6 +4381,11 @@ ssd_load_devices_fn(void *udata)
 		ssd_load_device_sweep(ssds, ssd);
 	}
 
+	if (ssd->load_wblock_map) {
+		cf_free(ssd->load_wblock_map);
+		ssd->load_wblock_map = NULL;
+	}
+
 	cf_info(AS_DRV_SSD, "device %s: read complete: UNIQUE %"PRIu64" (REPLACED %"PRIu64") (OLDER %"PRIu64") (EXPIRED %"PRIu64") (MAX-TTL %"PRIu64") records",
 		ssd->name, ssd->record_add_unique_counter,
 		ssd->record_add_replace_counter, ssd->record_add_older_counter,
@@ -3215,6 +4408,7 @@ ssd_load_devices_fn(void *udata)
 		cf_rc_free(complete_rc);
 
 		ssd_start_maintenance_threads(ssds);
+		ssd_start_aio_threads(ssds);
 		ssd_start_write_worker_threads(ssds);
 		ssd_start_defrag_threads(ssds);
 	}
@@ -3367,6 +4561,18 @@ ssd_load_devices(drv_ssds *ssds, cf_queue *complete_q, void *udata)
 	ssds->header = headers[first_used];
 	headers[first_used] = 0;
 
+	// A map saved at clean shutdown is only good against the same header.
+	for (int i = 0; i < n_ssds; i++) {
+		drv_ssd *ssd = &ssds->ssds[i];
+
+		if (ns->cold_start && ! ssd->started_fresh) {
+			ssd_wblock_map_load(ssd, ssds->header->random);
+		}
+		else {
+			ssd_wblock_map_remove(ssd);
+		}
+	}
+
 	for (int i = 0; i < n_ssds; i++) {
 		if (headers[i]) {
 			cf_free(headers[i]);
@@ -3548,17 +4754,11 @@ check_file_size(off_t file_size, const char *tag)
 static uint64_t
 find_io_min_size(int fd, const char *ssd_name)
 {
-	off_t off = lseek(fd, 0, SEEK_SET);
-
-	if (off != 0) {
-		cf_crash(AS_DRV_SSD, "%s: seek error %s", ssd_name, cf_strerror(errno));
-	}
-
 	uint8_t *buf = cf_valloc(HI_IO_MIN_SIZE);
 	size_t read_sz = LO_IO_MIN_SIZE;
 
 	while (read_sz <= HI_IO_MIN_SIZE) {
-		if (read(fd, (void*)buf, read_sz) == (ssize_t)read_sz) {
+		if (pread(fd, (void*)buf, read_sz, 0) == (ssize_t)read_sz) {
 			cf_free(buf);
 			return read_sz;
 		}
@@ -3585,7 +4785,7 @@ ssd_init_devices(as_namespace *ns, drv_ssds **ssds_p)
 	}
 
 	size_t ssds_size = sizeof(drv_ssds) + (n_ssds * sizeof(drv_ssd));
-	drv_ssds *ssds = cf_malloc(ssds_size);
+	drv_ssds *ssds = cf_valloc(ssds_size); // write stripes must be aligned
 
 	if (! ssds) {
 		cf_warning(AS_DRV_SSD, "failed drv_ssds malloc");
@@ -3735,7 +4935,7 @@ ssd_init_files(as_namespace *ns, drv_ssds **ssds_p)
 	}
 
 	size_t ssds_size = sizeof(drv_ssds) + (n_ssds * sizeof(drv_ssd));
-	drv_ssds *ssds = cf_malloc(ssds_size);
+	drv_ssds *ssds = cf_valloc(ssds_size); // write stripes must be aligned
 
 	if (! ssds) {
 		cf_warning(AS_DRV_SSD, "failed drv_ssds malloc");
@@ -3856,26 +5056,27 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 		ssd->ns = ns;
 		ssd->file_id = i;
 
-		pthread_mutex_init(&ssd->write_lock, 0);
+		ssd->n_write_stripes = ns->storage_write_stripes;
+
+		for (uint32_t s = 0; s < ssd->n_write_stripes; s++) {
+			pthread_mutex_init(&ssd->write_stripes[s].lock, 0);
+		}
+
 		pthread_mutex_init(&ssd->defrag_lock, 0);
 
 		ssd->running = true;
 
 		ssd->data_in_memory = ns->storage_data_in_memory;
 		ssd->write_block_size = ns->storage_write_block_size;
+		ssd->aio_ctx = 0; // set up later, if async reads are configured
 
 		ssd_wblock_init(ssd);
 
 		// Note: free_wblock_q, defrag_wblock_q created after loading devices.
 
-		if (! (ssd->fd_q = cf_queue_create(sizeof(int), true))) {
-			cf_crash(AS_DRV_SSD, "can't create fd queue");
-		}
-
-		if (ssd->shadow_name &&
-				! (ssd->shadow_fd_q = cf_queue_create(sizeof(int), true))) {
-			cf_crash(AS_DRV_SSD, "can't create shadow fd queue");
-		}
+		ssd->fd = ssd_fd_open(ssd->name, ssd->open_flag);
+		ssd->shadow_fd = ssd->shadow_name ?
+				ssd_fd_open(ssd->shadow_name, ssd->open_flag) : -1;
 
 		if (! (ssd->swb_write_q = cf_queue_create(sizeof(void*), true))) {
 			cf_crash(AS_DRV_SSD, "can't create swb-write queue");
@@ -3894,6 +5095,12 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 			if (! (ssd->post_write_q = cf_queue_create(sizeof(void*), false))) {
 				cf_crash(AS_DRV_SSD, "can't create post-write queue");
 			}
+
+			// The configured size is shared between the devices.
+			if (ns->storage_read_cache_size != 0) {
+				ssd->read_cache = ssd_read_cache_create(
+						ns->storage_read_cache_size / ssds->n_ssds);
+			}
 		}
 
 		char histname[HISTOGRAM_NAME_SIZE];
@@ -3943,6 +5150,7 @@ as_storage_namespace_init_ssd(as_namespace *ns, cf_queue *complete_q,
 		cf_queue_push(complete_q, &udata);
 
 		ssd_start_maintenance_threads(ssds);
+		ssd_start_aio_threads(ssds);
 		ssd_start_write_worker_threads(ssds);
 		ssd_start_defrag_threads(ssds);
 	}
@@ -4066,6 +5274,17 @@ as_storage_record_close_ssd(as_record *r, as_storage_rd *rd)
 }
 
 
+uint8_t *
+as_storage_record_detach_buf_ssd(as_storage_rd *rd)
+{
+	uint8_t *buf = rd->u.ssd.must_free_block;
+
+	rd->u.ssd.must_free_block = NULL;
+
+	return buf;
+}
+
+
 // These are near the top of this file:
 //		as_storage_record_get_n_bins_ssd()
 //		as_storage_record_read_ssd()
@@ -4414,19 +5633,27 @@ as_storage_shutdown_ssd(as_namespace *ns)
 		drv_ssd *ssd = &ssds->ssds[i];
 
 		// Stop the maintenance thread from (also) flushing the swbs.
-		pthread_mutex_lock(&ssd->write_lock);
+		for (uint32_t s = 0; s < ssd->n_write_stripes; s++) {
+			pthread_mutex_lock(&ssd->write_stripes[s].lock);
+		}
+
 		pthread_mutex_lock(&ssd->defrag_lock);
 
-		// Flush current swb by pushing it to write-q.
-		if (ssd->current_swb) {
+		// Flush current swbs by pushing them to write-q.
+		for (uint32_t s = 0; s < ssd->n_write_stripes; s++) {
+			ssd_write_buf *swb = ssd->write_stripes[s].swb;
+
+			if (! swb) {
+				continue;
+			}
+
 			// Clean the end of the buffer before pushing to write-q.
-			if (ssd->write_block_size > ssd->current_swb->pos) {
-				memset(&ssd->current_swb->buf[ssd->current_swb->pos], 0,
-						ssd->write_block_size - ssd->current_swb->pos);
+			if (ssd->write_block_size > swb->pos) {
+				memset(&swb->buf[swb->pos], 0, ssd->write_block_size - swb->pos);
 			}
 
-			cf_queue_push(ssd->swb_write_q, &ssd->current_swb);
-			ssd->current_swb = NULL;
+			cf_queue_push(ssd->swb_write_q, &swb);
+			ssd->write_stripes[s].swb = NULL;
 		}
 
 		// Flush defrag swb by pushing it to write-q.
@@ -4469,5 +5696,8 @@ as_storage_shutdown_ssd(as_namespace *ns)
 		if (ssd->shadow_name) {
 			pthread_join(ssd->shadow_worker_thread, &p_void);
 		}
+
+		// Everything is on device now.
+		ssd_wblock_map_save(ssd, ssds->header->random);
 	}
 }
@@ -0,0 +1,443 @@
+/*
+ * drv_ssd_cache.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "storage/drv_ssd_cache.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "citrusleaf/alloc.h"
+
+#include "fault.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Eviction is S3-FIFO - new records go in a small FIFO, and only those hit
+// again before reaching its tail are promoted to the main FIFO. Main FIFO
+// records get a second chance (or more) if hit while queued. Keys recently
+// evicted from the small FIFO are remembered in a ghost FIFO, and go straight
+// to the main FIFO if re-inserted.
+
+#define N_SHARDS			64
+#define SMALL_PCT			10
+#define MAX_FREQ			3
+#define MAX_ENTRY_FRACTION	8 // no record may exceed 1/8 of a shard
+#define BYTES_PER_BUCKET	(2 * 1024) // assume records are ~1K
+
+typedef enum {
+	Q_SMALL,
+	Q_MAIN,
+	Q_GHOST,
+
+	N_QUEUES
+} cache_q;
+
+typedef struct cache_entry_s {
+	struct cache_entry_s*	hash_next;
+	struct cache_entry_s*	newer; // toward FIFO head
+	struct cache_entry_s*	older; // toward FIFO tail
+	uint64_t				rblock_id;
+	uint32_t				size; // of data - 0 for ghosts
+	uint8_t					q;
+	uint8_t					freq;
+	uint8_t					data[];
+} cache_entry;
+
+typedef struct cache_fifo_s {
+	cache_entry*	head; // newest
+	cache_entry*	tail; // oldest
+	uint32_t		n_entries;
+	uint64_t		size; // including entry overhead
+} cache_fifo;
+
+typedef struct cache_shard_s {
+	pthread_mutex_t	lock;
+	uint64_t		max_size;
+	cache_fifo		fifos[N_QUEUES];
+	uint32_t		bucket_mask;
+	cache_entry**	buckets;
+} cache_shard;
+
+struct ssd_read_cache_s {
+	cache_shard		shards[N_SHARDS];
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static inline uint64_t hash_rblock_id(uint64_t rblock_id);
+static inline cache_shard* get_shard(ssd_read_cache* rc, uint64_t rblock_id);
+static cache_entry** find_entry(cache_shard* shard, uint64_t rblock_id);
+static void delete_entry(cache_shard* shard, cache_entry** p_e);
+static void fifo_push(cache_fifo* fifo, cache_entry* e);
+static void fifo_unlink(cache_fifo* fifo, cache_entry* e);
+static void evict(cache_shard* shard);
+static void evict_small(cache_shard* shard);
+static void evict_main(cache_shard* shard);
+
+
+//==========================================================
+// Public API.
+//
+
+ssd_read_cache*
+ssd_read_cache_create(uint64_t max_size)
+{
+	ssd_read_cache* rc = cf_malloc(sizeof(ssd_read_cache));
+
+	if (! rc) {
+		cf_crash(AS_DRV_SSD, "failed read cache allocation");
+	}
+
+	uint64_t shard_max_size = max_size / N_SHARDS;
+	uint32_t n_buckets = 64;
+
+	while ((uint64_t)n_buckets * BYTES_PER_BUCKET < shard_max_size) {
+		n_buckets <<= 1;
+	}
+
+	for (int i = 0; i < N_SHARDS; i++) {
+		cache_shard* shard = &rc->shards[i];
+
+		pthread_mutex_init(&shard->lock, NULL);
+		shard->max_size = shard_max_size;
+		memset(shard->fifos, 0, sizeof(shard->fifos));
+		shard->bucket_mask = n_buckets - 1;
+
+		if (! (shard->buckets = cf_calloc(n_buckets, sizeof(cache_entry*)))) {
+			cf_crash(AS_DRV_SSD, "failed read cache bucket allocation");
+		}
+	}
+
+	return rc;
+}
+
+
+uint8_t*
+ssd_read_cache_get(ssd_read_cache* rc, uint64_t rblock_id, uint32_t size)
+{
+	cache_shard* shard = get_shard(rc, rblock_id);
+	uint8_t* buf = NULL;
+
+	pthread_mutex_lock(&shard->lock);
+
+	cache_entry* e = *find_entry(shard, rblock_id);
+
+	if (e && e->q != Q_GHOST && e->size == size &&
+			(buf = cf_malloc(size)) != NULL) {
+		memcpy(buf, e->data, size);
+
+		if (e->freq < MAX_FREQ) {
+			e->freq++;
+		}
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+
+	return buf;
+}
+
+
+bool
+ssd_read_cache_has(ssd_read_cache* rc, uint64_t rblock_id)
+{
+	cache_shard* shard = get_shard(rc, rblock_id);
+
+	pthread_mutex_lock(&shard->lock);
+
+	cache_entry* e = *find_entry(shard, rblock_id);
+	bool has = e && e->q != Q_GHOST;
+
+	pthread_mutex_unlock(&shard->lock);
+
+	return has;
+}
+
+
+void
+ssd_read_cache_put(ssd_read_cache* rc, uint64_t rblock_id, const uint8_t* data,
+		uint32_t size)
+{
+	cache_shard* shard = get_shard(rc, rblock_id);
+
+	if (sizeof(cache_entry) + size > shard->max_size / MAX_ENTRY_FRACTION) {
+		return;
+	}
+
+	// Copy outside the lock.
+	cache_entry* e = cf_malloc(sizeof(cache_entry) + size);
+
+	if (! e) {
+		return;
+	}
+
+	e->rblock_id = rblock_id;
+	e->size = size;
+	e->freq = 0;
+	memcpy(e->data, data, size);
+
+	cache_q q = Q_SMALL;
+
+	pthread_mutex_lock(&shard->lock);
+
+	cache_entry** p_e = find_entry(shard, rblock_id);
+
+	if (*p_e) {
+		// Evicted recently enough to be remembered - it's worth keeping.
+		if ((*p_e)->q == Q_GHOST) {
+			q = Q_MAIN;
+		}
+
+		delete_entry(shard, p_e);
+	}
+
+	cache_entry** p_bucket =
+			&shard->buckets[hash_rblock_id(rblock_id) & shard->bucket_mask];
+
+	e->hash_next = *p_bucket;
+	*p_bucket = e;
+
+	e->q = (uint8_t)q;
+	fifo_push(&shard->fifos[q], e);
+
+	evict(shard);
+
+	pthread_mutex_unlock(&shard->lock);
+}
+
+
+void
+ssd_read_cache_remove(ssd_read_cache* rc, uint64_t rblock_id)
+{
+	cache_shard* shard = get_shard(rc, rblock_id);
+
+	pthread_mutex_lock(&shard->lock);
+
+	cache_entry** p_e = find_entry(shard, rblock_id);
+
+	if (*p_e) {
+		delete_entry(shard, p_e);
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+}
+
+
+// Not under shard locks - approximate.
+uint64_t
+ssd_read_cache_used_size(ssd_read_cache* rc)
+{
+	uint64_t size = 0;
+
+	for (int i = 0; i < N_SHARDS; i++) {
+		cache_shard* shard = &rc->shards[i];
+
+		for (int q = 0; q < N_QUEUES; q++) {
+			size += shard->fifos[q].size;
+		}
+	}
+
+	return size;
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static inline uint64_t
+hash_rblock_id(uint64_t rblock_id)
+{
+	return (rblock_id * 0x9E3779B97F4A7C15UL) >> 16;
+}
+
+
+static inline cache_shard*
+get_shard(ssd_read_cache* rc, uint64_t rblock_id)
+{
+	// Neighboring records go to different shards.
+	return &rc->shards[rblock_id % N_SHARDS];
+}
+
+
+// Returns the link pointing at the entry, which is null if there's no entry.
+static cache_entry**
+find_entry(cache_shard* shard, uint64_t rblock_id)
+{
+	cache_entry** p_e =
+			&shard->buckets[hash_rblock_id(rblock_id) & shard->bucket_mask];
+
+	while (*p_e && (*p_e)->rblock_id != rblock_id) {
+		p_e = &(*p_e)->hash_next;
+	}
+
+	return p_e;
+}
+
+
+static void
+delete_entry(cache_shard* shard, cache_entry** p_e)
+{
+	cache_entry* e = *p_e;
+
+	*p_e = e->hash_next;
+	fifo_unlink(&shard->fifos[e->q], e);
+	cf_free(e);
+}
+
+
+static void
+fifo_push(cache_fifo* fifo, cache_entry* e)
+{
+	e->newer = NULL;
+	e->older = fifo->head;
+
+	if (fifo->head) {
+		fifo->head->newer = e;
+	}
+	else {
+		fifo->tail = e;
+	}
+
+	fifo->head = e;
+	fifo->n_entries++;
+	fifo->size += sizeof(cache_entry) + e->size;
+}
+
+
+static void
+fifo_unlink(cache_fifo* fifo, cache_entry* e)
+{
+	if (e->newer) {
+		e->newer->older = e->older;
+	}
+	else {
+		fifo->head = e->older;
+	}
+
+	if (e->older) {
+		e->older->newer = e->newer;
+	}
+	else {
+		fifo->tail = e->newer;
+	}
+
+	fifo->n_entries--;
+	fifo->size -= sizeof(cache_entry) + e->size;
+}
+
+
+static void
+evict(cache_shard* shard)
+{
+	cache_fifo* small_fifo = &shard->fifos[Q_SMALL];
+	cache_fifo* main_fifo = &shard->fifos[Q_MAIN];
+	cache_fifo* ghost_fifo = &shard->fifos[Q_GHOST];
+
+	while (small_fifo->size + main_fifo->size > shard->max_size) {
+		if (main_fifo->n_entries == 0 ||
+				small_fifo->size > shard->max_size * SMALL_PCT / 100) {
+			evict_small(shard);
+		}
+		else {
+			evict_main(shard);
+		}
+	}
+
+	// Remember about as many evicted keys as there are cached records.
+	while (ghost_fifo->n_entries != 0 &&
+			ghost_fifo->n_entries > small_fifo->n_entries + main_fifo->n_entries) {
+		delete_entry(shard, find_entry(shard, ghost_fifo->tail->rblock_id));
+	}
+}
+
+
+static void
+evict_small(cache_shard* shard)
+{
+	cache_fifo* small_fifo = &shard->fifos[Q_SMALL];
+	cache_entry* e = small_fifo->tail;
+
+	fifo_unlink(small_fifo, e);
+
+	// Hit since it was inserted - promote it.
+	if (e->freq != 0) {
+		e->q = Q_MAIN;
+		e->freq = 0;
+		fifo_push(&shard->fifos[Q_MAIN], e);
+		return;
+	}
+
+	// Replace it with a ghost, which is the same but for the data.
+	cache_entry** p_e = find_entry(shard, e->rblock_id);
+	cache_entry* ghost = cf_malloc(sizeof(cache_entry));
+
+	if (! ghost) {
+		*p_e = e->hash_next;
+		cf_free(e);
+		return;
+	}
+
+	ghost->hash_next = e->hash_next;
+	ghost->rblock_id = e->rblock_id;
+	ghost->size = 0;
+	ghost->q = Q_GHOST;
+	ghost->freq = 0;
+
+	*p_e = ghost;
+	fifo_push(&shard->fifos[Q_GHOST], ghost);
+
+	cf_free(e);
+}
+
+
+static void
+evict_main(cache_shard* shard)
+{
+	cache_fifo* main_fifo = &shard->fifos[Q_MAIN];
+
+	while (true) {
+		cache_entry* e = main_fifo->tail;
+
+		if (e->freq == 0) {
+			delete_entry(shard, find_entry(shard, e->rblock_id));
+			return;
+		}
+
+		// Hit while queued - give it another pass through.
+		e->freq--;
+		fifo_unlink(main_fifo, e);
+		fifo_push(main_fifo, e);
+	}
+}
@@ -0,0 +1,601 @@
+/*
+ * ssd_bench.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Standalone storage benchmark - drives reads and overwrites through the
+ * storage API against a namespace configured over device files, with no
+ * cluster, fabric or client transactions. Built by "make bench".
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aerospike/as_bytes.h"
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_clock.h"
+#include "citrusleaf/cf_digest.h"
+#include "citrusleaf/cf_random.h"
+
+#include "fault.h"
+#include "hist.h"
+
+#include "base/cfg.h"
+#include "base/datamodel.h"
+#include "base/index.h"
+#include "storage/drv_ssd.h"
+#include "storage/storage.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+#define BIN_NAME "b"
+
+typedef struct bench_cfg_s {
+	const char*		config_file;
+	const char*		ns_name;
+	uint64_t		n_keys;
+	uint64_t		n_ops;
+	uint32_t		n_threads;
+	uint32_t		read_pct;
+	uint32_t		value_size;
+	uint64_t		defrag_sweep_ops; // 0 - never force a defrag sweep
+	uint64_t		n_lookups; // 0 - skip index lookup phase
+} bench_cfg;
+
+typedef enum {
+	BENCH_LOAD, // populate keys in order
+	BENCH_LOOKUP, // random index lookups only - no device reads
+	BENCH_RUN // random reads and overwrites
+} bench_phase;
+
+typedef struct bench_job_s {
+	as_namespace*	ns;
+	bench_phase		phase;
+	cf_atomic64		next;
+	uint64_t		end;
+	cf_atomic64		n_errors;
+	cf_atomic64		lookup_ns;
+} bench_job;
+
+typedef struct device_counts_s {
+	uint64_t	n_wblock_writes;
+	uint64_t	n_defrag_wblock_reads;
+	uint64_t	n_defrag_wblock_writes;
+} device_counts;
+
+
+//==========================================================
+// Globals.
+//
+
+// Normally defined in as.c, referenced by signal.c and ticker.c.
+pthread_mutex_t g_NONSTOP;
+bool g_startup_complete = false;
+bool g_shutdown_started = false;
+
+extern uint64_t g_start_ms;
+
+static bench_cfg g_bench = {
+		.config_file = "/etc/aerospike/aerospike.conf",
+		.n_keys = 1000000,
+		.n_ops = 1000000,
+		.n_threads = 16,
+		.read_pct = 50,
+		.value_size = 1000
+};
+
+static histogram* g_read_hist;
+static histogram* g_write_hist;
+static uint8_t* g_value;
+
+static const struct option OPTS[] = {
+		{ "config-file", required_argument, 0, 'f' },
+		{ "namespace", required_argument, 0, 'n' },
+		{ "keys", required_argument, 0, 'k' },
+		{ "ops", required_argument, 0, 'o' },
+		{ "threads", required_argument, 0, 't' },
+		{ "read-pct", required_argument, 0, 'r' },
+		{ "value-size", required_argument, 0, 's' },
+		{ "defrag-sweep-ops", required_argument, 0, 'd' },
+		{ "lookups", required_argument, 0, 'l' },
+		{ "help", no_argument, 0, 'h' },
+		{ 0, 0, 0, 0 }
+};
+
+static const char USAGE[] =
+		"usage: ssd_bench [--config-file <file>] [--namespace <name>]\n"
+		"                 [--keys <n>] [--ops <n>] [--threads <n>]\n"
+		"                 [--read-pct <0-100>] [--value-size <bytes>]\n"
+		"                 [--defrag-sweep-ops <n>] [--lookups <n>]\n"
+		"\n"
+		"The namespace must use storage-engine device (files or raw devices)\n"
+		"without data-in-memory or single-bin. Keys are first loaded in order,\n"
+		"then random reads and overwrites are run. Overwrites leave garbage for\n"
+		"defrag - --defrag-sweep-ops forces a defrag sweep every <n> ops.\n"
+		"--lookups runs <n> random index-only lookups after loading, reporting\n"
+		"average latency - e.g. to compare index-huge-pages true and false.\n";
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static void bench_init(void);
+static as_namespace* bench_find_ns(void);
+static void bench_run(as_namespace* ns, bench_phase phase, uint64_t n);
+static void* run_bench_job(void* udata);
+static bool bench_lookup(as_namespace* ns, uint64_t key, cf_atomic64* lookup_ns);
+static bool bench_read(as_namespace* ns, uint64_t key);
+static bool bench_write(as_namespace* ns, uint64_t key);
+static void get_device_counts(as_namespace* ns, device_counts* counts);
+static void report_device_counts(as_namespace* ns, const char* phase, const device_counts* before);
+
+
+//==========================================================
+// Main.
+//
+
+int
+main(int argc, char** argv)
+{
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", OPTS, NULL)) != -1) {
+		switch (c) {
+		case 'f':
+			g_bench.config_file = optarg;
+			break;
+		case 'n':
+			g_bench.ns_name = optarg;
+			break;
+		case 'k':
+			g_bench.n_keys = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			g_bench.n_ops = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			g_bench.n_threads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			g_bench.read_pct = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			g_bench.value_size = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			g_bench.defrag_sweep_ops = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			g_bench.n_lookups = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			fprintf(stderr, "%s", USAGE);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (g_bench.n_keys == 0 || g_bench.n_threads == 0 ||
+			g_bench.read_pct > 100 || g_bench.value_size == 0) {
+		fprintf(stderr, "%s", USAGE);
+		return 1;
+	}
+
+	bench_init();
+
+	as_namespace* ns = bench_find_ns();
+
+	if (! (g_value = cf_malloc(g_bench.value_size))) {
+		cf_crash(AS_STORAGE, "failed value allocation");
+	}
+
+	for (uint32_t i = 0; i < g_bench.value_size; i++) {
+		g_value[i] = (uint8_t)cf_get_rand32();
+	}
+
+	device_counts counts;
+
+	get_device_counts(ns, &counts);
+	bench_run(ns, BENCH_LOAD, g_bench.n_keys);
+	report_device_counts(ns, "load", &counts);
+
+	if (g_bench.n_lookups != 0) {
+		bench_run(ns, BENCH_LOOKUP, g_bench.n_lookups);
+	}
+
+	histogram_clear(g_read_hist);
+	histogram_clear(g_write_hist);
+
+	get_device_counts(ns, &counts);
+	bench_run(ns, BENCH_RUN, g_bench.n_ops);
+	report_device_counts(ns, "run", &counts);
+
+	g_shutdown_started = true;
+	as_storage_shutdown();
+
+	cf_free(g_value);
+
+	return 0;
+}
+
+
+//==========================================================
+// Local helpers - setup.
+//
+
+// The parts of as.c main() needed to bring up storage.
+static void
+bench_init(void)
+{
+	g_start_ms = cf_getms();
+
+	cf_rc_init(NULL);
+	cf_fault_init();
+
+	as_config* c = as_config_init(g_bench.config_file);
+
+	if (cf_fault_sink_activate_all_held() != 0) {
+		cf_crash_nostack(AS_STORAGE, "can't open log sink(s)");
+	}
+
+	as_config_post_process(c, g_bench.config_file);
+
+	as_namespaces_init(false, 0);
+	as_storage_init();
+	as_storage_wait_for_defrag();
+
+	g_read_hist = histogram_create("ssd-bench-read", HIST_MICROSECONDS);
+	g_write_hist = histogram_create("ssd-bench-write", HIST_MICROSECONDS);
+}
+
+
+static as_namespace*
+bench_find_ns(void)
+{
+	for (uint32_t i = 0; i < g_config.n_namespaces; i++) {
+		as_namespace* ns = g_config.namespaces[i];
+
+		if (g_bench.ns_name && strcmp(ns->name, g_bench.ns_name) != 0) {
+			continue;
+		}
+
+		if (ns->storage_type != AS_STORAGE_ENGINE_SSD ||
+				ns->storage_data_in_memory || ns->single_bin) {
+			if (g_bench.ns_name) {
+				cf_crash_nostack(AS_STORAGE, "{%s} must be storage-engine device without data-in-memory or single-bin",
+						ns->name);
+			}
+
+			continue;
+		}
+
+		return ns;
+	}
+
+	cf_crash_nostack(AS_STORAGE, "no suitable namespace in %s",
+			g_bench.config_file);
+
+	return NULL;
+}
+
+
+//==========================================================
+// Local helpers - running jobs.
+//
+
+static void
+bench_run(as_namespace* ns, bench_phase phase, uint64_t n)
+{
+	static const char* PHASE_NAMES[] = { "load", "lookup", "run" };
+
+	bench_job job = {
+			.ns = ns,
+			.phase = phase,
+			.next = 0,
+			.end = n,
+			.n_errors = 0,
+			.lookup_ns = 0
+	};
+
+	pthread_t threads[g_bench.n_threads];
+	uint64_t start_ms = cf_getms();
+
+	for (uint32_t i = 0; i < g_bench.n_threads; i++) {
+		if (pthread_create(&threads[i], NULL, run_bench_job, &job) != 0) {
+			cf_crash(AS_STORAGE, "failed to create bench thread");
+		}
+	}
+
+	for (uint32_t i = 0; i < g_bench.n_threads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	uint64_t elapsed_ms = cf_getms() - start_ms;
+
+	cf_info(AS_STORAGE, "{%s} %s: %lu ops in %lu ms (%lu ops/sec) errors %lu",
+			ns->name, PHASE_NAMES[phase], n, elapsed_ms,
+			elapsed_ms == 0 ? 0 : n * 1000 / elapsed_ms,
+			cf_atomic64_get(job.n_errors));
+
+	// Lookups are too quick for the microsecond histograms.
+	if (phase == BENCH_LOOKUP) {
+		cf_info(AS_STORAGE, "{%s} lookup: average %lu ns, index-huge-pages %s",
+				ns->name, cf_atomic64_get(job.lookup_ns) / n,
+				ns->index_huge_pages ? "true" : "false");
+		return;
+	}
+
+	histogram_dump(g_read_hist);
+	histogram_dump(g_write_hist);
+}
+
+
+static void*
+run_bench_job(void* udata)
+{
+	bench_job* job = (bench_job*)udata;
+	as_namespace* ns = job->ns;
+	uint64_t i;
+
+	while ((i = (uint64_t)cf_atomic64_incr(&job->next) - 1) < job->end) {
+		bool ok;
+
+		if (job->phase == BENCH_LOAD) {
+			ok = bench_write(ns, i);
+		}
+		else if (job->phase == BENCH_LOOKUP) {
+			ok = bench_lookup(ns, cf_get_rand64() % g_bench.n_keys,
+					&job->lookup_ns);
+		}
+		else {
+			uint64_t key = cf_get_rand64() % g_bench.n_keys;
+
+			ok = cf_get_rand32() % 100 < g_bench.read_pct ?
+					bench_read(ns, key) : bench_write(ns, key);
+
+			if (g_bench.defrag_sweep_ops != 0 &&
+					(i + 1) % g_bench.defrag_sweep_ops == 0) {
+				as_storage_defrag_sweep(ns);
+			}
+		}
+
+		if (! ok) {
+			cf_atomic64_incr(&job->n_errors);
+		}
+	}
+
+	return NULL;
+}
+
+
+//==========================================================
+// Local helpers - storage operations.
+//
+
+// Finds the record in the index and locks it - the part of a read that
+// index-huge-pages affects.
+static bool
+bench_lookup(as_namespace* ns, uint64_t key, cf_atomic64* lookup_ns)
+{
+	cf_digest keyd;
+
+	cf_digest_compute(&key, sizeof(key), &keyd);
+
+	as_partition_reservation rsv;
+
+	as_partition_reserve_migrate(ns, as_partition_getid(keyd), &rsv, NULL);
+
+	as_index_ref r_ref;
+
+	r_ref.skip_lock = false;
+
+	uint64_t start_ns = cf_getns();
+	int rv = as_record_get(rsv.tree, &keyd, &r_ref, ns);
+
+	cf_atomic64_add(lookup_ns, (int64_t)(cf_getns() - start_ns));
+
+	if (rv == 0) {
+		as_record_done(&r_ref, ns);
+	}
+
+	as_partition_release(&rsv);
+
+	return rv == 0;
+}
+
+
+static bool
+bench_read(as_namespace* ns, uint64_t key)
+{
+	uint64_t start_ns = cf_getns();
+	cf_digest keyd;
+
+	cf_digest_compute(&key, sizeof(key), &keyd);
+
+	as_partition_reservation rsv;
+
+	as_partition_reserve_migrate(ns, as_partition_getid(keyd), &rsv, NULL);
+
+	as_index_ref r_ref;
+
+	r_ref.skip_lock = false;
+
+	if (as_record_get(rsv.tree, &keyd, &r_ref, ns) != 0) {
+		as_partition_release(&rsv);
+		return false;
+	}
+
+	as_record* r = r_ref.r;
+	as_storage_rd rd;
+
+	as_storage_record_open(ns, r, &rd, &keyd);
+
+	rd.n_bins = as_bin_get_n_bins(r, &rd);
+
+	as_bin stack_bins[rd.n_bins];
+	int result = as_storage_rd_load_bins(&rd, stack_bins);
+
+	as_storage_record_close(r, &rd);
+	as_record_done(&r_ref, ns);
+	as_partition_release(&rsv);
+
+	histogram_insert_data_point(g_read_hist, start_ns);
+
+	return result >= 0;
+}
+
+
+// Replaces the whole record - each overwrite of an existing key leaves its
+// previous version as garbage for defrag.
+static bool
+bench_write(as_namespace* ns, uint64_t key)
+{
+	uint64_t start_ns = cf_getns();
+	cf_digest keyd;
+
+	cf_digest_compute(&key, sizeof(key), &keyd);
+
+	as_partition_reservation rsv;
+
+	as_partition_reserve_migrate(ns, as_partition_getid(keyd), &rsv, NULL);
+
+	as_index_ref r_ref;
+
+	r_ref.skip_lock = false;
+
+	int rv = as_record_get_create(rsv.tree, &keyd, &r_ref, ns, false);
+
+	if (rv < 0) {
+		as_partition_release(&rsv);
+		return false;
+	}
+
+	as_record* r = r_ref.r;
+	as_storage_rd rd;
+
+	if (rv == 1) {
+		as_storage_record_create(ns, r, &rd, &keyd);
+	}
+	else {
+		as_storage_record_open(ns, r, &rd, &keyd);
+	}
+
+	rd.ignore_record_on_device = true;
+	rd.n_bins = 1;
+
+	as_bin stack_bins[1];
+	int result = as_storage_rd_load_bins(&rd, stack_bins);
+	as_bin* b = NULL;
+
+	if (result >= 0 && (b = as_bin_create(&rd, BIN_NAME)) != NULL) {
+		as_bytes bytes;
+
+		as_bytes_init_wrap(&bytes, g_value, g_bench.value_size, false);
+		result = as_bin_particle_replace_from_asval(b, (as_val*)&bytes);
+	}
+	else {
+		result = -1;
+	}
+
+	if (result == 0) {
+		r->generation++;
+		result = as_storage_record_write(r, &rd);
+	}
+
+	as_storage_record_close(r, &rd);
+
+	if (b && as_bin_inuse(b)) {
+		as_bin_particle_destroy(b, true);
+	}
+
+	// Don't leave behind a record that was never written.
+	if (result < 0 && rv == 1) {
+		as_index_delete(rsv.tree, &keyd);
+	}
+
+	as_record_done(&r_ref, ns);
+	as_partition_release(&rsv);
+
+	histogram_insert_data_point(g_write_hist, start_ns);
+
+	return result >= 0;
+}
+
+
+//==========================================================
+// Local helpers - reporting.
+//
+
+static void
+get_device_counts(as_namespace* ns, device_counts* counts)
+{
+	drv_ssds* ssds = (drv_ssds*)ns->storage_private;
+
+	memset(counts, 0, sizeof(device_counts));
+
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		drv_ssd* ssd = &ssds->ssds[i];
+
+		counts->n_wblock_writes += cf_atomic_int_get(ssd->n_wblock_writes);
+		counts->n_defrag_wblock_reads +=
+				cf_atomic_int_get(ssd->n_defrag_wblock_reads);
+		counts->n_defrag_wblock_writes +=
+				cf_atomic_int_get(ssd->n_defrag_wblock_writes);
+	}
+}
+
+
+static void
+report_device_counts(as_namespace* ns, const char* phase,
+		const device_counts* before)
+{
+	drv_ssds* ssds = (drv_ssds*)ns->storage_private;
+	uint64_t wbs = ns->storage_write_block_size;
+	device_counts after;
+
+	get_device_counts(ns, &after);
+
+	int available_pct;
+	uint64_t used_bytes;
+
+	as_storage_stats(ns, &available_pct, &used_bytes);
+
+	cf_info(AS_STORAGE, "{%s} %s: device-bytes written %lu defrag-read %lu defrag-written %lu used %lu avail-pct %d devices %d",
+			ns->name, phase,
+			(after.n_wblock_writes - before->n_wblock_writes) * wbs,
+			(after.n_defrag_wblock_reads - before->n_defrag_wblock_reads) * wbs,
+			(after.n_defrag_wblock_writes - before->n_defrag_wblock_writes) * wbs,
+			used_bytes, available_pct, ssds->n_ssds);
+}
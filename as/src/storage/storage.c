@@ -36,6 +36,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_digest.h"
 #include "citrusleaf/cf_queue.h"
 
@@ -324,6 +325,30 @@ as_storage_record_get_n_bins(as_storage_rd *rd)
 	return 0;
 }
 
+//--------------------------------------
+// as_storage_record_detach_buf
+//
+
+typedef uint8_t *(*as_storage_record_detach_buf_fn)(as_storage_rd *rd);
+static const as_storage_record_detach_buf_fn as_storage_record_detach_buf_table[AS_STORAGE_ENGINE_TYPES] = {
+	NULL,
+	0, // memory has no record buffer
+	as_storage_record_detach_buf_ssd,
+	0 // kv doesn't hand over its record buffer
+};
+
+// If the record's bins were read into a buffer, caller takes ownership of it,
+// and must free it - bins stay valid after the record is closed until then.
+uint8_t *
+as_storage_record_detach_buf(as_storage_rd *rd)
+{
+	if (as_storage_record_detach_buf_table[rd->storage_type]) {
+		return as_storage_record_detach_buf_table[rd->storage_type](rd);
+	}
+
+	return NULL;
+}
+
 //--------------------------------------
 // as_storage_record_read
 //
@@ -346,6 +371,73 @@ as_storage_record_read(as_storage_rd *rd)
 	return 0;
 }
 
+//--------------------------------------
+// as_storage_record_read_async
+//
+
+typedef bool (*as_storage_record_read_async_fn)(as_storage_rd *rd, as_storage_read_done_fn cb, void *udata);
+static const as_storage_record_read_async_fn as_storage_record_read_async_table[AS_STORAGE_ENGINE_TYPES] = {
+	NULL,
+	0, // memory has no record read
+	as_storage_record_read_async_ssd,
+	0  // kv has no async record read
+};
+
+bool
+as_storage_record_read_async(as_storage_rd *rd, as_storage_read_done_fn cb, void *udata)
+{
+	if (as_storage_record_read_async_table[rd->storage_type]) {
+		return as_storage_record_read_async_table[rd->storage_type](rd, cb, udata);
+	}
+
+	return false;
+}
+
+//--------------------------------------
+// as_storage_record_adopt_prefetch
+//
+
+typedef void (*as_storage_record_adopt_prefetch_fn)(as_storage_rd *rd, as_storage_prefetch *pf);
+static const as_storage_record_adopt_prefetch_fn as_storage_record_adopt_prefetch_table[AS_STORAGE_ENGINE_TYPES] = {
+	NULL,
+	0, // memory has no record read
+	as_storage_record_adopt_prefetch_ssd,
+	0  // kv has no async record read
+};
+
+void
+as_storage_record_adopt_prefetch(as_storage_rd *rd, as_storage_prefetch *pf)
+{
+	if (as_storage_record_adopt_prefetch_table[rd->storage_type]) {
+		as_storage_record_adopt_prefetch_table[rd->storage_type](rd, pf);
+		return;
+	}
+
+	as_storage_prefetch_destroy(pf);
+}
+
+//--------------------------------------
+// as_storage_record_is_cached
+//
+
+typedef bool (*as_storage_record_is_cached_fn)(as_storage_rd *rd);
+static const as_storage_record_is_cached_fn as_storage_record_is_cached_table[AS_STORAGE_ENGINE_TYPES] = {
+	NULL,
+	0, // memory has no record read
+	as_storage_record_is_cached_ssd,
+	0  // kv doesn't cache records
+};
+
+bool
+as_storage_record_is_cached(as_storage_rd *rd)
+{
+	if (as_storage_record_is_cached_table[rd->storage_type]) {
+		return as_storage_record_is_cached_table[rd->storage_type](rd);
+	}
+
+	return false;
+}
+
 //--------------------------------------
 // as_storage_particle_read_all
 //
@@ -739,6 +831,36 @@ as_storage_record_get_key(as_storage_rd *rd)
 	return false;
 }
 
+// For prefetches that can't be adopted, e.g. if the record is gone.
+void
+as_storage_prefetch_destroy(as_storage_prefetch *pf)
+{
+	if (pf->buf) {
+		cf_free(pf->buf);
+	}
+
+	cf_free(pf);
+}
+
+// Only ssd reads asynchronously, so there's nothing else to plug.
+void
+as_storage_read_plug()
+{
+	as_storage_read_plug_ssd();
+}
+
+void
+as_storage_read_unplug()
+{
+	as_storage_read_unplug_ssd();
+}
+
+bool
+as_storage_read_is_plugged()
+{
+	return as_storage_read_is_plugged_ssd();
+}
+
 size_t
 as_storage_record_rec_props_size(as_storage_rd *rd)
 {
@@ -831,7 +953,7 @@ as_storage_shutdown(void)
 	// that each write's record lock scope is either completed or never entered.
 
 	for (uint32_t n = 0; n < g_record_locks->n_locks; n++) {
-		pthread_mutex_lock(&g_record_locks->locks[n]);
+		pthread_mutex_lock(&g_record_locks->stripes[n].lock);
 	}
 
 	// Now flush everything outstanding to storage devices.
@@ -548,6 +548,8 @@ proxyer_handle_client_response(msg* m, proxy_request* pr)
 	as_file_handle* fd_h = pr->from.proto_fd_h;
 	size_t pos = 0;
 
+	pthread_mutex_lock(&fd_h->send_lock);
+
 	while (pos < proto_sz) {
 		int rv = cf_socket_send(fd_h->sock, proto + pos, proto_sz - pos,
 				MSG_NOSIGNAL);
@@ -558,6 +560,7 @@ proxyer_handle_client_response(msg* m, proxy_request* pr)
 		else if (rv < 0) {
 			if (errno != EWOULDBLOCK) {
 				// Common when a client aborts.
+				pthread_mutex_unlock(&fd_h->send_lock);
 				as_end_of_transaction_force_close(fd_h);
 				return AS_PROTO_RESULT_FAIL_UNKNOWN;
 			}
@@ -567,11 +570,13 @@ proxyer_handle_client_response(msg* m, proxy_request* pr)
 		else {
 			cf_warning(AS_PROTO, "send returned 0: fd %d sz %zu pos %zu ",
 					CSFD(fd_h->sock), proto_sz, pos);
+			pthread_mutex_unlock(&fd_h->send_lock);
 			as_end_of_transaction_force_close(fd_h);
 			return AS_PROTO_RESULT_FAIL_UNKNOWN;
 		}
 	}
 
+	pthread_mutex_unlock(&fd_h->send_lock);
 	as_end_of_transaction_ok(fd_h);
 
 	return AS_PROTO_RESULT_OK;
@@ -1111,6 +1116,8 @@ shipop_handle_client_response(msg* m, rw_request* rw)
 	as_file_handle* fd_h = rw->from.proto_fd_h;
 	size_t pos = 0;
 
+	pthread_mutex_lock(&fd_h->send_lock);
+
 	while (pos < proto_sz) {
 		int rv = cf_socket_send(fd_h->sock, proto + pos, proto_sz - pos,
 				MSG_NOSIGNAL);
@@ -1121,6 +1128,7 @@ shipop_handle_client_response(msg* m, rw_request* rw)
 		else if (rv < 0) {
 			if (errno != EWOULDBLOCK) {
 				// Common when a client aborts.
+				pthread_mutex_unlock(&fd_h->send_lock);
 				as_end_of_transaction_force_close(fd_h);
 				return;
 			}
@@ -1130,11 +1138,13 @@ shipop_handle_client_response(msg* m, rw_request* rw)
 		else {
 			cf_warning(AS_PROTO, "send returned 0: fd %d sz %zu pos %zu ",
 					CSFD(fd_h->sock), proto_sz, pos);
+			pthread_mutex_unlock(&fd_h->send_lock);
 			as_end_of_transaction_force_close(fd_h);
 			return;
 		}
 	}
 
+	pthread_mutex_unlock(&fd_h->send_lock);
 	as_end_of_transaction_ok(fd_h);
 }
 
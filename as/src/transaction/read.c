@@ -43,6 +43,7 @@
 #include "base/datamodel.h"
 #include "base/index.h"
 #include "base/proto.h"
+#include "base/thr_tsvc.h"
 #include "base/transaction.h"
 #include "base/transaction_policy.h"
 #include "storage/storage.h"
@@ -63,9 +64,14 @@ bool read_dup_res_cb(rw_request* rw);
 void send_read_response(as_transaction* tr, as_msg_op** ops,
 		as_bin** response_bins, uint16_t n_bins, const char* set_name,
 		cf_dyn_buf* db);
+void send_read_response_iov(as_transaction* tr, as_msg_iov* mi);
 void read_timeout_cb(rw_request* rw);
 
-transaction_status read_local(as_transaction* tr, bool stop_if_not_found);
+transaction_status read_local(as_transaction* tr, bool stop_if_not_found,
+		as_storage_prefetch* pf);
+bool read_local_start_async(as_transaction* tr, as_storage_rd* rd);
+bool read_local_would_block(as_transaction* tr, as_storage_rd* rd);
+void read_local_async_cb(void* udata, as_storage_prefetch* pf);
 void read_local_done(as_transaction* tr, as_index_ref* r_ref, as_storage_rd* rd,
 		int result_code);
 
@@ -121,7 +127,7 @@ as_read_start(as_transaction* tr)
 	if (tr->rsv.n_dupl == 0) {
 		// No duplicates to resolve. Try to read local copy - response sent to
 		// origin no matter what.
-		return read_local(tr, false);
+		return read_local(tr, false, NULL);
 	}
 
 	transaction_status status;
@@ -132,7 +138,7 @@ as_read_start(as_transaction* tr)
 					AS_POLICY_CONSISTENCY_LEVEL_ALL) {
 		// We only resolve duplicates if we don't find the record. Try to read
 		// local copy - done, and response sent to origin, if record is found.
-		if ((status = read_local(tr, true)) != TRANS_IN_PROGRESS) {
+		if ((status = read_local(tr, true, NULL)) != TRANS_IN_PROGRESS) {
 			return status;
 		}
 
@@ -202,7 +208,7 @@ read_dup_res_cb(rw_request* rw)
 	as_transaction_init_from_rw(&tr, rw);
 
 	// Read the local copy and respond to origin.
-	read_local(&tr, false);
+	read_local(&tr, false, NULL);
 
 	// Finished transaction - rw_request cleans up reservation and msgp!
 	return true;
@@ -272,6 +278,27 @@ send_read_response(as_transaction* tr, as_msg_op** ops, as_bin** response_bins,
 }
 
 
+// Send a response made by as_msg_make_response_iov() - client origin only.
+void
+send_read_response_iov(as_transaction* tr, as_msg_iov* mi)
+{
+	// Paranoia - shouldn't get here on losing race with timeout.
+	if (! tr->from.any) {
+		cf_warning(AS_RW, "transaction origin %u has null 'from'", tr->origin);
+		cf_free(mi->iov);
+		return;
+	}
+
+	BENCHMARK_NEXT_DATA_POINT(tr, read, local);
+	as_msg_send_response_iov(tr->from.proto_fd_h, mi);
+	BENCHMARK_NEXT_DATA_POINT(tr, read, response);
+	HIST_TRACK_ACTIVATE_INSERT_DATA_POINT(tr, read_hist);
+	client_read_update_stats(tr->rsv.ns, tr->result_code);
+
+	tr->from.any = NULL; // pattern, not needed
+}
+
+
 void
 read_timeout_cb(rw_request* rw)
 {
@@ -310,8 +337,11 @@ read_timeout_cb(rw_request* rw)
 // Local helpers - read local.
 //
 
+// If pf is not null, this is the continuation of an async read, and the
+// prefetched device block is used if the record hasn't since moved.
 transaction_status
-read_local(as_transaction* tr, bool stop_if_not_found)
+read_local(as_transaction* tr, bool stop_if_not_found,
+		as_storage_prefetch* pf)
 {
 	as_msg* m = &tr->msgp->msg;
 	as_namespace* ns = tr->rsv.ns;
@@ -320,6 +350,10 @@ read_local(as_transaction* tr, bool stop_if_not_found)
 	r_ref.skip_lock = false;
 
 	if (as_record_get(tr->rsv.tree, &tr->keyd, &r_ref, ns) != 0) {
+		if (pf) {
+			as_storage_prefetch_destroy(pf);
+		}
+
 		if (stop_if_not_found) {
 			return TRANS_IN_PROGRESS;
 		}
@@ -333,12 +367,34 @@ read_local(as_transaction* tr, bool stop_if_not_found)
 
 	as_storage_record_open(ns, r, &rd, &tr->keyd);
 
+	if (pf) {
+		as_storage_record_adopt_prefetch(&rd, pf);
+	}
+
 	// Check if it's an expired record.
 	if (as_record_is_expired(r)) {
 		read_local_done(tr, &r_ref, &rd, AS_PROTO_RESULT_FAIL_NOTFOUND);
 		return TRANS_DONE_ERROR;
 	}
 
+	// Release the record lock while the device read is in flight - we'll come
+	// back through here (on a storage thread) when it completes.
+	if (! pf && ! stop_if_not_found && read_local_start_async(tr, &rd)) {
+		as_storage_record_close(r, &rd);
+		as_record_done(&r_ref, ns);
+		return TRANS_IN_PROGRESS;
+	}
+
+	// A plugged (batch) thread mustn't do device reads one after another -
+	// leave any it can't start async to a transaction thread.
+	if (! pf && as_storage_read_is_plugged() &&
+			read_local_would_block(tr, &rd)) {
+		as_storage_record_close(r, &rd);
+		as_record_done(&r_ref, ns);
+		thr_tsvc_enqueue(tr);
+		return TRANS_WAITING;
+	}
+
 	// Check the key if required.
 	// Note - for data-not-in-memory "exists" ops, key check is expensive!
 	if (as_transaction_has_key(tr) &&
@@ -347,6 +403,8 @@ read_local(as_transaction* tr, bool stop_if_not_found)
 		return TRANS_DONE_ERROR;
 	}
 
+	as_record_touch(ns, r);
+
 	if ((m->info1 & AS_MSG_INFO1_GET_NOBINDATA) != 0) {
 		tr->generation = r->generation;
 		tr->void_time = r->void_time;
@@ -447,9 +505,25 @@ read_local(as_transaction* tr, bool stop_if_not_found)
 	const char* set_name = as_msg_is_xdr(m) ?
 			as_index_get_set_name(r, ns) : NULL;
 
+	uint8_t* read_buf = NULL;
+	as_msg_iov mi = { NULL, 0, 0 };
+
+	// If we can own the device read buffer, large values can be sent straight
+	// from it once the record is closed and unlocked. (CDT read results are
+	// freed before then, so they rule this out.)
+	if (tr->origin == FROM_CLIENT && n_result_bins == 0 &&
+			(read_buf = as_storage_record_detach_buf(&rd)) != NULL) {
+		as_msg_make_response_iov(tr->result_code, r->generation, r->void_time,
+				p_ops, response_bins, n_bins, ns, as_transaction_trid(tr),
+				set_name, &mi);
+	}
+
 	cf_dyn_buf_define_size(db, 16 * 1024);
 
-	if (tr->origin != FROM_BATCH) {
+	if (mi.iov) {
+		// Sent below.
+	}
+	else if (tr->origin != FROM_BATCH) {
 		db.used_sz = db.alloc_sz;
 		db.buf = (uint8_t*)as_msg_make_response_msg(tr->result_code,
 				r->generation, r->void_time, p_ops, response_bins, n_bins, ns,
@@ -460,6 +534,11 @@ read_local(as_transaction* tr, bool stop_if_not_found)
 			cf_warning_digest(AS_RW, &tr->keyd, "{%s} read_local: failed make response msg ", ns->name);
 			destroy_stack_bins(result_bins, n_result_bins);
 			read_local_done(tr, &r_ref, &rd, AS_PROTO_RESULT_FAIL_UNKNOWN);
+
+			if (read_buf) {
+				cf_free(read_buf);
+			}
+
 			return TRANS_DONE_ERROR;
 		}
 
@@ -481,17 +560,103 @@ read_local(as_transaction* tr, bool stop_if_not_found)
 	as_record_done(&r_ref, ns);
 
 	// Now that we're not under the record lock, send the message we just built.
-	if (db.used_sz != 0) {
+	if (mi.iov) {
+		send_read_response_iov(tr, &mi);
+		tr->from.proto_fd_h = NULL;
+	}
+	else if (db.used_sz != 0) {
 		send_read_response(tr, NULL, NULL, 0, NULL, &db);
 
 		cf_dyn_buf_free(&db);
 		tr->from.proto_fd_h = NULL;
 	}
 
+	if (read_buf) {
+		cf_free(read_buf);
+	}
+
 	return TRANS_DONE_SUCCESS;
 }
 
 
+// Returns true if an async device read was started - in that case, the callback
+// owns the (heap) copy of tr, along with its msgp and partition reservation.
+bool
+read_local_start_async(as_transaction* tr, as_storage_rd* rd)
+{
+	as_namespace* ns = tr->rsv.ns;
+
+	// Transactions which may be resolving duplicates are held by rw_requests.
+	if (ns->storage_async_read_depth == 0 || ns->storage_data_in_memory ||
+			tr->rsv.n_dupl != 0 || ! rd->record_on_device) {
+		return false;
+	}
+
+	// No point unless the bins (or stored key) will be read from device.
+	if ((tr->msgp->msg.info1 & AS_MSG_INFO1_GET_NOBINDATA) != 0 &&
+			! as_transaction_has_key(tr)) {
+		return false;
+	}
+
+	as_transaction* tr_copy = cf_malloc(sizeof(as_transaction));
+
+	if (! tr_copy) {
+		return false;
+	}
+
+	*tr_copy = *tr;
+
+	if (! as_storage_record_read_async(rd, read_local_async_cb, tr_copy)) {
+		cf_free(tr_copy);
+		return false;
+	}
+
+	return true;
+}
+
+
+// Returns true if the rest of the read would go to the device synchronously.
+bool
+read_local_would_block(as_transaction* tr, as_storage_rd* rd)
+{
+	if (tr->rsv.ns->storage_data_in_memory || ! rd->record_on_device) {
+		return false;
+	}
+
+	if ((tr->msgp->msg.info1 & AS_MSG_INFO1_GET_NOBINDATA) != 0 &&
+			! as_transaction_has_key(tr)) {
+		return false;
+	}
+
+	return ! as_storage_record_is_cached(rd);
+}
+
+
+void
+read_local_async_cb(void* udata, as_storage_prefetch* pf)
+{
+	as_transaction* tr = (as_transaction*)udata;
+
+	// The device read may have outlasted the transaction - don't reply late.
+	if (tr->end_time != 0 && cf_getns() > tr->end_time) {
+		as_storage_prefetch_destroy(pf);
+		as_transaction_error(tr, tr->rsv.ns, AS_PROTO_RESULT_FAIL_TIMEOUT);
+	}
+	else {
+		read_local(tr, false, pf);
+	}
+
+	// Finished transaction - clean up as process_transaction() would have.
+	as_partition_release(&tr->rsv);
+
+	if (tr->origin != FROM_BATCH) {
+		cf_free(tr->msgp);
+	}
+
+	cf_free(tr);
+}
+
+
 void
 read_local_done(as_transaction* tr, as_index_ref* r_ref, as_storage_rd* rd,
 		int result_code)
@@ -41,6 +41,7 @@
 
 #include "base/cfg.h"
 #include "base/datamodel.h"
+#include "base/expire_index.h"
 #include "base/index.h"
 #include "base/ldt.h"
 #include "base/proto.h"
@@ -1076,6 +1077,11 @@ write_replica(as_partition_reservation* rsv, cf_digest* keyd,
 		return AS_PROTO_RESULT_FAIL_UNKNOWN; // TODO - better granularity?
 	}
 
+	if (rsv->p->expire_index && ! is_subrec) {
+		as_expire_index_add(rsv->p->expire_index, keyd, r->void_time,
+				void_time);
+	}
+
 	r->generation = generation;
 	r->void_time = void_time;
 	r->last_update_time = last_update_time;
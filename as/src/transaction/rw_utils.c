@@ -39,6 +39,7 @@
 
 #include "base/cfg.h" // xdr_allows_write
 #include "base/datamodel.h"
+#include "base/expire_index.h"
 #include "base/ldt.h"
 #include "base/proto.h" // xdr_allows_write
 #include "base/secondary_index.h"
@@ -165,6 +166,7 @@ update_metadata_in_index(as_transaction* tr, bool increment_generation,
 	as_namespace* ns = tr->rsv.ns;
 
 	uint64_t now = cf_clepoch_milliseconds();
+	uint32_t old_void_time = r->void_time;
 
 	if (m->record_ttl == 0xFFFFffff) {
 		// TTL = -1 - set record to "never expire".
@@ -188,6 +190,13 @@ update_metadata_in_index(as_transaction* tr, bool increment_generation,
 		r->void_time = 0;
 	}
 
+	if (tr->rsv.p->expire_index) {
+		as_expire_index_add(tr->rsv.p->expire_index, &r->key, old_void_time,
+				r->void_time);
+	}
+
+	as_record_touch(ns, r);
+
 	// Note - last-update-time is not allowed to go backwards!
 	if (r->last_update_time < now) {
 		r->last_update_time = now;
@@ -43,6 +43,7 @@
 
 #define CF_ARENAX_BIGLOCK	(1 << 0)
 #define CF_ARENAX_CALLOC	(1 << 1)
+#define CF_ARENAX_HUGE_PAGES	(1 << 2) // back stages with huge pages if possible
 
 // Stage is indexed by 8 bits.
 #define CF_ARENAX_MAX_STAGES (1 << 8) // 256
@@ -66,6 +67,20 @@ typedef enum {
 // Element is indexed by 24 bits.
 #define MAX_STAGE_CAPACITY (1 << 24) // 16 M
 
+// With CF_ARENAX_BIGLOCK, threads allocate from and free to caches of free
+// elements, which refill from and spill to the shared free list in batches.
+#define CF_ARENAX_N_CACHES 64
+
+// Padded so each cache has its own cache line.
+typedef union cf_arenax_cache_u {
+	struct {
+		pthread_mutex_t		lock;
+		cf_arenax_handle	free_h;
+		uint32_t			n_free;
+	};
+	uint8_t				pad[64];
+} cf_arenax_cache;
+
 // DO NOT access this member data directly - use the API!
 typedef struct cf_arenax_s {
 	// Configuration (passed in constructors)
@@ -91,6 +106,9 @@ typedef struct cf_arenax_s {
 	// Current Stages
 	uint32_t			stage_count;
 	uint8_t*			stages[CF_ARENAX_MAX_STAGES];
+
+	// Free-element Caches
+	cf_arenax_cache		caches[CF_ARENAX_N_CACHES];
 } cf_arenax;
 
 typedef struct arenax_handle_s {
@@ -136,7 +154,12 @@ void cf_arenax_free(cf_arenax* _this, cf_arenax_handle h);
 //------------------------------------------------
 // Convert Handle to Pointer
 //
-void* cf_arenax_resolve(cf_arenax* _this, cf_arenax_handle h);
+static inline void*
+cf_arenax_resolve(cf_arenax* _this, cf_arenax_handle h)
+{
+	return _this->stages[((arenax_handle*)&h)->stage_id] +
+			(((arenax_handle*)&h)->element_id * _this->element_size);
+}
 
 
 //==========================================================
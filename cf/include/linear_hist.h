@@ -42,6 +42,7 @@ typedef struct linear_hist_threshold_s {
 
 linear_hist *linear_hist_create(const char *name, uint32_t start, uint32_t max_offset, uint32_t num_buckets);
 void linear_hist_destroy(linear_hist *h);
+linear_hist *linear_hist_create_like(linear_hist *h);
 void linear_hist_reset(linear_hist *h, uint32_t start, uint32_t max_offset, uint32_t num_buckets);
 void linear_hist_clear(linear_hist *h, uint32_t start, uint32_t max_offset);
 
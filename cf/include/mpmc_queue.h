@@ -0,0 +1,56 @@
+/*
+ * mpmc_queue.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Bounded lock-free multi-producer multi-consumer queue of fixed-size elements,
+ * with batched pop. Consumers spin adaptively before sleeping.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+typedef struct mpmc_queue_s mpmc_queue;
+
+
+//==========================================================
+// Public API.
+//
+
+// Capacity must be a power of 2. Pushes never block - if the ring is full,
+// elements go to a (locked) overflow queue.
+mpmc_queue* mpmc_queue_create(uint32_t ele_size, uint32_t capacity);
+
+// Returns 0, or -1 if an overflow allocation failed.
+int mpmc_queue_push(mpmc_queue* q, const void* ele);
+
+// Waits for at least one element, then pops up to max_eles (<= capacity) of
+// them into buf, packed. Returns the number popped.
+uint32_t mpmc_queue_pop_batch(mpmc_queue* q, void* buf, uint32_t max_eles);
+
+// Includes elements being pushed, but not yet visible to consumers.
+uint32_t mpmc_queue_sz(mpmc_queue* q);
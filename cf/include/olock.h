@@ -32,16 +32,48 @@
 #include <citrusleaf/cf_digest.h>
 
 
+// Each stripe gets its own cache line, so threads locking neighboring stripes
+// don't bounce each other's lines. The counters are only changed while the
+// stripe's lock is held.
+typedef union olock_stripe_u {
+	struct {
+		pthread_mutex_t lock;
+		uint64_t n_acquired;
+		uint64_t n_contended; // lock was held by another thread
+	};
+	uint8_t pad[64];
+} __attribute__ ((aligned(64))) olock_stripe;
+
 typedef struct olock_s {
 	uint32_t n_locks;
 	uint32_t mask;
-	pthread_mutex_t locks[];
+	olock_stripe stripes[];
 } olock;
 
+#define OLOCK_MIN_LOCKS (16 * 1024)
+#define OLOCK_MAX_LOCKS (1024 * 1024)
+#define OLOCK_N_HOT 16
+
+typedef struct olock_hot_s {
+	uint32_t stripe;
+	uint64_t n_acquired;
+	uint64_t n_contended;
+} olock_hot;
+
+typedef struct olock_stats_s {
+	uint64_t n_acquired;
+	uint64_t n_contended;
+	uint32_t n_hot;
+	olock_hot hot[OLOCK_N_HOT]; // most contended first
+} olock_stats;
+
 void olock_lock(olock *ol, cf_digest *d);
 void olock_vlock(olock *ol, cf_digest *d, pthread_mutex_t **vlock);
 void olock_unlock(olock *ol, cf_digest *d);
-olock *olock_create(uint32_t n_locks, bool mutex);
+olock *olock_create(uint32_t n_locks, bool adaptive);
 void olock_destroy(olock *o);
+uint32_t olock_n_locks_for_cpus(uint32_t n_cpus);
+void olock_get_stats(olock *ol, olock_stats *stats);
+void olock_clear_stats(olock *ol);
 
 extern olock *g_record_locks;
@@ -62,6 +62,7 @@ typedef struct {
 	const char *addr;
 	cf_ip_port port;
 	bool reuse_addr;
+	bool reuse_port; // several sockets may listen on the same address & port
 	int32_t type;
 	cf_socket *sock;
 } cf_socket_cfg;
@@ -181,6 +182,7 @@ CF_MUST_CHECK int32_t cf_socket_recv_from(cf_socket *sock, void *buff, size_t si
 CF_MUST_CHECK int32_t cf_socket_recv(cf_socket *sock, void *buff, size_t size, int32_t flags);
 CF_MUST_CHECK int32_t cf_socket_send_to(cf_socket *sock, void *buff, size_t size, int32_t flags, cf_sock_addr *addr);
 CF_MUST_CHECK int32_t cf_socket_send(cf_socket *sock, void *buff, size_t size, int32_t flags);
+CF_MUST_CHECK int32_t cf_socket_send_msg(cf_socket *sock, struct msghdr *m, int32_t flags);
 
 void cf_socket_write_shutdown(cf_socket *sock);
 void cf_socket_shutdown(cf_socket *sock);
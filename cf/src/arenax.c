@@ -38,6 +38,8 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include "citrusleaf/cf_atomic.h"
+
 #include "fault.h"
 
 
@@ -49,6 +51,10 @@
 // (Probably unnecessary - size_t is 64 bits on our systems.)
 const uint64_t MAX_STAGE_SIZE = 0xFFFFffff;
 
+// Elements moved between a cache and the shared free list at a time. A cache
+// spills when it holds more than twice this.
+#define CACHE_BATCH_SIZE 32
+
 // Must be in-sync with cf_arenax_err:
 const char* ARENAX_ERR_STRINGS[] = {
 	"ok",
@@ -59,6 +65,20 @@ const char* ARENAX_ERR_STRINGS[] = {
 	"unknown error"
 };
 
+// Threads are assigned caches round-robin.
+static cf_atomic32 g_next_cache_id = 0;
+
+
+//==========================================================
+// Forward Declarations
+//
+
+static cf_arenax_handle alloc_shared(cf_arenax* this);
+static cf_arenax_cache* get_cache(cf_arenax* this);
+static bool refill_cache(cf_arenax* this, cf_arenax_cache* cache);
+static void spill_cache(cf_arenax* this, cf_arenax_cache* cache);
+static void steal_from_caches(cf_arenax* this, cf_arenax_cache* cache);
+
 
 //==========================================================
 // Public API
@@ -138,6 +158,14 @@ cf_arenax_create(cf_arenax* this, key_t key_base, uint32_t element_size,
 		return CF_ARENAX_ERR_UNKNOWN;
 	}
 
+	memset(this->caches, 0, sizeof(this->caches));
+
+	if (flags & CF_ARENAX_BIGLOCK) {
+		for (int i = 0; i < CF_ARENAX_N_CACHES; i++) {
+			pthread_mutex_init(&this->caches[i].lock, 0);
+		}
+	}
+
 	this->stage_count = 0;
 	memset(this->stages, 0, sizeof(this->stages));
 
@@ -147,6 +175,10 @@ cf_arenax_create(cf_arenax* this, key_t key_base, uint32_t element_size,
 	// No need to detach - add_stage() won't fail and leave attached stage.
 	if (result != CF_ARENAX_OK && (this->flags & CF_ARENAX_BIGLOCK)) {
 		pthread_mutex_destroy(&this->lock);
+
+		for (int i = 0; i < CF_ARENAX_N_CACHES; i++) {
+			pthread_mutex_destroy(&this->caches[i].lock);
+		}
 	}
 
 	return result;
@@ -158,11 +190,81 @@ cf_arenax_create(cf_arenax* this, key_t key_base, uint32_t element_size,
 cf_arenax_handle
 cf_arenax_alloc(cf_arenax* this)
 {
-	if ((this->flags & CF_ARENAX_BIGLOCK) &&
-			pthread_mutex_lock(&this->lock) != 0) {
+	cf_arenax_handle h;
+
+	if (this->flags & CF_ARENAX_BIGLOCK) {
+		cf_arenax_cache* cache = get_cache(this);
+
+		pthread_mutex_lock(&cache->lock);
+
+		if (cache->n_free == 0 && ! refill_cache(this, cache)) {
+			pthread_mutex_unlock(&cache->lock);
+			return 0;
+		}
+
+		h = cache->free_h;
+
+		free_element* p_free_element = cf_arenax_resolve(this, h);
+
+		cache->free_h = p_free_element->next_h;
+		cache->n_free--;
+
+		pthread_mutex_unlock(&cache->lock);
+	}
+	else if ((h = alloc_shared(this)) == 0) {
 		return 0;
 	}
 
+	if (this->flags & CF_ARENAX_CALLOC) {
+		memset(cf_arenax_resolve(this, h), 0, this->element_size);
+	}
+
+	return h;
+}
+
+//------------------------------------------------
+// Free an element.
+//
+void
+cf_arenax_free(cf_arenax* this, cf_arenax_handle h)
+{
+	free_element* p_free_element = cf_arenax_resolve(this, h);
+
+	p_free_element->magic = FREE_MAGIC;
+
+	if (this->flags & CF_ARENAX_BIGLOCK) {
+		cf_arenax_cache* cache = get_cache(this);
+
+		pthread_mutex_lock(&cache->lock);
+
+		p_free_element->next_h = cache->free_h;
+		cache->free_h = h;
+		cache->n_free++;
+
+		if (cache->n_free > CACHE_BATCH_SIZE * 2) {
+			spill_cache(this, cache);
+		}
+
+		pthread_mutex_unlock(&cache->lock);
+	}
+	else {
+		p_free_element->next_h = this->free_h;
+		this->free_h = h;
+	}
+}
+
+//==========================================================
+// Local Helpers
+//
+
+//------------------------------------------------
+// Allocate from the shared free list, or from the
+// end of the arena. Caller must hold the big lock
+// if there is one.
+//
+static cf_arenax_handle
+alloc_shared(cf_arenax* this)
+{
 	cf_arenax_handle h;
 
 	// Check free list first.
@@ -177,10 +279,6 @@ cf_arenax_alloc(cf_arenax* this)
 	else {
 		if (this->at_element_id >= this->stage_capacity) {
 			if (cf_arenax_add_stage(this) != CF_ARENAX_OK) {
-				if (this->flags & CF_ARENAX_BIGLOCK) {
-					pthread_mutex_unlock(&this->lock);
-				}
-
 				return 0;
 			}
 
@@ -194,46 +292,121 @@ cf_arenax_alloc(cf_arenax* this)
 		this->at_element_id++;
 	}
 
-	if (this->flags & CF_ARENAX_BIGLOCK) {
-		pthread_mutex_unlock(&this->lock);
+	return h;
+}
+
+//------------------------------------------------
+// Get the calling thread's cache.
+//
+static cf_arenax_cache*
+get_cache(cf_arenax* this)
+{
+	static __thread uint32_t cache_id = CF_ARENAX_N_CACHES; // not yet assigned
+
+	if (cache_id == CF_ARENAX_N_CACHES) {
+		cache_id = (uint32_t)cf_atomic32_incr(&g_next_cache_id) %
+				CF_ARENAX_N_CACHES;
 	}
 
-	if (this->flags & CF_ARENAX_CALLOC) {
-		memset(cf_arenax_resolve(this, h), 0, this->element_size);
+	return &this->caches[cache_id];
+}
+
+//------------------------------------------------
+// Move a batch of elements from the shared free
+// list (or the end of the arena, or failing that,
+// other caches) into an empty cache. Caller holds
+// the cache lock. Returns false if no element
+// could be allocated.
+//
+static bool
+refill_cache(cf_arenax* this, cf_arenax_cache* cache)
+{
+	if (pthread_mutex_lock(&this->lock) != 0) {
+		return false;
 	}
 
-	return h;
+	for (uint32_t i = 0; i < CACHE_BATCH_SIZE; i++) {
+		cf_arenax_handle h = alloc_shared(this);
+
+		if (h == 0) {
+			break;
+		}
+
+		free_element* p_free_element = cf_arenax_resolve(this, h);
+
+		p_free_element->magic = FREE_MAGIC;
+		p_free_element->next_h = cache->free_h;
+		cache->free_h = h;
+		cache->n_free++;
+	}
+
+	// Arena can't grow - free elements may still be held in other caches.
+	if (cache->n_free == 0) {
+		steal_from_caches(this, cache);
+	}
+
+	pthread_mutex_unlock(&this->lock);
+
+	return cache->n_free != 0;
 }
 
 //------------------------------------------------
-// Free an element.
+// Move a batch of elements from a cache to the
+// shared free list. Caller holds the cache lock.
 //
-void
-cf_arenax_free(cf_arenax* this, cf_arenax_handle h)
+static void
+spill_cache(cf_arenax* this, cf_arenax_cache* cache)
 {
-	free_element* p_free_element = cf_arenax_resolve(this, h);
+	// Find the end of the batch outside the big lock.
+	cf_arenax_handle first_h = cache->free_h;
+	free_element* p_last = cf_arenax_resolve(this, first_h);
+
+	for (uint32_t i = 1; i < CACHE_BATCH_SIZE; i++) {
+		p_last = cf_arenax_resolve(this, p_last->next_h);
+	}
 
-	if ((this->flags & CF_ARENAX_BIGLOCK) &&
-			pthread_mutex_lock(&this->lock) != 0) {
-		// TODO - function doesn't return failure - just press on?
+	if (pthread_mutex_lock(&this->lock) != 0) {
+		// Leave the batch in the cache - we'll try again on the next free.
 		return;
 	}
 
-	p_free_element->magic = FREE_MAGIC;
-	p_free_element->next_h = this->free_h;
-	this->free_h = h;
+	cache->free_h = p_last->next_h;
+	cache->n_free -= CACHE_BATCH_SIZE;
 
-	if (this->flags & CF_ARENAX_BIGLOCK) {
-		pthread_mutex_unlock(&this->lock);
-	}
+	p_last->next_h = this->free_h;
+	this->free_h = first_h;
+
+	pthread_mutex_unlock(&this->lock);
 }
 
 //------------------------------------------------
-// Convert cf_arenax_handle to memory address.
+// Move up to a batch of elements from other caches
+// into an empty cache. Caller holds the cache lock
+// and the big lock. Other caches are only tried -
+// their owners may be waiting on either lock.
 //
-void*
-cf_arenax_resolve(cf_arenax* this, cf_arenax_handle h)
+static void
+steal_from_caches(cf_arenax* this, cf_arenax_cache* cache)
 {
-	return this->stages[((arenax_handle*)&h)->stage_id] +
-			(((arenax_handle*)&h)->element_id * this->element_size);
+	for (uint32_t i = 0; i < CF_ARENAX_N_CACHES && cache->n_free == 0; i++) {
+		cf_arenax_cache* other = &this->caches[i];
+
+		if (other == cache || pthread_mutex_trylock(&other->lock) != 0) {
+			continue;
+		}
+
+		while (other->n_free != 0 && cache->n_free < CACHE_BATCH_SIZE) {
+			cf_arenax_handle h = other->free_h;
+			free_element* p_free_element = cf_arenax_resolve(this, h);
+
+			other->free_h = p_free_element->next_h;
+			other->n_free--;
+
+			p_free_element->next_h = cache->free_h;
+			cache->free_h = h;
+			cache->n_free++;
+		}
+
+		pthread_mutex_unlock(&other->lock);
+	}
 }
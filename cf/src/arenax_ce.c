@@ -23,10 +23,89 @@
 #include "arenax.h"
 
 #include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
 #include "citrusleaf/alloc.h"
 #include "fault.h"
 
 
+#define THP_SIZE (2 * 1024 * 1024)
+
+
+//------------------------------------------------
+// Get the system's default huge page size, which
+// MAP_HUGETLB uses - 0 if it can't be found.
+//
+static size_t
+default_huge_page_size()
+{
+	FILE* fp = fopen("/proc/meminfo", "r");
+
+	if (! fp) {
+		return 0;
+	}
+
+	char line[128];
+	size_t kb = 0;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "Hugepagesize: %zu kB", &kb) == 1) {
+			break;
+		}
+	}
+
+	fclose(fp);
+
+	return kb * 1024;
+}
+
+//------------------------------------------------
+// Allocate a stage backed by huge pages - from the
+// reserved huge page pool (2M or 1G, whichever is
+// the system default) if there are enough free,
+// otherwise 2M-aligned and advised for transparent
+// huge pages. Stages are never freed, so slack from
+// rounding and aligning is simply left mapped.
+//
+static uint8_t*
+huge_page_stage_alloc(size_t stage_size)
+{
+	size_t page_size = default_huge_page_size();
+
+	if (page_size != 0) {
+		size_t size = (stage_size + page_size - 1) & ~(page_size - 1);
+		void* p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (p != MAP_FAILED) {
+			cf_info(CF_ARENAX, "arena stage uses %zuK huge pages",
+					page_size / 1024);
+			return (uint8_t*)p;
+		}
+	}
+
+	size_t size = stage_size + THP_SIZE;
+	uint8_t* p = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if ((void*)p == MAP_FAILED) {
+		return NULL;
+	}
+
+	uint8_t* p_aligned = (uint8_t*)
+			(((uint64_t)p + THP_SIZE - 1) & ~((uint64_t)THP_SIZE - 1));
+
+	if (madvise(p_aligned, stage_size, MADV_HUGEPAGE) == 0) {
+		cf_info(CF_ARENAX, "no huge page pool - arena stage uses transparent huge pages");
+	}
+	else {
+		cf_warning(CF_ARENAX, "no huge page pool or transparent huge pages - arena stage uses normal pages");
+	}
+
+	return p_aligned;
+}
+
+
 //------------------------------------------------
 // Create and attach a persistent memory block,
 // and store its pointer in the stages array.
@@ -40,7 +119,11 @@ cf_arenax_add_stage(cf_arenax* this)
 		return CF_ARENAX_ERR_STAGE_CREATE;
 	}
 
-	uint8_t* p_stage = (uint8_t*)cf_malloc(this->stage_size);
+	// Page-aligned, so elements sized in multiples of the cache line size
+	// start on cache line boundaries. Huge pages cut TLB misses on lookups.
+	uint8_t* p_stage = (this->flags & CF_ARENAX_HUGE_PAGES) ?
+			huge_page_stage_alloc(this->stage_size) :
+			(uint8_t*)cf_valloc(this->stage_size);
 
 	if (! p_stage) {
 		cf_warning(CF_ARENAX, "could not allocate %lu-byte arena stage %u",
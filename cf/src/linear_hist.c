@@ -59,6 +59,27 @@ struct linear_hist_s {
 	uint32_t bucket_width;
 };
 
+//------------------------------------------------
+// Bucket index for a data point. Points out of
+// range map to the bucket at the appropriate end.
+//
+static inline uint32_t
+linear_hist_bucket(linear_hist *h, uint32_t point)
+{
+	int32_t offset = (int32_t)(point - h->start);
+	int32_t bucket = 0;
+
+	if (offset > 0) {
+		bucket = offset / h->bucket_width;
+
+		if (bucket >= (int32_t)h->num_buckets) {
+			bucket = h->num_buckets - 1;
+		}
+	}
+
+	return (uint32_t)bucket;
+}
+
 
 //==========================================================
 // Public API.
@@ -116,9 +137,21 @@ void
 linear_hist_destroy(linear_hist *h)
 {
 	pthread_mutex_destroy(&h->info_lock);
+	cf_free(h->counts);
 	cf_free(h);
 }
 
+//------------------------------------------------
+// Create an empty linear histogram scaled like h,
+// e.g. for a thread to fill then merge into h.
+//
+linear_hist*
+linear_hist_create_like(linear_hist *h)
+{
+	return linear_hist_create(h->name, h->start,
+			h->bucket_width * h->num_buckets, h->num_buckets);
+}
+
 //------------------------------------------------
 // Clear, re-scale/re-size a linear histogram.
 //
@@ -199,18 +232,7 @@ linear_hist_merge(linear_hist *h1, linear_hist *h2)
 void
 linear_hist_insert_data_point(linear_hist *h, uint32_t point)
 {
-	int32_t offset = (int32_t)(point - h->start);
-	int32_t bucket = 0;
-
-	if (offset > 0) {
-		bucket = offset / h->bucket_width;
-
-		if (bucket >= (int32_t)h->num_buckets) {
-			bucket = h->num_buckets - 1;
-		}
-	}
-
-	h->counts[bucket]++;
+	h->counts[linear_hist_bucket(h, point)]++;
 }
 
 //------------------------------------------------
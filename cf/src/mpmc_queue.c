@@ -0,0 +1,326 @@
+/*
+ * mpmc_queue.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "mpmc_queue.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_queue.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Cells are claimed by moving the enqueue or dequeue position with a CAS. A
+// cell's sequence number says whose turn it is - equal to the position for a
+// producer, position + 1 for a consumer (i.e. the element is there).
+
+#define SPIN_MIN	16
+#define SPIN_MAX	(16 * 1024)
+
+typedef struct mpmc_cell_s {
+	uint64_t	seq;
+	uint8_t		data[];
+} mpmc_cell;
+
+struct mpmc_queue_s {
+	// Producers and consumers each get their own cache line.
+	uint64_t		enq_pos;
+	uint8_t			pad0[56];
+	uint64_t		deq_pos;
+	uint8_t			pad1[56];
+
+	uint32_t		n_sleepers;
+	uint32_t		n_overflow;
+	uint32_t		spin_limit; // adapted racily by consumers
+	pthread_mutex_t	lock; // only for sleeping & waking
+	pthread_cond_t	cond;
+	cf_queue*		overflow;
+
+	uint32_t		ele_size;
+	uint32_t		cell_size;
+	uint64_t		mask;
+	uint8_t*		cells;
+};
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static inline mpmc_cell* get_cell(const mpmc_queue* q, uint64_t pos);
+static bool try_push(mpmc_queue* q, const void* ele);
+static uint32_t try_pop(mpmc_queue* q, uint8_t* buf, uint32_t max_eles);
+static bool is_ready(mpmc_queue* q);
+
+
+//==========================================================
+// Public API.
+//
+
+mpmc_queue*
+mpmc_queue_create(uint32_t ele_size, uint32_t capacity)
+{
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		return NULL;
+	}
+
+	mpmc_queue* q = cf_valloc(sizeof(mpmc_queue));
+
+	if (! q) {
+		return NULL;
+	}
+
+	memset(q, 0, sizeof(mpmc_queue));
+
+	q->ele_size = ele_size;
+	q->cell_size = (sizeof(mpmc_cell) + ele_size + 7) & ~7;
+	q->mask = capacity - 1;
+	q->spin_limit = SPIN_MIN;
+
+	if (! (q->cells = cf_valloc((size_t)q->cell_size * capacity))) {
+		cf_free(q);
+		return NULL;
+	}
+
+	for (uint64_t pos = 0; pos < capacity; pos++) {
+		get_cell(q, pos)->seq = pos;
+	}
+
+	if (! (q->overflow = cf_queue_create(ele_size, true))) {
+		cf_free(q->cells);
+		cf_free(q);
+		return NULL;
+	}
+
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+
+	return q;
+}
+
+
+int
+mpmc_queue_push(mpmc_queue* q, const void* ele)
+{
+	// Once elements overflow, newer ones follow them until the overflow is
+	// drained - consumers only take from the overflow when the ring is empty,
+	// so this keeps order, and the ring can't starve the overflow.
+	if (ck_pr_load_32(&q->n_overflow) != 0 || ! try_push(q, ele)) {
+		if (cf_queue_push(q->overflow, ele) != CF_QUEUE_OK) {
+			return -1;
+		}
+
+		ck_pr_inc_32(&q->n_overflow);
+	}
+
+	// Pairs with the sleeper's check - either it sees the element, or we see
+	// it and wake it.
+	ck_pr_fence_memory();
+
+	if (ck_pr_load_32(&q->n_sleepers) != 0) {
+		pthread_mutex_lock(&q->lock);
+		pthread_cond_signal(&q->cond);
+		pthread_mutex_unlock(&q->lock);
+	}
+
+	return 0;
+}
+
+
+uint32_t
+mpmc_queue_pop_batch(mpmc_queue* q, void* buf, uint32_t max_eles)
+{
+	while (true) {
+		uint32_t n = try_pop(q, (uint8_t*)buf, max_eles);
+
+		if (n != 0) {
+			return n;
+		}
+
+		// Spin - if work shows up while spinning, spin longer next time, if
+		// not, spin less.
+		uint32_t spin_limit = ck_pr_load_32(&q->spin_limit);
+
+		for (uint32_t i = 0; i < spin_limit; i++) {
+			ck_pr_stall();
+
+			if (is_ready(q) && (n = try_pop(q, (uint8_t*)buf, max_eles)) != 0) {
+				if (spin_limit < SPIN_MAX) {
+					ck_pr_store_32(&q->spin_limit, spin_limit * 2);
+				}
+
+				return n;
+			}
+		}
+
+		if (spin_limit > SPIN_MIN) {
+			ck_pr_store_32(&q->spin_limit, spin_limit / 2);
+		}
+
+		// Sleep.
+		pthread_mutex_lock(&q->lock);
+		ck_pr_inc_32(&q->n_sleepers);
+		ck_pr_fence_memory();
+
+		if (! is_ready(q)) {
+			pthread_cond_wait(&q->cond, &q->lock);
+		}
+
+		ck_pr_dec_32(&q->n_sleepers);
+		pthread_mutex_unlock(&q->lock);
+	}
+}
+
+
+uint32_t
+mpmc_queue_sz(mpmc_queue* q)
+{
+	uint64_t deq_pos = ck_pr_load_64(&q->deq_pos);
+	uint64_t enq_pos = ck_pr_load_64(&q->enq_pos);
+
+	// Positions may have been read across a pop.
+	uint64_t ring_sz = enq_pos > deq_pos ? enq_pos - deq_pos : 0;
+
+	return (uint32_t)ring_sz + ck_pr_load_32(&q->n_overflow);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static inline mpmc_cell*
+get_cell(const mpmc_queue* q, uint64_t pos)
+{
+	return (mpmc_cell*)(q->cells + (pos & q->mask) * q->cell_size);
+}
+
+
+static bool
+try_push(mpmc_queue* q, const void* ele)
+{
+	uint64_t pos = ck_pr_load_64(&q->enq_pos);
+	mpmc_cell* cell;
+
+	while (true) {
+		cell = get_cell(q, pos);
+
+		int64_t diff = (int64_t)(ck_pr_load_64(&cell->seq) - pos);
+
+		if (diff == 0) {
+			if (ck_pr_cas_64_value(&q->enq_pos, pos, pos + 1, &pos)) {
+				break;
+			}
+		}
+		else if (diff < 0) {
+			return false; // full
+		}
+		else {
+			pos = ck_pr_load_64(&q->enq_pos);
+		}
+	}
+
+	memcpy(cell->data, ele, q->ele_size);
+	ck_pr_fence_store();
+	ck_pr_store_64(&cell->seq, pos + 1);
+
+	return true;
+}
+
+
+static uint32_t
+try_pop(mpmc_queue* q, uint8_t* buf, uint32_t max_eles)
+{
+	uint64_t pos = ck_pr_load_64(&q->deq_pos);
+
+	while (true) {
+		// Claim as many consecutive filled cells as we can take, in one go.
+		uint32_t n = 0;
+
+		while (n < max_eles &&
+				ck_pr_load_64(&get_cell(q, pos + n)->seq) == pos + n + 1) {
+			n++;
+		}
+
+		if (n == 0) {
+			int64_t diff = (int64_t)(ck_pr_load_64(&get_cell(q, pos)->seq) -
+					(pos + 1));
+
+			if (diff < 0) {
+				break; // ring is empty
+			}
+
+			pos = ck_pr_load_64(&q->deq_pos);
+			continue;
+		}
+
+		if (! ck_pr_cas_64_value(&q->deq_pos, pos, pos + n, &pos)) {
+			continue;
+		}
+
+		ck_pr_fence_load();
+
+		for (uint32_t i = 0; i < n; i++) {
+			mpmc_cell* cell = get_cell(q, pos + i);
+
+			memcpy(buf + (i * q->ele_size), cell->data, q->ele_size);
+			ck_pr_fence_release();
+			ck_pr_store_64(&cell->seq, pos + i + q->mask + 1);
+		}
+
+		return n;
+	}
+
+	// Ring is empty - elements may have overflowed while it was full.
+	uint32_t n = 0;
+
+	while (n < max_eles && ck_pr_load_32(&q->n_overflow) != 0 &&
+			cf_queue_pop(q->overflow, buf + (n * q->ele_size),
+					CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		ck_pr_dec_32(&q->n_overflow);
+		n++;
+	}
+
+	return n;
+}
+
+
+static bool
+is_ready(mpmc_queue* q)
+{
+	uint64_t pos = ck_pr_load_64(&q->deq_pos);
+
+	return ck_pr_load_64(&get_cell(q, pos)->seq) == pos + 1 ||
+			ck_pr_load_32(&q->n_overflow) != 0;
+}
@@ -49,26 +49,41 @@ olock *g_record_locks;
 // ASSUMES d is DIGEST and ol is OLOCK *
 //
 
-#define OLOCK_HASH(__ol, __d) ( ( (__d->digest[2] << 8) | (__d->digest[3]) ) & __ol->mask )
+// Uses 24 bits so the table may be sized up to OLOCK_MAX_LOCKS stripes.
+#define OLOCK_HASH(__ol, __d) ( ( (__d->digest[2] << 16) | (__d->digest[3] << 8) | (__d->digest[4]) ) & __ol->mask )
+
+// Roughly this many stripes per cpu keeps the odds of two threads colliding
+// on a stripe low.
+#define OLOCK_LOCKS_PER_CPU 512
+
+static inline olock_stripe *
+olock_lock_stripe(olock *ol, cf_digest *d)
+{
+	olock_stripe *s = &ol->stripes[OLOCK_HASH(ol, d)];
+
+	if (0 != pthread_mutex_trylock(&s->lock)) {
+		if (0 != pthread_mutex_lock(&s->lock)) {
+			fprintf(stderr, "olock lock failed %d\n", errno);
+		}
+
+		s->n_contended++;
+	}
+
+	s->n_acquired++;
+
+	return s;
+}
 
 void
 olock_lock(olock *ol, cf_digest *d)
 {
-	uint32_t n = OLOCK_HASH(ol, d);
-
-	pthread_mutex_lock(&ol->locks[n]);
+	olock_lock_stripe(ol, d);
 }
 
 void
 olock_vlock(olock *ol, cf_digest *d, pthread_mutex_t **vlock)
 {
-	uint32_t n = OLOCK_HASH(ol, d);
-
-	*vlock = &ol->locks[n];
-
-	if (0 != pthread_mutex_lock(*vlock)) {
-		fprintf(stderr, "olock vlock failed\n");
-	}
+	*vlock = &olock_lock_stripe(ol, d)->lock;
 }
 
 void
@@ -76,48 +91,127 @@ olock_unlock(olock *ol, cf_digest *d)
 {
 	uint32_t n = OLOCK_HASH(ol, d);
 
-	if (0 != pthread_mutex_unlock(&ol->locks[n])) {
+	if (0 != pthread_mutex_unlock(&ol->stripes[n].lock)) {
 		fprintf(stderr, "olock unlock failed %d\n", errno);
 	}
 }
 
+// If adaptive, waiters spin briefly before parking - record lock hold times
+// are usually short enough that the spin wins.
 olock *
-olock_create(uint32_t n_locks, bool mutex)
+olock_create(uint32_t n_locks, bool adaptive)
 {
-	olock *ol = cf_malloc(sizeof(olock) + (sizeof(pthread_mutex_t) * n_locks));
+	uint32_t mask = n_locks - 1;
 
-	if (! ol) {
+	if ((mask & n_locks) != 0) {
+		fprintf(stderr, "olock: make sure your number of locks is a power of 2, n_locks aint\n");
 		return 0;
 	}
 
-	uint32_t mask = n_locks - 1;
+	olock *ol = cf_valloc(sizeof(olock) + (sizeof(olock_stripe) * n_locks));
 
-	if ((mask & n_locks) != 0) {
-		fprintf(stderr, "olock: make sure your number of locks is a power of 2, n_locks aint\n");
+	if (! ol) {
 		return 0;
 	}
 
 	ol->n_locks = n_locks;
 	ol->mask = mask;
 
-	for (int i = 0; i < n_locks; i++) {
-		if (mutex) {
-			pthread_mutex_init(&ol->locks[i], 0);
-		}
-		else {
-			fprintf(stderr, "olock: todo add reader writer locks\n");
-		}
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+
+	if (adaptive) {
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+	}
+
+	for (uint32_t i = 0; i < n_locks; i++) {
+		olock_stripe *s = &ol->stripes[i];
+
+		pthread_mutex_init(&s->lock, &attr);
+		s->n_acquired = 0;
+		s->n_contended = 0;
 	}
 
+	pthread_mutexattr_destroy(&attr);
+
 	return ol;
 }
 
 void
 olock_destroy(olock *ol)
 {
-	for (int i = 0; i < ol->n_locks; i++) {
-		pthread_mutex_destroy(&ol->locks[i]);
+	for (uint32_t i = 0; i < ol->n_locks; i++) {
+		pthread_mutex_destroy(&ol->stripes[i].lock);
 	}
 
 	cf_free(ol);
 }
+
+uint32_t
+olock_n_locks_for_cpus(uint32_t n_cpus)
+{
+	uint32_t n_locks = OLOCK_MIN_LOCKS;
+
+	while (n_locks < OLOCK_MAX_LOCKS &&
+			(uint64_t)n_locks < (uint64_t)n_cpus * OLOCK_LOCKS_PER_CPU) {
+		n_locks <<= 1;
+	}
+
+	return n_locks;
+}
+
+// Not under stripe locks - approximate.
+void
+olock_get_stats(olock *ol, olock_stats *stats)
+{
+	stats->n_acquired = 0;
+	stats->n_contended = 0;
+	stats->n_hot = 0;
+
+	for (uint32_t i = 0; i < ol->n_locks; i++) {
+		olock_stripe *s = &ol->stripes[i];
+		uint64_t n_acquired = s->n_acquired;
+		uint64_t n_contended = s->n_contended;
+
+		stats->n_acquired += n_acquired;
+		stats->n_contended += n_contended;
+
+		if (n_contended == 0) {
+			continue;
+		}
+
+		// Insertion into the (small) sorted list of hottest stripes.
+		uint32_t pos = stats->n_hot;
+
+		while (pos != 0 && stats->hot[pos - 1].n_contended < n_contended) {
+			if (pos < OLOCK_N_HOT) {
+				stats->hot[pos] = stats->hot[pos - 1];
+			}
+
+			pos--;
+		}
+
+		if (pos == OLOCK_N_HOT) {
+			continue;
+		}
+
+		stats->hot[pos].stripe = i;
+		stats->hot[pos].n_acquired = n_acquired;
+		stats->hot[pos].n_contended = n_contended;
+
+		if (stats->n_hot < OLOCK_N_HOT) {
+			stats->n_hot++;
+		}
+	}
+}
+
+// Not under stripe locks - racing increments may survive.
+void
+olock_clear_stats(olock *ol)
+{
+	for (uint32_t i = 0; i < ol->n_locks; i++) {
+		ol->stripes[i].n_acquired = 0;
+		ol->stripes[i].n_contended = 0;
+	}
+}